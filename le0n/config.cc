@@ -1,19 +1,126 @@
 #include "le0n/config.h"
 #include "le0n/log.h"
+#include "le0n/util.h"
 #include <algorithm>
-#include <list>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <string.h>
 
 namespace le0n{
 
-Config::ConfigVarMap Config::s_datas;
+// 常量初始化，其它编译单元的全局变量初始化时也可以使用
+std::atomic<uint64_t> ConfigVarBase::s_retireMS(5000);
+
+// 注册表都在首次使用时构造，不依赖各编译单元全局变量的初始化顺序
+std::mutex& Config::GetMutex(){
+    static std::mutex s_mutex;
+    return s_mutex;
+}
+
+ConfigVarTable& Config::GetTable(){
+    static ConfigVarTable s_table;
+    return s_table;
+}
+
+Config::ConfigVarMap& Config::GetDatas(){
+    static ConfigVarMap s_datas;
+    return s_datas;
+}
+
+ConfigTrieNode& Config::GetTrie(){
+    static ConfigTrieNode s_trie;
+    return s_trie;
+}
+
+ConfigVarBase::ptr ConfigVarTable::find(uint64_t hash, const std::string& name) const{
+    if(m_slots.empty()){
+        return nullptr;
+    }
+    size_t mask = m_slots.size() - 1;
+    for(size_t i = hash & mask; m_slots[i].var; i = (i + 1) & mask){
+        if(m_slots[i].hash == hash && m_slots[i].var->getName() == name){
+            return m_slots[i].var;
+        }
+    }
+    return nullptr;
+}
+
+ConfigVarBase::ptr ConfigVarTable::insert(uint64_t hash, ConfigVarBase::ptr var){
+    ConfigVarBase::ptr rt = find(hash, var->getName());
+    if(rt){
+        return rt;
+    }
+    if((m_size + 1) * 2 > m_slots.size()){
+        rehash(m_slots.empty() ? 64 : m_slots.size() * 2);
+    }
+    size_t mask = m_slots.size() - 1;
+    size_t i = hash & mask;
+    while(m_slots[i].var){
+        i = (i + 1) & mask;
+    }
+    m_slots[i].hash = hash;
+    m_slots[i].var = var;
+    ++m_size;
+    return var;
+}
+
+void ConfigVarTable::rehash(size_t capacity){
+    std::vector<Slot> old;
+    old.swap(m_slots);
+    m_slots.resize(capacity);
+    size_t mask = capacity - 1;
+    for(auto& s : old){
+        if(!s.var){
+            continue;
+        }
+        size_t i = s.hash & mask;
+        while(m_slots[i].var){
+            i = (i + 1) & mask;
+        }
+        m_slots[i] = s;
+    }
+}
 
 // 查找配置项基类，找不到返回 nullptr
 ConfigVarBase::ptr Config::LookupBase(const std::string& name){
-    auto it = s_datas.find(name);
-    return it == s_datas.end() ? nullptr : it -> second;
+    return LookupBase(name, ConfigHash(name));
+}
+
+ConfigVarBase::ptr Config::LookupBase(const std::string& name, uint64_t hash){
+    std::lock_guard<std::mutex> lock(GetMutex());
+    return GetTable().find(hash, name);
+}
+
+// 注册配置项：同时登记到哈希表、名称表和前缀树
+// 前缀树按 "." 分段，例如 "system.port" -> root["system"]["port"]
+ConfigVarBase::ptr Config::AddVar(ConfigVarBase::ptr var){
+    std::lock_guard<std::mutex> lock(GetMutex());
+    const std::string& name = var->getName();
+    ConfigVarBase::ptr rt = GetTable().insert(ConfigHash(name), var);
+    if(rt != var){
+        return rt;
+    }
+    GetDatas()[name] = var;
+    ConfigTrieNode* node = &GetTrie();
+    size_t begin = 0;
+    while(true){
+        size_t end = name.find('.', begin);
+        if(end == std::string::npos){
+            end = name.size();
+        }
+        std::unique_ptr<ConfigTrieNode>& child = node->children[name.substr(begin, end - begin)];
+        if(!child){
+            child.reset(new ConfigTrieNode);
+        }
+        node = child.get();
+        if(end == name.size()){
+            break;
+        }
+        begin = end + 1;
+    }
+    node->var = var;
+    return var;
 }
 
 //"A.B", 10
@@ -21,61 +128,138 @@ ConfigVarBase::ptr Config::LookupBase(const std::string& name){
 //  B: 10
 //  C: str
 
-// 辅助函数：递归遍历 YAML 节点
-// 作用：将层级化的 YAML 结构（如 A.B.C）打平成 key-value 形式（key="A.B.C", value=node）
-// prefix: 当前路径前缀（如 "system"）
-// node: 当前遍历到的 YAML 节点
-// output: 输出列表，存所有解析出的叶子节点
-static void ListAllMember(const std::string& prefix,
-                        const YAML::Node& node,
-                        std::list<std::pair<std::string, const YAML::Node>>& output){
-            // 检查 key 是否包含非法字符
-            if(prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._1234567890")
-                    != std::string::npos){
-                        LE0N_LOG_INFO(LE0N_LOG_ROOT()) << "Config invalid name: " << prefix << " : " << node;
-                        return;
+// 配置项和 YAML 中对应的节点
+typedef std::vector<std::pair<ConfigVarBase::ptr, YAML::Node> > ConfigNodeList;
+
+// 辅助函数：沿着配置项前缀树遍历 YAML 节点
+// 作用：一次遍历就找出每个配置项对应的 YAML 节点，不再先把整棵树打平成列表。
+// 1. 当前前缀对应一个配置项时，记录 (配置项, 节点)；
+// 2. 只进入前缀树里存在的子 key，没有任何配置项关心的子树整棵跳过；
+// 3. key 统一转小写后匹配，复用同一个 string 缓冲区，避免每个 key 都拼接新字符串；
+// 4. 支持 "A.B: 10" 这种把多级名字写在同一个 key 里的写法。
+// 前缀树会被 AddVar 并发修改，调用方需持有 GetMutex()
+static void WalkConfigTrie(const ConfigTrieNode* trie,
+                           const YAML::Node& node,
+                           ConfigNodeList& out,
+                           std::string& key){
+    if(trie->var){
+        out.push_back(std::make_pair(trie->var, node));
+    }
+    if(trie->children.empty() || !node.IsMap()){
+        return;
+    }
+    for(auto it = node.begin(); it != node.end(); ++it){
+        if(!it->first.IsScalar()){
+            continue;
+        }
+        const std::string& raw = it->first.Scalar();
+        const ConfigTrieNode* child = trie;
+        size_t begin = 0;
+        while(child){
+            size_t end = raw.find('.', begin);
+            if(end == std::string::npos){
+                end = raw.size();
             }
-            output.push_back(std::make_pair(prefix, node));
-            if(node.IsMap()){
-                for(auto it = node.begin();
-                        it != node.end(); ++it){
-                                // 递归：如果是 Map，继续往下找，key 拼接上 "."
-                                ListAllMember(prefix.empty() ? it->first.Scalar() 
-                                        : prefix + "." + it->first.Scalar(), it->second, output);
-                        }
+            key.assign(raw, begin, end - begin);
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            auto c = child->children.find(key);
+            child = c == child->children.end() ? nullptr : c->second.get();
+            if(end == raw.size()){
+                break;
             }
+            begin = end + 1;
+        }
+        if(child){
+            WalkConfigTrie(child, it->second, out, key);
+        }
+    }
 }
 
 // 从 YAML 加载配置
-// 1. 遍历 YAML 所有节点，打平成 key-value。
-// 2. 遍历打平后的列表，查找是否有对应的 ConfigVar。
-// 3. 如果有，调用 fromString 更新配置值。
+// 持锁沿前缀树找到命中的节点，再在锁外交给 fromNode 解析成具体类型
+// (变更回调里可能再次查找、注册配置项)。
 void Config::LoadFromYaml(const YAML::Node &root){
-    std::list<std::pair<std::string, const YAML::Node>> all_nodes;
-    ListAllMember("", root, all_nodes);
+    ConfigNodeList nodes;
+    {
+        std::string key;
+        std::lock_guard<std::mutex> lock(GetMutex());
+        WalkConfigTrie(&GetTrie(), root, nodes, key);
+    }
+    for(auto& i : nodes){
+        i.first->fromNode(i.second);
+    }
+}
 
-    for(auto& i : all_nodes){
-        std::string key = i.first;
-        if(key.empty()){
-            continue;
+void Config::Diff(const YAML::Node& root, ChangeList& changes){
+    ConfigNodeList nodes;
+    {
+        std::string key;
+        std::lock_guard<std::mutex> lock(GetMutex());
+        WalkConfigTrie(&GetTrie(), root, nodes, key);
+    }
+    for(auto& i : nodes){
+        std::function<void()> apply = i.first->diff(i.second);
+        if(apply){
+            changes.push_back(std::make_pair(i.first->getName(), apply));
+        }
+    }
+}
+
+void Config::LoadFromConfDir(const std::string& path){
+    std::vector<std::string> files;
+    FSUtil::ListAllFile(files, path, ".yml");
+    FSUtil::ListAllFile(files, path, ".yaml");
+    std::sort(files.begin(), files.end());
+    for(auto& i : files){
+        try{
+            LoadFromYaml(YAML::LoadFile(i));
+            LE0N_LOG_INFO(LE0N_LOG_ROOT()) << "LoadConfFile file=" << i << " ok";
+        } catch (std::exception& e){
+            LE0N_LOG_ERROR(LE0N_LOG_ROOT()) << "LoadConfFile file=" << i << " failed: " << e.what();
         }
+    }
+}
 
-        // 统一转小写，保证大小写不敏感
-        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-        ConfigVarBase::ptr var = LookupBase(key);
-        
-        // 如果这个 key 在代码里注册过 (Lookup 过了)
-        if(var){
-            if(i.second.IsScalar()){
-                var->fromString(i.second.Scalar());
+bool Config::LoadFromSnapshot(const std::string& snapshot_file, const std::string& yaml_file){
+    ConfigSnapshot::ptr snap = ConfigSnapshot::Open(snapshot_file);
+    if(!snap || !snap->isFresh(yaml_file)){
+        LE0N_LOG_INFO(LE0N_LOG_ROOT()) << "LoadFromSnapshot snapshot=" << snapshot_file
+            << (snap ? " stale" : " unavailable") << ", fallback to yaml=" << yaml_file;
+        try{
+            LoadFromYaml(YAML::LoadFile(yaml_file));
+        } catch (std::exception& e){
+            LE0N_LOG_ERROR(LE0N_LOG_ROOT()) << "LoadFromSnapshot yaml=" << yaml_file
+                << " failed: " << e.what();
+        }
+        return false;
+    }
+
+    // 名称表和快照的 key 表都按字典序排列，持锁归并一次即可；解析和回调在锁外进行
+    std::vector<std::pair<ConfigVarBase::ptr, ConfigSnapshotNode> > nodes;
+    {
+        std::lock_guard<std::mutex> lock(GetMutex());
+        const ConfigVarMap& datas = GetDatas();
+        auto it = datas.begin();
+        uint32_t idx = 0;
+        uint32_t count = snap->getKeyCount();
+        while(it != datas.end() && idx < count){
+            const ConfigSnapshot::KeyEntry& entry = snap->getEntry(idx);
+            int cmp = strcmp(it->first.c_str(), snap->getKey(entry));
+            if(cmp < 0){
+                ++it;
+            } else if(cmp > 0){
+                ++idx;
             } else {
-                // 如果是复杂类型 (Sequence/Map)，转成 string 再交给 fromString (后续支持)
-                std::stringstream ss;
-                ss << i.second;
-                var->fromString(ss.str());
+                nodes.push_back(std::make_pair(it->second, snap->getNode(entry)));
+                ++it;
+                ++idx;
             }
         }
     }
+    for(auto& i : nodes){
+        i.first->fromSnapshot(i.second);
+    }
+    return true;
 }
 
-}
\ No newline at end of file
+}
@@ -7,99 +7,534 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <list>
+#include <set>
+#include <map>
+#include <unordered_set>
+#include <unordered_map>
+#include <typeinfo>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include <type_traits>
 #include <boost/lexical_cast.hpp>
 #include "le0n/log.h"
+#include "le0n/config_snapshot.h"
 #include <yaml-cpp/yaml.h>
 
 namespace le0n{
 
+/**
+ * @brief 配置名哈希(FNV-1a 64)
+ * @details constexpr 版本可以在编译期算出字符串字面量的哈希，
+ *  与运行期版本结果一致
+ */
+constexpr uint64_t ConfigHash(const char* str, uint64_t hash = 14695981039346656037ull) {
+    return *str ? ConfigHash(str + 1, (hash ^ (uint8_t)*str) * 1099511628211ull) : hash;
+}
+
+inline uint64_t ConfigHash(const std::string& str) {
+    uint64_t hash = 14695981039346656037ull;
+    for(auto c : str) {
+        hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief 配置值类型的唯一标识，同一个类型在所有编译单元里返回同一个地址
+ * @details ConfigVar 以自身类型(值类型 + 转换仿函数)作为标识，转换仿函数不同的配置项不会被互相转换
+ */
+template<class T>
+const void* ConfigTypeId() {
+    static const char s_id = 0;
+    return &s_id;
+}
+
 // 配置变量的基类
 // 作用：因为配置项的类型各异(int, string, vector...)，我们需要一个基类来实现多态，
 // 这样才能把它们都放到一个 map<string, ConfigVarBase::ptr> 里面统一管理。
 class ConfigVarBase{
 public:
     typedef std::shared_ptr<ConfigVarBase> ptr;
-    ConfigVarBase(const std::string&name ,const std::string& description = "")
+    ConfigVarBase(const std::string&name ,const std::string& description = ""
+                  ,const void* type_id = nullptr)
         : m_name(name)
-        , m_description(description) {
+        , m_description(description)
+        , m_typeId(type_id) {
             std::transform(m_name.begin(), m_name.end(), m_name.begin(), ::tolower);
         }
     virtual ~ConfigVarBase() {}
 
     const std::string& getName() const { return m_name; }
     const std::string& getDescription() const { return m_description; }
+    // 配置值类型标识(ConfigTypeId<ConfigVar<...> >())，注册和查找时用来检查类型，不需要 RTTI
+    const void* getTypeId() const { return m_typeId; }
 
     virtual std::string toString() = 0;
     virtual bool fromString(const std::string& val) = 0;
+
+    /**
+     * @brief 直接从 YAML 节点解析配置值(不经过字符串中转)
+     */
+    virtual bool fromNode(const YAML::Node& node) = 0;
+
+    /**
+     * @brief 解析节点并与当前值比较，不修改配置
+     * @return 值有变化时返回"应用新值"的函数，没有变化或解析失败返回 nullptr
+     */
+    virtual std::function<void()> diff(const YAML::Node& node) = 0;
+
+    /**
+     * @brief 从预编译快照的节点解析配置值
+     */
+    virtual bool fromSnapshot(const ConfigSnapshotNode& node) = 0;
+
+    // 配置值的类型名称
+    virtual std::string getTypeName() const = 0;
+
+    /**
+     * @brief 旧快照被替换后保留的时长(毫秒)，默认 5000
+     * @details getValue 返回的引用在值变化后至少这么久仍然有效；需要持有更久时用 getSnapshot
+     */
+    static uint64_t GetRetireMS() { return s_retireMS.load(std::memory_order_relaxed); }
+    static void SetRetireMS(uint64_t ms) { s_retireMS.store(ms, std::memory_order_relaxed); }
 protected:
+    static std::atomic<uint64_t> s_retireMS;
+
     std::string m_name;         // 配置参数的名称 (key)
     std::string m_description;  // 配置参数的描述 (help)
+    const void* m_typeId;       // 配置值类型标识
+};
+
+// =========================================================
+// 类型转换模板类 LexicalCast<F, T>：把 F 类型转换成 T 类型
+// 1. 标量(int, float, std::string...)直接使用 boost::lexical_cast
+// 2. YAML::Node <-> 容器 的偏特化可以互相嵌套，例如 std::map<std::string, std::vector<int> >
+// 3. 自定义结构体：特化 LexicalCast<YAML::Node, MyType> 和 LexicalCast<MyType, YAML::Node> 即可
+// =========================================================
+template<class F, class T>
+class LexicalCast {
+public:
+    T operator()(const F& v) {
+        return boost::lexical_cast<T>(v);
+    }
+};
+
+// YAML::Node -> 标量
+template<class T>
+class LexicalCast<YAML::Node, T> {
+public:
+    T operator()(const YAML::Node& node) {
+        if(node.IsScalar()) {
+            return boost::lexical_cast<T>(node.Scalar());
+        }
+        // 非标量(例如 std::string 类型的配置写成了 map)，按 YAML 文本交给 lexical_cast
+        std::stringstream ss;
+        ss << node;
+        return boost::lexical_cast<T>(ss.str());
+    }
+};
+
+// 标量 -> YAML::Node
+template<class T>
+class LexicalCast<T, YAML::Node> {
+public:
+    YAML::Node operator()(const T& v) {
+        return YAML::Node(boost::lexical_cast<std::string>(v));
+    }
+};
+
+// bool 使用 YAML 的写法(true/false/yes/no)，boost::lexical_cast 只认 0/1
+template<>
+class LexicalCast<YAML::Node, bool> {
+public:
+    bool operator()(const YAML::Node& node) {
+        return node.as<bool>();
+    }
+};
+
+template<>
+class LexicalCast<bool, YAML::Node> {
+public:
+    YAML::Node operator()(const bool& v) {
+        return YAML::Node(v ? "true" : "false");
+    }
+};
+
+template<>
+class LexicalCast<YAML::Node, YAML::Node> {
+public:
+    YAML::Node operator()(const YAML::Node& v) {
+        return v;
+    }
+};
+
+// 顺序容器: YAML sequence <-> vector / list
+#define LE0N_SEQUENCE_CAST(Container, insert) \
+template<class T> \
+class LexicalCast<YAML::Node, Container<T> > { \
+public: \
+    Container<T> operator()(const YAML::Node& node) { \
+        Container<T> rt; \
+        for(size_t i = 0; i < node.size(); ++i) { \
+            rt.insert(LexicalCast<YAML::Node, T>()(node[i])); \
+        } \
+        return rt; \
+    } \
+}; \
+template<class T> \
+class LexicalCast<Container<T>, YAML::Node> { \
+public: \
+    YAML::Node operator()(const Container<T>& v) { \
+        YAML::Node node(YAML::NodeType::Sequence); \
+        for(auto& i : v) { \
+            node.push_back(LexicalCast<T, YAML::Node>()(i)); \
+        } \
+        return node; \
+    } \
+};
+
+LE0N_SEQUENCE_CAST(std::vector, push_back)
+LE0N_SEQUENCE_CAST(std::list, push_back)
+LE0N_SEQUENCE_CAST(std::set, insert)
+LE0N_SEQUENCE_CAST(std::unordered_set, insert)
+#undef LE0N_SEQUENCE_CAST
+
+// 关联容器: YAML map <-> map / unordered_map (key 为 std::string)
+#define LE0N_MAP_CAST(Container) \
+template<class T> \
+class LexicalCast<YAML::Node, Container<std::string, T> > { \
+public: \
+    Container<std::string, T> operator()(const YAML::Node& node) { \
+        Container<std::string, T> rt; \
+        for(auto it = node.begin(); it != node.end(); ++it) { \
+            rt.insert(std::make_pair(it->first.Scalar(), \
+                        LexicalCast<YAML::Node, T>()(it->second))); \
+        } \
+        return rt; \
+    } \
+}; \
+template<class T> \
+class LexicalCast<Container<std::string, T>, YAML::Node> { \
+public: \
+    YAML::Node operator()(const Container<std::string, T>& v) { \
+        YAML::Node node(YAML::NodeType::Map); \
+        for(auto& i : v) { \
+            node[i.first] = LexicalCast<T, YAML::Node>()(i.second); \
+        } \
+        return node; \
+    } \
+};
+
+LE0N_MAP_CAST(std::map)
+LE0N_MAP_CAST(std::unordered_map)
+#undef LE0N_MAP_CAST
+
+// 快照标量 -> T：直接从 mmap 的字节解析，不构造 YAML::Node
+template<class T>
+class SnapshotScalarCast {
+public:
+    T operator()(const char* data, size_t size) {
+        return boost::lexical_cast<T>(data, size);
+    }
+};
+
+template<>
+class SnapshotScalarCast<bool> {
+public:
+    bool operator()(const char* data, size_t size) {
+        return YAML::Node(std::string(data, size)).as<bool>();
+    }
+};
+
+// 快照节点 -> T
+// 算术类型和 std::string 且使用默认 FromNode 时走标量快速路径；
+// 容器、自定义类型先还原成 YAML::Node(不做文本解析)再交给 FromNode
+template<class T, class FromNode
+        ,bool Fast = (std::is_arithmetic<T>::value || std::is_same<T, std::string>::value)
+                     && std::is_same<FromNode, LexicalCast<YAML::Node, T> >::value>
+class SnapshotCast {
+public:
+    T operator()(const ConfigSnapshotNode& node) {
+        return FromNode()(node.toYaml());
+    }
+};
+
+template<class T, class FromNode>
+class SnapshotCast<T, FromNode, true> {
+public:
+    T operator()(const ConfigSnapshotNode& node) {
+        if(node.isScalar()) {
+            return SnapshotScalarCast<T>()(node.getScalarData(), node.getScalarSize());
+        }
+        return FromNode()(node.toYaml());
+    }
 };
 
 // 具体配置变量类 (模板类)
 // 作用：保存具体的配置值(m_val)，并实现 ConfigVarBase 的接口。
-// T: 具体类型 (int, float, vector<int> 等)
-// 核心功能：提供 toString() 和 fromString() 实现类型转换。
-template <class T> //模板的本质是 “代码生成器” —— 编译器会为每个使用的具体类型“实例化”出一个独立的类。
+// T: 具体类型 (int, float, vector<int> 等)，需要支持 operator== 用于判断值是否变化
+// FromNode: YAML::Node -> T 的仿函数; ToNode: T -> YAML::Node 的仿函数
+// 核心功能：提供 fromNode() / toString() / fromString() 实现类型转换。
+//
+// 读写并发：配置值以不可变快照发布。setValue 新建一份快照后原子替换指针，
+// getValue 只做一次 acquire load，返回快照的引用，不拷贝也不加锁，读到的值永远不会"半新半旧"。
+// 被替换的快照放进退役列表，保留 GetRetireMS() 毫秒后在之后的 setValue 中回收:
+// 读者拿到的引用在这段时间内有效，反复热加载只保留最近一段时间内的旧值。
+template <class T
+          ,class FromNode = LexicalCast<YAML::Node, T>
+          ,class ToNode = LexicalCast<T, YAML::Node> > //模板的本质是 “代码生成器” —— 编译器会为每个使用的具体类型“实例化”出一个独立的类。
 class ConfigVar : public ConfigVarBase{
 public:
     // [BugFix] 需要重新定义 ptr。
     // 如果不定义，会继承父类的 typedef std::shared_ptr<ConfigVarBase> ptr;
     // 导致使用 g_int_value_config->getValue() 时报错：'ConfigVarBase' has no member named 'getValue'
     typedef std::shared_ptr<ConfigVar> ptr;
+    // 配置变更回调(旧值, 新值)
+    typedef std::function<void (const T& old_value, const T& new_value)> on_change_cb;
 
     ConfigVar(const std::string& name
             ,const T& default_value
             ,const std::string& description = "")
-        : ConfigVarBase(name,description)
-        , m_val(default_value){
-
+        : ConfigVarBase(name, description, ConfigTypeId<ConfigVar>()){
+        m_cur = std::make_shared<const T>(default_value);
+        m_val.store(m_cur.get(), std::memory_order_release);
     }
 
     std::string toString() override{
         try{
-            return boost::lexical_cast<std::string>(m_val);
+            YAML::Node node = ToNode()(getValue());
+            if(node.IsScalar()){
+                return node.Scalar();
+            }
+            std::stringstream ss;
+            ss << node;
+            return ss.str();
         } catch (std::exception& e){
             LE0N_LOG_ERROR(LE0N_LOG_ROOT()) << "ConfigVar::toString execption" 
-                << e.what() << "convert: " << typeid(m_val).name() << " to string";
+                << e.what() << "convert: " << typeid(T).name() << " to string";
         }
         return "";
     }
     bool fromString(const std::string& val) override {
         try{
-            m_val = boost::lexical_cast<T>(val);
-            return true;
+            // 只有序列/映射才需要解析，标量原样包装成节点，避免字符串被 YAML 语法改写
+            YAML::Node node = YAML::Load(val);
+            if(!node.IsSequence() && !node.IsMap()){
+                node = YAML::Node(val);
+            }
+            return fromNode(node);
         } catch (std::exception& e){
             LE0N_LOG_ERROR(LE0N_LOG_ROOT()) << "ConfigVar::formString execption" 
-                << e.what() << "convert: string to" << typeid(m_val).name();
+                << e.what() << "convert: string to" << typeid(T).name();
+        }
+        return false;
+    }
+    bool fromNode(const YAML::Node& node) override {
+        try{
+            setValue(FromNode()(node));
+            return true;
+        } catch (std::exception& e){
+            LE0N_LOG_ERROR(LE0N_LOG_ROOT()) << "ConfigVar::fromNode execption"
+                << e.what() << " name=" << m_name << " convert: YAML::Node to " << typeid(T).name();
+        }
+        return false;
+    }
+
+    std::function<void()> diff(const YAML::Node& node) override {
+        try{
+            std::shared_ptr<T> v(new T(FromNode()(node)));
+            if(*v == getValue()){
+                return nullptr;
+            }
+            // ConfigVar 由 Config 持有且不会删除，这里可以直接捕获 this
+            return [this, v](){ setValue(*v); };
+        } catch (std::exception& e){
+            LE0N_LOG_ERROR(LE0N_LOG_ROOT()) << "ConfigVar::diff execption"
+                << e.what() << " name=" << m_name << " convert: YAML::Node to " << typeid(T).name();
+        }
+        return nullptr;
+    }
+
+    bool fromSnapshot(const ConfigSnapshotNode& node) override {
+        try{
+            setValue(SnapshotCast<T, FromNode>()(node));
+            return true;
+        } catch (std::exception& e){
+            LE0N_LOG_ERROR(LE0N_LOG_ROOT()) << "ConfigVar::fromSnapshot execption"
+                << e.what() << " name=" << m_name << " convert: snapshot to " << typeid(T).name();
         }
         return false;
     }
 
-    const T getValue() const { return m_val; }
-    void setValue(const T& v){ m_val = v; }
+    std::string getTypeName() const override { return typeid(T).name(); }
+
+    /**
+     * @brief 读取当前配置值
+     * @details 只有一次原子读；返回的引用在值被替换后还能使用 GetRetireMS() 毫秒
+     */
+    const T& getValue() const { return *m_val.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 取得当前快照的所有权(加写者锁)
+     * @details 快照不可变，持有期间不会被回收，适合需要长时间引用配置值的场景
+     */
+    std::shared_ptr<const T> getSnapshot() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_cur;
+    }
+
+    // 退役列表中等待回收的旧快照数
+    size_t getRetiredCount() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_retired.size();
+    }
+
+    /**
+     * @brief 设置配置值，值有变化时发布新快照并通知监听者
+     */
+    void setValue(const T& v){
+        std::vector<on_change_cb> cbs;
+        std::shared_ptr<const T> old_value;
+        std::shared_ptr<const T> new_value;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            old_value = m_cur;
+            if(*old_value == v){
+                return;
+            }
+            new_value = std::make_shared<const T>(v);
+            m_cur = new_value;
+            m_val.store(new_value.get(), std::memory_order_release);
+            retire(old_value);
+            for(auto& i : m_cbs){
+                cbs.push_back(i.second);
+            }
+        }
+        // 在锁外回调，回调里再次读写配置不会死锁；新旧快照由这里持有到回调结束
+        for(auto& cb : cbs){
+            cb(*old_value, *new_value);
+        }
+    }
+
+    /**
+     * @brief 添加变化回调函数
+     * @return 返回该回调函数对应的唯一id,用于删除回调
+     */
+    uint64_t addListener(on_change_cb cb){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64_t id = ++m_cbId;
+        m_cbs[id] = cb;
+        return id;
+    }
+
+    void delListener(uint64_t key){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cbs.erase(key);
+    }
+
+    on_change_cb getListener(uint64_t key){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_cbs.find(key);
+        return it == m_cbs.end() ? nullptr : it->second;
+    }
+
+    void clearListener(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cbs.clear();
+    }
+private:
+    // 持有 m_mutex 时调用：放入退役列表，回收保留期已过的旧快照
+    void retire(const std::shared_ptr<const T>& old_value) {
+        uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+        m_retired.push_back(std::make_pair(now, old_value));
+        uint64_t retire_ms = GetRetireMS();
+        size_t n = 0;
+        while(n < m_retired.size() && now - m_retired[n].first >= retire_ms){
+            ++n;
+        }
+        m_retired.erase(m_retired.begin(), m_retired.begin() + n);
+    }
+private:
+    std::atomic<const T*> m_val;                            //当前发布的快照
+    std::shared_ptr<const T> m_cur;                         //m_val 的所有者，由 m_mutex 保护
+    std::vector<std::pair<uint64_t, std::shared_ptr<const T> > > m_retired;    //(退役时间 ms, 旧快照)，按时间递增
+    std::mutex m_mutex;                                     //写者互斥(读者不需要)
+    uint64_t m_cbId = 0;
+    std::map<uint64_t, on_change_cb> m_cbs;                 //变更回调组, key 唯一, 可以用于删除
+};
+
+/**
+ * @brief 类型化的配置句柄
+ * @details 配置项注册后不会删除，句柄直接持有 ConfigVar 指针，
+ *  读取只是一次指针解引用(加上 ConfigVar 内部快照指针的 acquire load)，不查表。
+ *  用 LE0N_CONFIG_HANDLE(T, "name") 获取，名字的哈希在编译期算出
+ */
+template<class T>
+class ConfigHandle {
+public:
+    ConfigHandle(ConfigVar<T>* var = nullptr)
+        :m_var(var) {}
+
+    const T& operator*() const { return m_var->getValue(); }
+    const T* operator->() const { return &m_var->getValue(); }
+    explicit operator bool() const { return m_var != nullptr; }
+    ConfigVar<T>* getVar() const { return m_var; }
+private:
+    ConfigVar<T>* m_var;
+};
+
+// 配置项前缀树节点(内部使用)：按 "." 分段保存所有注册过的配置名
+struct ConfigTrieNode {
+    ConfigVarBase::ptr var;     //完整路径对应的配置项，可能为空(中间节点)
+    std::unordered_map<std::string, std::unique_ptr<ConfigTrieNode> > children;
+};
+
+/**
+ * @brief 配置项哈希表(内部使用)
+ * @details 开放寻址 + 线性探测，key 是配置名的 ConfigHash；
+ *  哈希相同时再比较名字，装载率超过 1/2 时扩容
+ */
+class ConfigVarTable {
+public:
+    ConfigVarBase::ptr find(uint64_t hash, const std::string& name) const;
+    // 名字已存在时不插入，返回已有的配置项
+    ConfigVarBase::ptr insert(uint64_t hash, ConfigVarBase::ptr var);
+private:
+    void rehash(size_t capacity);
 private:
-    T m_val;
+    struct Slot {
+        uint64_t hash = 0;
+        ConfigVarBase::ptr var;     //为空表示空槽
+    };
+    std::vector<Slot> m_slots;
+    size_t m_size = 0;
 };
 
 // 配置管理类
-// 作用：管理所有的配置项 (s_datas)。
+// 作用：管理所有的配置项。
 // 核心功能：
-// 1. Lookup: 定义/查找配置项。
-// 2. 静态成员 s_datas: 存放所有配置项的 Map (key=配置名, value=配置项基类指针)。
+// 1. Lookup: 定义/查找配置项，类型不一致在注册时就报错。
+// 2. 注册表(哈希表、有序名称表、前缀树)都是首次使用时构造，
+//    其它编译单元的全局变量初始化时调用 Lookup 也不会碰到未构造的对象。
 class Config {
 public:
     typedef std::map<std::string, ConfigVarBase::ptr> ConfigVarMap;
 
-    template<class T>
-    static typename ConfigVar<T>::ptr Lookup(const std::string& name
+    /**
+     * @brief 定义配置项，已存在时返回已有的配置项
+     * @details 已存在但类型(包括转换仿函数)不同时返回 nullptr
+     */
+    template<class T
+             ,class FromNode = LexicalCast<YAML::Node, T>
+             ,class ToNode = LexicalCast<T, YAML::Node> >
+    static typename ConfigVar<T, FromNode, ToNode>::ptr Lookup(const std::string& name
         ,const T& default_value, const std::string& description = ""){
-            auto tmp = Lookup<T>(name);
-            if(tmp){
-                LE0N_LOG_ERROR(LE0N_LOG_ROOT()) << "Lookup name=" <<name << " exists";
-                return tmp;
-            }
-
+            typedef ConfigVar<T, FromNode, ToNode> VarType;
             // [BugFix] find_first_not_of 如果没找到非法字符会返回 string::npos (即 -1 或很大的数)。
             // C++ 中 if(-1) 为真，所以如果直接写 if(find_first_not_of(...)) 会导致合法名字也被判错。
             // 必须显式判断 != std::string::npos。
@@ -109,30 +544,97 @@ public:
                 throw std::invalid_argument(name);
             }
 
-            typename ConfigVar<T>::ptr v(new ConfigVar<T>(name, default_value, description));
-            s_datas[name] = v;
-            return v;
+            typename VarType::ptr v(new VarType(name, default_value, description));
+            ConfigVarBase::ptr rt = AddVar(v);
+            if(rt == v){
+                return v;
+            }
+            if(rt->getTypeId() != ConfigTypeId<VarType>()){
+                LE0N_LOG_ERROR(LE0N_LOG_ROOT()) << "Lookup name=" << name << " exists but type not "
+                    << typeid(T).name() << " real_type=" << rt->getTypeName();
+                return nullptr;
+            }
+            LE0N_LOG_ERROR(LE0N_LOG_ROOT()) << "Lookup name=" <<name << " exists";
+            return std::static_pointer_cast<VarType>(rt);
     }
 
-    // 查找配置项，如果存在且类型匹配则返回，否则返回 nullptr
-    template<class T>
-    static typename ConfigVar<T>::ptr Lookup(const std::string& name){
-        auto it = s_datas.find(name);
-        if(it == s_datas.end()){
+    // 查找配置项，如果存在且类型(包括转换仿函数)匹配则返回，否则返回 nullptr
+    template<class T
+             ,class FromNode = LexicalCast<YAML::Node, T>
+             ,class ToNode = LexicalCast<T, YAML::Node> >
+    static typename ConfigVar<T, FromNode, ToNode>::ptr Lookup(const std::string& name){
+        typedef ConfigVar<T, FromNode, ToNode> VarType;
+        ConfigVarBase::ptr var = LookupBase(name);
+        if(!var || var->getTypeId() != ConfigTypeId<VarType>()){
             return nullptr;
         }
-        return std::dynamic_pointer_cast<ConfigVar<T> >(it->second);
+        return std::static_pointer_cast<VarType>(var);
+    }
+
+    /**
+     * @brief 获取类型化句柄，hash 必须等于 ConfigHash(name)
+     * @details 配置项不存在、类型不一致或使用了自定义转换仿函数时返回空句柄
+     */
+    template<class T>
+    static ConfigHandle<T> GetHandle(const std::string& name, uint64_t hash){
+        ConfigVarBase::ptr var = LookupBase(name, hash);
+        if(!var || var->getTypeId() != ConfigTypeId<ConfigVar<T> >()){
+            return ConfigHandle<T>();
+        }
+        return ConfigHandle<T>(static_cast<ConfigVar<T>*>(var.get()));
     }
 
     // 加载 YAML 配置文件，并覆盖已有配置
     static void LoadFromYaml(const YAML::Node& root);
 
+    // 配置差异列表: (配置名, 应用新值的函数)
+    typedef std::vector<std::pair<std::string, std::function<void()> > > ChangeList;
+
+    /**
+     * @brief 计算 YAML 与当前配置的差异
+     * @details 只解析和比较，不修改任何配置；只有值真正变化的配置项会放进 changes
+     */
+    static void Diff(const YAML::Node& root, ChangeList& changes);
+
+    /**
+     * @brief 加载目录下所有的 .yml/.yaml 文件(按文件名顺序，后加载的覆盖先加载的)
+     */
+    static void LoadFromConfDir(const std::string& path);
+
+    /**
+     * @brief 从预编译快照(le0n_confc 生成)加载配置
+     * @details 快照按 key 排序，与已注册配置项做一次归并，只解析命中的节点。
+     *  快照不存在、格式不对或已经和 yaml_file 不一致时，回退为解析 yaml_file
+     * @return 使用了快照返回 true，回退到 YAML 返回 false
+     */
+    static bool LoadFromSnapshot(const std::string& snapshot_file, const std::string& yaml_file);
+
     // 查找基类指针 (内部使用)
     static ConfigVarBase::ptr LookupBase(const std::string& name);
+    static ConfigVarBase::ptr LookupBase(const std::string& name, uint64_t hash);
 private:
-    static ConfigVarMap s_datas;
+    /**
+     * @brief 登记到哈希表、名称表和前缀树
+     * @return 名字已存在时返回已有的配置项，否则返回 var
+     */
+    static ConfigVarBase::ptr AddVar(ConfigVarBase::ptr var);
+
+    static std::mutex& GetMutex();
+    static ConfigVarTable& GetTable();
+    // 有序名称表，和快照的 key 表做归并
+    static ConfigVarMap& GetDatas();
+    // 配置名前缀树，加载 YAML 时用来剪枝
+    static ConfigTrieNode& GetTrie();
 };
 
+/**
+ * @brief 获取类型化配置句柄，配置名的哈希在编译期计算
+ * @details 例: static auto port = LE0N_CONFIG_HANDLE(int, "system.port"); int p = *port;
+ */
+#define LE0N_CONFIG_HANDLE(T, name) \
+    le0n::Config::GetHandle<T>(name, \
+        std::integral_constant<uint64_t, le0n::ConfigHash(name)>::value)
+
 }
 
 #endif
\ No newline at end of file
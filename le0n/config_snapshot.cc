@@ -0,0 +1,347 @@
+#include "config_snapshot.h"
+#include "log.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <sstream>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace le0n{
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_NAME("system");
+
+static const char s_magic[8] = {'L', 'E', '0', 'N', 'C', 'F', 'G', '\0'};
+
+static inline uint32_t ReadU32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void AppendU32(std::string& out, uint32_t v) {
+    out.append((const char*)&v, sizeof(v));
+}
+
+static uint64_t Fnv1a(const char* data, size_t len) {
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool ReadFile(const std::string& path, std::string& content) {
+    std::ifstream ifs(path, std::ios::binary);
+    if(!ifs) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    content = ss.str();
+    return true;
+}
+
+uint32_t ConfigSnapshotNode::getScalarSize() const {
+    return ReadU32(m_data + 1);
+}
+
+// 嵌套深度上限，防止损坏的快照把递归解码的栈打爆
+static const int MAX_NODE_DEPTH = 256;
+
+// 读取 [p, end) 内的 uint32，越界返回 false
+static inline bool ReadU32(const char*& p, const char* end, uint32_t& v) {
+    if(end - p < (ptrdiff_t)sizeof(uint32_t)) {
+        return false;
+    }
+    v = ReadU32(p);
+    p += sizeof(uint32_t);
+    return true;
+}
+
+// 检查一个节点完整落在 [p, end) 内，返回下一个节点的起始位置，越界返回 nullptr
+static const char* SkipNode(const char* p, const char* end, int depth) {
+    if(p >= end || depth > MAX_NODE_DEPTH) {
+        return nullptr;
+    }
+    uint8_t type = (uint8_t)*p++;
+    uint32_t len = 0;
+    uint32_t count = 0;
+    switch(type) {
+        case ConfigSnapshotNode::Scalar:
+            if(!ReadU32(p, end, len) || (size_t)(end - p) < len) {
+                return nullptr;
+            }
+            return p + len;
+        case ConfigSnapshotNode::Sequence:
+            if(!ReadU32(p, end, count)) {
+                return nullptr;
+            }
+            for(uint32_t i = 0; i < count && p; ++i) {
+                p = SkipNode(p, end, depth + 1);
+            }
+            return p;
+        case ConfigSnapshotNode::Map:
+            if(!ReadU32(p, end, count)) {
+                return nullptr;
+            }
+            for(uint32_t i = 0; i < count && p; ++i) {
+                if(!ReadU32(p, end, len) || (size_t)(end - p) < len) {
+                    return nullptr;
+                }
+                p = SkipNode(p + len, end, depth + 1);
+            }
+            return p;
+        default:
+            return p;
+    }
+}
+
+// 解码 [p, end) 内的一个节点到 out，返回下一个节点的起始位置，越界返回 nullptr
+static const char* DecodeNode(const char* p, const char* end, YAML::Node& out) {
+    if(p >= end) {
+        return nullptr;
+    }
+    uint8_t type = (uint8_t)*p++;
+    uint32_t len = 0;
+    uint32_t count = 0;
+    switch(type) {
+        case ConfigSnapshotNode::Scalar: {
+            if(!ReadU32(p, end, len) || (size_t)(end - p) < len) {
+                return nullptr;
+            }
+            out = YAML::Node(std::string(p, len));
+            return p + len;
+        }
+        case ConfigSnapshotNode::Sequence: {
+            if(!ReadU32(p, end, count)) {
+                return nullptr;
+            }
+            out = YAML::Node(YAML::NodeType::Sequence);
+            for(uint32_t i = 0; i < count; ++i) {
+                YAML::Node child;
+                if(!(p = DecodeNode(p, end, child))) {
+                    return nullptr;
+                }
+                out.push_back(child);
+            }
+            return p;
+        }
+        case ConfigSnapshotNode::Map: {
+            if(!ReadU32(p, end, count)) {
+                return nullptr;
+            }
+            out = YAML::Node(YAML::NodeType::Map);
+            for(uint32_t i = 0; i < count; ++i) {
+                if(!ReadU32(p, end, len) || (size_t)(end - p) < len) {
+                    return nullptr;
+                }
+                std::string key(p, len);
+                p += len;
+                YAML::Node child;
+                if(!(p = DecodeNode(p, end, child))) {
+                    return nullptr;
+                }
+                out[key] = child;
+            }
+            return p;
+        }
+        default:
+            out = YAML::Node(YAML::NodeType::Null);
+            return p;
+    }
+}
+
+YAML::Node ConfigSnapshotNode::toYaml() const {
+    YAML::Node node;
+    if(m_data && !DecodeNode(m_data, m_end, node)) {
+        throw std::runtime_error("corrupted config snapshot node");
+    }
+    return node;
+}
+
+// 编码一个 YAML 节点；with_path 为 true 时把路径登记到 keys(序列里的元素没有配置名)
+static void EncodeNode(const YAML::Node& node, const std::string& path, bool with_path
+                       ,std::string& out, std::map<std::string, uint32_t>& keys) {
+    if(with_path && !path.empty()) {
+        keys[path] = out.size();
+    }
+    if(node.IsScalar()) {
+        out.push_back((char)ConfigSnapshotNode::Scalar);
+        AppendU32(out, node.Scalar().size());
+        out.append(node.Scalar());
+    } else if(node.IsSequence()) {
+        out.push_back((char)ConfigSnapshotNode::Sequence);
+        AppendU32(out, node.size());
+        for(size_t i = 0; i < node.size(); ++i) {
+            EncodeNode(node[i], "", false, out, keys);
+        }
+    } else if(node.IsMap()) {
+        out.push_back((char)ConfigSnapshotNode::Map);
+        AppendU32(out, node.size());
+        for(auto it = node.begin(); it != node.end(); ++it) {
+            const std::string& key = it->first.Scalar();
+            AppendU32(out, key.size());
+            out.append(key);
+            std::string lower = key;
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            EncodeNode(it->second, path.empty() ? lower : path + "." + lower
+                       ,with_path, out, keys);
+        }
+    } else {
+        out.push_back((char)ConfigSnapshotNode::Null);
+    }
+}
+
+bool ConfigSnapshot::Compile(const std::string& yaml_file, const std::string& snapshot_file) {
+    std::string content;
+    struct stat st;
+    if(!ReadFile(yaml_file, content) || stat(yaml_file.c_str(), &st) != 0) {
+        LE0N_LOG_ERROR(g_logger) << "ConfigSnapshot::Compile read " << yaml_file << " failed";
+        return false;
+    }
+
+    std::string nodes;
+    std::map<std::string, uint32_t> keys;
+    try {
+        EncodeNode(YAML::Load(content), "", true, nodes, keys);
+    } catch (std::exception& e) {
+        LE0N_LOG_ERROR(g_logger) << "ConfigSnapshot::Compile parse " << yaml_file
+            << " failed: " << e.what();
+        return false;
+    }
+
+    size_t keys_size = 0;
+    for(auto& i : keys) {
+        keys_size += i.first.size() + 1;
+    }
+    uint64_t key_base = sizeof(Header) + sizeof(KeyEntry) * keys.size();
+    uint64_t node_base = key_base + keys_size;
+    uint64_t total = node_base + nodes.size();
+    if(total > UINT32_MAX) {
+        LE0N_LOG_ERROR(g_logger) << "ConfigSnapshot::Compile " << yaml_file << " too large";
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, s_magic, sizeof(s_magic));
+    header.version = VERSION;
+    header.key_count = keys.size();
+    header.source_size = content.size();
+    header.source_mtime_ns = st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+    header.source_hash = Fnv1a(content.c_str(), content.size());
+    header.file_size = total;
+
+    std::string out;
+    out.reserve(total);
+    out.append((const char*)&header, sizeof(header));
+    uint32_t key_offset = key_base;
+    for(auto& i : keys) {
+        KeyEntry entry;
+        entry.key_offset = key_offset;
+        entry.key_size = i.first.size();
+        entry.node_offset = node_base + i.second;
+        out.append((const char*)&entry, sizeof(entry));
+        key_offset += i.first.size() + 1;
+    }
+    for(auto& i : keys) {
+        out.append(i.first.c_str(), i.first.size() + 1);
+    }
+    out.append(nodes);
+
+    // 先写临时文件再 rename，并发启动的进程不会读到写了一半的快照
+    std::string tmp = snapshot_file + ".tmp";
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        ofs.write(out.c_str(), out.size());
+        if(!ofs) {
+            LE0N_LOG_ERROR(g_logger) << "ConfigSnapshot::Compile write " << tmp << " failed";
+            return false;
+        }
+    }
+    if(rename(tmp.c_str(), snapshot_file.c_str()) != 0) {
+        LE0N_LOG_ERROR(g_logger) << "ConfigSnapshot::Compile rename " << tmp << " failed errno="
+            << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+ConfigSnapshot::ptr ConfigSnapshot::Open(const std::string& snapshot_file) {
+    int fd = open(snapshot_file.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+        close(fd);
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    ConfigSnapshot::ptr snap(new ConfigSnapshot);
+    snap->m_base = (const char*)addr;
+    snap->m_size = st.st_size;
+    snap->m_header = (const Header*)addr;
+    snap->m_entries = (const KeyEntry*)(snap->m_base + sizeof(Header));
+
+    const Header* h = snap->m_header;
+    if(memcmp(h->magic, s_magic, sizeof(s_magic)) != 0
+            || h->version != VERSION
+            || h->file_size != snap->m_size
+            || sizeof(Header) + (uint64_t)h->key_count * sizeof(KeyEntry) > snap->m_size) {
+        LE0N_LOG_WARN(g_logger) << "ConfigSnapshot::Open " << snapshot_file
+            << " invalid format or version";
+        return nullptr;
+    }
+    // 偏移和长度都来自文件，逐项检查后才能直接指向 mmap 的内存
+    const char* end = snap->m_base + snap->m_size;
+    for(uint32_t i = 0; i < h->key_count; ++i) {
+        const KeyEntry& entry = snap->m_entries[i];
+        if((uint64_t)entry.key_offset + entry.key_size >= snap->m_size
+                || snap->m_base[entry.key_offset + entry.key_size] != '\0'
+                || strlen(snap->m_base + entry.key_offset) != entry.key_size
+                || entry.node_offset >= snap->m_size
+                || !SkipNode(snap->m_base + entry.node_offset, end, 0)) {
+            LE0N_LOG_WARN(g_logger) << "ConfigSnapshot::Open " << snapshot_file
+                << " corrupted entry " << i;
+            return nullptr;
+        }
+    }
+    return snap;
+}
+
+ConfigSnapshot::~ConfigSnapshot() {
+    if(m_base) {
+        munmap((void*)m_base, m_size);
+    }
+}
+
+bool ConfigSnapshot::isFresh(const std::string& yaml_file) const {
+    struct stat st;
+    if(stat(yaml_file.c_str(), &st) != 0
+            || (uint64_t)st.st_size != m_header->source_size) {
+        return false;
+    }
+    uint64_t mtime = st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+    if(mtime == m_header->source_mtime_ns) {
+        return true;
+    }
+    // 文件被拷贝过(部署时很常见)，修改时间变了但内容可能没变
+    std::string content;
+    return ReadFile(yaml_file, content)
+        && Fnv1a(content.c_str(), content.size()) == m_header->source_hash;
+}
+
+}
@@ -0,0 +1,118 @@
+#ifndef __LE0N_CONFIG_SNAPSHOT_H__
+#define __LE0N_CONFIG_SNAPSHOT_H__
+
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include <yaml-cpp/yaml.h>
+
+namespace le0n{
+
+/**
+ * @brief 快照中的一个节点(只读视图，直接指向 mmap 的内存)
+ * @details 编码格式(小端，与生成快照的机器一致):
+ *  uint8 类型 + 内容
+ *  - Scalar:   uint32 长度 + 字节
+ *  - Sequence: uint32 元素数 + 元素节点...
+ *  - Map:      uint32 元素数 + (uint32 key 长度 + key 字节 + 值节点)...
+ */
+class ConfigSnapshotNode{
+public:
+    enum Type {
+        Null = 0,
+        Scalar = 1,
+        Sequence = 2,
+        Map = 3
+    };
+
+    /**
+     * @param[in] data 节点起始位置
+     * @param[in] end 节点所在内存的结尾，解码不会越过它
+     */
+    ConfigSnapshotNode(const char* data = nullptr, const char* end = nullptr)
+        :m_data(data)
+        ,m_end(end) {}
+
+    Type getType() const { return m_data ? (Type)(uint8_t)m_data[0] : Null; }
+    bool isScalar() const { return getType() == Scalar; }
+
+    // 标量内容，不以 '\0' 结尾
+    const char* getScalarData() const { return m_data + 1 + sizeof(uint32_t); }
+    uint32_t getScalarSize() const;
+
+    /**
+     * @brief 转换成 YAML::Node(直接构造节点，不做文本解析)
+     * @details 用于容器、自定义类型等没有快速路径的配置项；数据越界时抛出 std::runtime_error
+     */
+    YAML::Node toYaml() const;
+private:
+    const char* m_data;
+    const char* m_end;
+};
+
+/**
+ * @brief 预编译的二进制配置快照
+ * @details 文件布局: Header | KeyEntry[key_count](按 key 排序) | key 字符串区 | 节点区
+ *  节点区是整棵 YAML 树的一份编码；每个 key 是一条小写的完整路径("system.port")，
+ *  指向节点区里对应子树的偏移，因此任意层级的配置项都能直接定位，子树不重复存储。
+ *  Header 里记录源 YAML 文件的大小和内容哈希，用来判断快照是否过期。
+ */
+class ConfigSnapshot{
+public:
+    typedef std::shared_ptr<ConfigSnapshot> ptr;
+
+    static const uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t key_count;
+        uint64_t source_size;       //源 YAML 文件大小
+        uint64_t source_mtime_ns;   //源 YAML 文件修改时间
+        uint64_t source_hash;       //源 YAML 文件内容哈希(FNV-1a)
+        uint64_t file_size;         //快照文件总大小
+    };
+
+    struct KeyEntry {
+        uint32_t key_offset;
+        uint32_t key_size;
+        uint32_t node_offset;
+    };
+
+    /**
+     * @brief 把 YAML 文件编译成快照文件
+     */
+    static bool Compile(const std::string& yaml_file, const std::string& snapshot_file);
+
+    /**
+     * @brief mmap 打开快照文件，格式或版本不对返回 nullptr
+     * @details 逐项检查 key 表的偏移、key 的结尾和每个节点的编码都在文件范围内，损坏的快照同样返回 nullptr
+     */
+    static ptr Open(const std::string& snapshot_file);
+
+    ~ConfigSnapshot();
+
+    /**
+     * @brief 快照是否仍然对应 yaml_file 的当前内容
+     * @details 大小不同直接判定过期；修改时间相同认为没变；否则比较内容哈希
+     */
+    bool isFresh(const std::string& yaml_file) const;
+
+    uint32_t getKeyCount() const { return m_header->key_count; }
+    const KeyEntry& getEntry(uint32_t idx) const { return m_entries[idx]; }
+    const char* getKey(const KeyEntry& entry) const { return m_base + entry.key_offset; }
+    ConfigSnapshotNode getNode(const KeyEntry& entry) const {
+        return ConfigSnapshotNode(m_base + entry.node_offset, m_base + m_size);
+    }
+private:
+    ConfigSnapshot() {}
+private:
+    const char* m_base = nullptr;
+    size_t m_size = 0;
+    const Header* m_header = nullptr;
+    const KeyEntry* m_entries = nullptr;
+};
+
+}
+
+#endif
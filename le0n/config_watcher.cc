@@ -0,0 +1,168 @@
+#include "config_watcher.h"
+#include "config.h"
+#include "log.h"
+#include "util.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+namespace le0n{
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_NAME("system");
+
+ConfigWatcher::ConfigWatcher(const std::string& dir, uint64_t debounce_ms)
+    :m_dir(dir)
+    ,m_debounceMs(debounce_ms)
+    ,m_running(false)
+    ,m_reloadCount(0) {
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+}
+
+bool ConfigWatcher::start() {
+    if(m_running) {
+        return true;
+    }
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_inotifyFd < 0) {
+        LE0N_LOG_ERROR(g_logger) << "inotify_init1 failed errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    // 编辑器常见的保存方式是"写临时文件再 rename"，所以同时关注 MOVED_TO；
+    // 新建的符号链接只有 CREATE 事件
+    if(inotify_add_watch(m_inotifyFd, m_dir.c_str()
+                , IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        LE0N_LOG_ERROR(g_logger) << "inotify_add_watch dir=" << m_dir << " failed errno="
+            << errno << " errstr=" << strerror(errno);
+        close(m_inotifyFd);
+        m_inotifyFd = -1;
+        return false;
+    }
+    if(pipe2(m_wakeFds, O_CLOEXEC) != 0) {
+        close(m_inotifyFd);
+        m_inotifyFd = -1;
+        return false;
+    }
+
+    reload();
+    m_running = true;
+    m_thread = std::thread(std::bind(&ConfigWatcher::run, this));
+    return true;
+}
+
+void ConfigWatcher::stop() {
+    if(!m_running) {
+        return;
+    }
+    m_running = false;
+    char c = 0;
+    if(write(m_wakeFds[1], &c, 1) != 1) {
+        LE0N_LOG_ERROR(g_logger) << "ConfigWatcher wake failed errno=" << errno;
+    }
+    m_thread.join();
+    close(m_inotifyFd);
+    close(m_wakeFds[0]);
+    close(m_wakeFds[1]);
+    m_inotifyFd = m_wakeFds[0] = m_wakeFds[1] = -1;
+}
+
+void ConfigWatcher::run() {
+    struct pollfd fds[2];
+    fds[0].fd = m_inotifyFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_wakeFds[0];
+    fds[1].events = POLLIN;
+
+    bool pending = false;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while(m_running) {
+        // 有未处理的变化时，静默 m_debounceMs 后才 reload；期间每来一个事件就重新计时
+        int rt = poll(fds, 2, pending ? (int)m_debounceMs : -1);
+        if(rt < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            LE0N_LOG_ERROR(g_logger) << "ConfigWatcher poll failed errno=" << errno
+                << " errstr=" << strerror(errno);
+            break;
+        }
+        if(rt == 0) {
+            pending = false;
+            reload();
+            continue;
+        }
+        if(fds[1].revents) {
+            break;
+        }
+        while(true) {
+            ssize_t len = read(m_inotifyFd, buf, sizeof(buf));
+            if(len <= 0) {
+                break;
+            }
+            // 目录中任何变化都触发 reload，不只看 .yml/.yaml:
+            // 配置可能是指向其它名字的符号链接(如 Kubernetes ConfigMap 原子替换 ..data)，
+            // reload 会按后缀筛选文件、经 stat 跟随符号链接，只重新解析指纹变化的文件
+            pending = true;
+        }
+    }
+}
+
+size_t ConfigWatcher::reload() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_reloadCount;
+
+    std::vector<std::string> files;
+    FSUtil::ListAllFile(files, m_dir, ".yml");
+    FSUtil::ListAllFile(files, m_dir, ".yaml");
+    std::sort(files.begin(), files.end());
+
+    // 删除的文件只移除指纹，它设置过的配置保持当前值
+    for(auto it = m_stamps.begin(); it != m_stamps.end();) {
+        if(!std::binary_search(files.begin(), files.end(), it->first)) {
+            LE0N_LOG_INFO(g_logger) << "config file removed: " << it->first;
+            m_stamps.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    Config::ChangeList changes;
+    for(auto& file : files) {
+        struct stat st;
+        if(stat(file.c_str(), &st) != 0) {
+            continue;
+        }
+        FileStamp stamp;
+        stamp.ino = st.st_ino;
+        stamp.size = st.st_size;
+        stamp.mtime_ns = st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+        auto it = m_stamps.find(file);
+        if(it != m_stamps.end() && it->second == stamp) {
+            continue;
+        }
+        m_stamps[file] = stamp;
+        try {
+            Config::Diff(YAML::LoadFile(file), changes);
+        } catch (std::exception& e) {
+            LE0N_LOG_ERROR(g_logger) << "ConfigWatcher load file=" << file
+                << " failed: " << e.what();
+        }
+    }
+
+    // 解析和比较都已完成，这里只剩下发布变化的值
+    for(auto& i : changes) {
+        LE0N_LOG_INFO(g_logger) << "config changed: " << i.first;
+        i.second();
+    }
+    return changes.size();
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef __LE0N_CONFIG_WATCHER_H__
+#define __LE0N_CONFIG_WATCHER_H__
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+
+namespace le0n{
+
+/**
+ * @brief 配置目录热加载
+ * @details 用 inotify 监听目录下的 .yml/.yaml 文件(可以是符号链接)：
+ *  1. 目录中有任何变化后等待 debounce_ms 内没有新的变化再处理(编辑器保存往往产生一串事件；
+ *     符号链接原子替换时变化的是链接指向的名字，而不是 .yml 文件本身)
+ *  2. 只重新解析 mtime/size 变化过的文件，解析和比较都在监听线程完成
+ *  3. 通过 Config::Diff 找出值真正变化的配置项，只对这些项调用 setValue 并触发监听回调
+ *  注意: 同一个配置项不要在多个文件中重复定义，否则结果取决于哪个文件最后变化。
+ */
+class ConfigWatcher{
+public:
+    typedef std::shared_ptr<ConfigWatcher> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] dir 配置目录(不递归)
+     * @param[in] debounce_ms 去抖时间(毫秒)
+     */
+    ConfigWatcher(const std::string& dir, uint64_t debounce_ms = 200);
+    ~ConfigWatcher();
+
+    /**
+     * @brief 全量加载一次目录，然后启动监听线程
+     */
+    bool start();
+    void stop();
+
+    /**
+     * @brief 检查目录并应用变化
+     * @return 本次实际变化的配置项数量
+     */
+    size_t reload();
+
+    // reload 执行的次数
+    uint64_t getReloadCount() const { return m_reloadCount; }
+    const std::string& getDir() const { return m_dir; }
+private:
+    void run();
+private:
+    // 文件指纹，用于跳过没有变化的文件
+    struct FileStamp {
+        uint64_t ino = 0;
+        uint64_t size = 0;
+        uint64_t mtime_ns = 0;
+        bool operator==(const FileStamp& o) const {
+            return ino == o.ino && size == o.size && mtime_ns == o.mtime_ns;
+        }
+    };
+
+    std::string m_dir;
+    uint64_t m_debounceMs;
+    int m_inotifyFd = -1;
+    int m_wakeFds[2] = {-1, -1};                //用于 stop 时唤醒监听线程
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<uint64_t> m_reloadCount;
+    std::mutex m_mutex;                         //串行化 reload
+    std::map<std::string, FileStamp> m_stamps;  //文件名 -> 上次加载时的指纹
+};
+
+}
+
+#endif
@@ -0,0 +1,316 @@
+#include "hook.h"
+#include "config.h"
+#include "log.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_NAME("hook");
+
+namespace le0n {
+
+static le0n::ConfigVar<int>::ptr g_hook_slow_threshold =
+    le0n::Config::Lookup("hook.slow_threshold_us", (int)(10 * 1000), "hook slow syscall threshold(us)");
+
+// 慢调用阈值的缓存，每次拦截只做一次 relaxed load
+static std::atomic<int> s_slow_threshold(10 * 1000);
+
+struct _HookConfigIniter {
+    _HookConfigIniter() {
+        s_slow_threshold.store(g_hook_slow_threshold->getValue(), std::memory_order_relaxed);
+        g_hook_slow_threshold->addListener([](const int& old_value, const int& new_value){
+            s_slow_threshold.store(new_value, std::memory_order_relaxed);
+        });
+    }
+};
+
+static _HookConfigIniter s_hook_config_initer;
+
+static std::atomic<bool> s_hook_enable(false);
+// 记录慢调用日志期间关闭统计，避免日志输出本身又被拦截造成递归
+static thread_local bool t_hook_busy = false;
+
+#define HOOK_FUN(XX) \
+    XX(read) \
+    XX(write) \
+    XX(connect) \
+    XX(fsync) \
+    XX(sleep) \
+    XX(usleep) \
+    XX(nanosleep)
+
+void hook_init() {
+    static bool is_inited = false;
+    if(is_inited) {
+        return;
+    }
+#define XX(name) name ## _f = (name ## _fun)dlsym(RTLD_NEXT, #name);
+    HOOK_FUN(XX);
+#undef XX
+    is_inited = true;
+}
+
+struct _HookIniter {
+    _HookIniter() {
+        hook_init();
+    }
+};
+
+static _HookIniter s_hook_initer;
+
+bool is_hook_enable() {
+    return s_hook_enable.load(std::memory_order_relaxed) && !t_hook_busy;
+}
+
+void set_hook_enable(bool flag) {
+    s_hook_enable.store(flag, std::memory_order_relaxed);
+}
+
+const char* HookSyscallToString(HookSyscall id) {
+    switch(id) {
+#define XX(name, str) \
+        case name: \
+            return #str;
+    XX(HOOK_READ, read);
+    XX(HOOK_WRITE, write);
+    XX(HOOK_CONNECT, connect);
+    XX(HOOK_FSYNC, fsync);
+    XX(HOOK_SLEEP, sleep);
+    XX(HOOK_USLEEP, usleep);
+    XX(HOOK_NANOSLEEP, nanosleep);
+#undef XX
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief 线程私有的统计数据
+ * @details 只有所属线程写入(relaxed load + store，不需要原子的读改写)，
+ *  汇总线程 relaxed 读取。线程退出时并入已退出线程的汇总后释放。
+ */
+struct HookThreadStat {
+    struct Item {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total_ns;
+        std::atomic<uint64_t> max_ns;
+        std::atomic<uint64_t> slow;
+        std::atomic<uint64_t> buckets[HOOK_BUCKETS];
+    };
+    Item items[HOOK_MAX];
+};
+
+static inline void Inc(std::atomic<uint64_t>& v, uint64_t n) {
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// 存活线程的统计对象和已退出线程的汇总
+struct HookStats {
+    std::mutex mutex;
+    std::vector<HookThreadStat*> threads;
+    HookThreadStat retired;
+};
+
+// 进程退出时不析构，退出较晚的线程仍可并入汇总
+static HookStats& GetHookStats() {
+    static HookStats* s_stats = new HookStats();
+    return *s_stats;
+}
+
+static inline void Add(std::atomic<uint64_t>& to, const std::atomic<uint64_t>& from) {
+    Inc(to, from.load(std::memory_order_relaxed));
+}
+
+static thread_local HookThreadStat* t_stat = nullptr;
+// 线程退出时的统计对象持有者已析构，之后的调用不再统计
+static thread_local bool t_stat_destroyed = false;
+
+// 线程退出时把统计并入汇总并释放
+struct HookThreadStatHolder {
+    ~HookThreadStatHolder() {
+        t_stat_destroyed = true;
+        if(!t_stat) {
+            return;
+        }
+        HookStats& stats = GetHookStats();
+        {
+            std::lock_guard<std::mutex> lock(stats.mutex);
+            for(int i = 0; i < HOOK_MAX; ++i) {
+                HookThreadStat::Item& from = t_stat->items[i];
+                HookThreadStat::Item& to = stats.retired.items[i];
+                Add(to.count, from.count);
+                Add(to.total_ns, from.total_ns);
+                Add(to.slow, from.slow);
+                to.max_ns.store(std::max(to.max_ns.load(std::memory_order_relaxed)
+                                         ,from.max_ns.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+                for(int j = 0; j < HOOK_BUCKETS; ++j) {
+                    Add(to.buckets[j], from.buckets[j]);
+                }
+            }
+            stats.threads.erase(std::find(stats.threads.begin(), stats.threads.end(), t_stat));
+        }
+        delete t_stat;
+        t_stat = nullptr;
+    }
+};
+
+static HookThreadStat* GetThreadStat() {
+    if(!t_stat && !t_stat_destroyed) {
+        static thread_local HookThreadStatHolder t_holder;
+        (void)t_holder;
+        // 值初始化，所有计数器清零
+        t_stat = new HookThreadStat();
+        HookStats& stats = GetHookStats();
+        std::lock_guard<std::mutex> lock(stats.mutex);
+        stats.threads.push_back(t_stat);
+    }
+    return t_stat;
+}
+
+static inline uint64_t NowNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void Record(HookSyscall id, int fd, uint64_t ns) {
+    HookThreadStat* stat = GetThreadStat();
+    if(!stat) {
+        return;
+    }
+    HookThreadStat::Item& item = stat->items[id];
+    uint64_t us = ns / 1000;
+    int bucket = us ? 64 - __builtin_clzll(us) : 0;
+    if(bucket >= HOOK_BUCKETS) {
+        bucket = HOOK_BUCKETS - 1;
+    }
+    Inc(item.count, 1);
+    Inc(item.total_ns, ns);
+    Inc(item.buckets[bucket], 1);
+    if(ns > item.max_ns.load(std::memory_order_relaxed)) {
+        item.max_ns.store(ns, std::memory_order_relaxed);
+    }
+
+    int threshold = s_slow_threshold.load(std::memory_order_relaxed);
+    if(threshold >= 0 && us >= (uint64_t)threshold) {
+        Inc(item.slow, 1);
+        t_hook_busy = true;
+        LE0N_LOG_WARN(g_logger) << "slow syscall " << HookSyscallToString(id)
+            << " fd=" << fd << " cost=" << us << "us threshold=" << threshold << "us";
+        t_hook_busy = false;
+    }
+}
+
+/**
+ * @brief 计时执行原始调用
+ * @details 未开启时只多一次开关判断；开启时前后各读一次时钟，并保持 errno 不变
+ */
+template<typename OriginFun, typename... Args>
+static auto do_timed(HookSyscall id, int fd, OriginFun& fun, Args&&... args)
+        -> decltype(fun(std::forward<Args>(args)...)) {
+    if(!fun) {
+        hook_init();
+    }
+    if(!is_hook_enable()) {
+        return fun(std::forward<Args>(args)...);
+    }
+    uint64_t begin = NowNS();
+    auto rt = fun(std::forward<Args>(args)...);
+    int err = errno;
+    Record(id, fd, NowNS() - begin);
+    errno = err;
+    return rt;
+}
+
+HookStat GetHookStat(HookSyscall id) {
+    HookStat rt;
+    HookStats& stats = GetHookStats();
+    std::lock_guard<std::mutex> lock(stats.mutex);
+    auto sum = [&rt, id](HookThreadStat* stat) {
+        HookThreadStat::Item& item = stat->items[id];
+        rt.count += item.count.load(std::memory_order_relaxed);
+        rt.total_ns += item.total_ns.load(std::memory_order_relaxed);
+        rt.slow += item.slow.load(std::memory_order_relaxed);
+        rt.max_ns = std::max(rt.max_ns, item.max_ns.load(std::memory_order_relaxed));
+        for(int j = 0; j < HOOK_BUCKETS; ++j) {
+            rt.buckets[j] += item.buckets[j].load(std::memory_order_relaxed);
+        }
+    };
+    sum(&stats.retired);
+    for(auto& i : stats.threads) {
+        sum(i);
+    }
+    return rt;
+}
+
+size_t GetHookThreadCount() {
+    HookStats& stats = GetHookStats();
+    std::lock_guard<std::mutex> lock(stats.mutex);
+    return stats.threads.size();
+}
+
+std::string DumpHookStats() {
+    std::stringstream ss;
+    for(int i = 0; i < HOOK_MAX; ++i) {
+        HookStat stat = GetHookStat((HookSyscall)i);
+        if(stat.count == 0) {
+            continue;
+        }
+        ss << HookSyscallToString((HookSyscall)i)
+           << " count=" << stat.count
+           << " avg=" << stat.total_ns / stat.count / 1000.0 << "us"
+           << " max=" << stat.max_ns / 1000.0 << "us"
+           << " slow=" << stat.slow
+           << " hist={";
+        bool first = true;
+        for(int j = 0; j < HOOK_BUCKETS; ++j) {
+            if(!stat.buckets[j]) {
+                continue;
+            }
+            ss << (first ? "" : ", ") << "<" << (1ull << j) << "us:" << stat.buckets[j];
+            first = false;
+        }
+        ss << "}" << std::endl;
+    }
+    return ss.str();
+}
+
+}
+
+extern "C" {
+#define XX(name) name ## _fun name ## _f = nullptr;
+    HOOK_FUN(XX);
+#undef XX
+
+ssize_t read(int fd, void *buf, size_t count) {
+    return le0n::do_timed(le0n::HOOK_READ, fd, read_f, fd, buf, count);
+}
+
+ssize_t write(int fd, const void *buf, size_t count) {
+    return le0n::do_timed(le0n::HOOK_WRITE, fd, write_f, fd, buf, count);
+}
+
+int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
+    return le0n::do_timed(le0n::HOOK_CONNECT, sockfd, connect_f, sockfd, addr, addrlen);
+}
+
+int fsync(int fd) {
+    return le0n::do_timed(le0n::HOOK_FSYNC, fd, fsync_f, fd);
+}
+
+unsigned int sleep(unsigned int seconds) {
+    return le0n::do_timed(le0n::HOOK_SLEEP, -1, sleep_f, seconds);
+}
+
+int usleep(useconds_t usec) {
+    return le0n::do_timed(le0n::HOOK_USLEEP, -1, usleep_f, usec);
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem) {
+    return le0n::do_timed(le0n::HOOK_NANOSLEEP, -1, nanosleep_f, req, rem);
+}
+
+}
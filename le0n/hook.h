@@ -0,0 +1,87 @@
+#ifndef __LE0N_HOOK_H__
+#define __LE0N_HOOK_H__
+
+#include <string>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+/**
+ * @brief 阻塞系统调用耗时统计(可选组件，链接 le0n_hook 库后生效)
+ * @details 通过 dlsym(RTLD_NEXT) 拦截 read/write/connect/fsync/sleep 等调用，
+ *  每次调用只增加两次时钟读取和几次线程私有计数器写入；
+ *  耗时超过配置 hook.slow_threshold_us 时通过 "hook" 日志器输出 WARN。
+ */
+namespace le0n {
+
+enum HookSyscall {
+    HOOK_READ = 0,
+    HOOK_WRITE,
+    HOOK_CONNECT,
+    HOOK_FSYNC,
+    HOOK_SLEEP,
+    HOOK_USLEEP,
+    HOOK_NANOSLEEP,
+    HOOK_MAX
+};
+
+// 直方图按耗时(微秒)的 2 的幂分桶: 桶 0 为 <1us，桶 i 为 [2^(i-1), 2^i) us
+static const int HOOK_BUCKETS = 32;
+
+struct HookStat {
+    uint64_t count = 0;         //调用次数
+    uint64_t total_ns = 0;      //累计耗时
+    uint64_t max_ns = 0;        //最大耗时
+    uint64_t slow = 0;          //超过阈值的次数
+    uint64_t buckets[HOOK_BUCKETS] = {0};
+};
+
+// 全局开关，默认关闭
+bool is_hook_enable();
+void set_hook_enable(bool flag);
+
+const char* HookSyscallToString(HookSyscall id);
+
+/**
+ * @brief 汇总所有线程的统计数据(包括已退出线程)
+ */
+HookStat GetHookStat(HookSyscall id);
+
+// 存活线程的统计对象数，线程退出时统计并入汇总后释放
+size_t GetHookThreadCount();
+
+/**
+ * @brief 输出所有系统调用的统计(次数、平均、最大耗时和非空的直方图桶)
+ */
+std::string DumpHookStats();
+
+}
+
+extern "C" {
+
+typedef ssize_t (*read_fun)(int fd, void *buf, size_t count);
+extern read_fun read_f;
+
+typedef ssize_t (*write_fun)(int fd, const void *buf, size_t count);
+extern write_fun write_f;
+
+typedef int (*connect_fun)(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
+extern connect_fun connect_f;
+
+typedef int (*fsync_fun)(int fd);
+extern fsync_fun fsync_f;
+
+typedef unsigned int (*sleep_fun)(unsigned int seconds);
+extern sleep_fun sleep_f;
+
+typedef int (*usleep_fun)(useconds_t usec);
+extern usleep_fun usleep_f;
+
+typedef int (*nanosleep_fun)(const struct timespec *req, struct timespec *rem);
+extern nanosleep_fun nanosleep_f;
+
+}
+
+#endif
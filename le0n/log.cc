@@ -1,10 +1,24 @@
 #include "log.h"
+#include "log_index.h"
+#include "log_budget.h"
 #include <map>
+#include <set>
+#include <chrono>
+#include <thread>
+#include <algorithm>
 #include <iostream>
 #include <functional>
 #include <time.h>
 #include <string.h>
+#include <strings.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 
 namespace le0n{
 
@@ -30,13 +44,269 @@ const char* LogLevel::ToString(LogLevel::Level level){
     return "UNKNOWN";
 }
 
+LogLevel::Level LogLevel::FromString(const std::string& str){
+#define XX(name) \
+    if(strcasecmp(str.c_str(), #name) == 0){ \
+        return LogLevel::name; \
+    }
+    XX(DEBUG);
+    XX(INFO);
+    XX(WARN);
+    XX(ERROR);
+    XX(FATAL);
+#undef XX
+    return LogLevel::UNKNOWN;
+}
+
+/**
+ * @brief 写完整个缓冲区(处理 EINTR 和部分写入)
+ */
+static bool WriteAll(int fd, const char* data, size_t len){
+    while(len > 0){
+        ssize_t n = write(fd, data, len);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief 直接追加到 std::string 的 streambuf，格式器写入时不经过 stringstream 的中间缓冲
+ */
+class StringAppendBuf : public std::streambuf{
+public:
+    void setTarget(std::string* str) { m_str = str; }
+protected:
+    virtual int_type overflow(int_type c) override {
+        if(c != traits_type::eof()){
+            m_str->push_back((char)c);
+        }
+        return c;
+    }
+    virtual std::streamsize xsputn(const char* s, std::streamsize n) override {
+        m_str->append(s, n);
+        return n;
+    }
+private:
+    std::string* m_str = nullptr;
+};
+
+// 00 01 02 ... 99，整数每次转换两位
+static const char s_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * @brief 从 end 往前写 v 的十进制表示
+ * @return 第一个字符的位置
+ */
+static char* FormatUInt(char* end, unsigned long long v){
+    char* p = end;
+    while(v >= 100){
+        unsigned idx = (v % 100) * 2;
+        v /= 100;
+        *--p = s_digit_pairs[idx + 1];
+        *--p = s_digit_pairs[idx];
+    }
+    if(v >= 10){
+        unsigned idx = v * 2;
+        *--p = s_digit_pairs[idx + 1];
+        *--p = s_digit_pairs[idx];
+    } else {
+        *--p = '0' + v;
+    }
+    return p;
+}
+
+/**
+ * @brief 输出能精确还原的最短浮点数
+ * @details 按 %.{min}g 到 %.{max}g 依次尝试，第一个读回来和原值相等的就是答案；
+ *  大多数日志里的浮点数在第一次就能还原
+ */
+template<class T>
+static size_t FormatFloat(char* buf, size_t size, T v, int min, int max){
+    int len = 0;
+    for(int prec = min; prec <= max; ++prec){
+        len = snprintf(buf, size, "%.*g", prec, (double)v);
+        if(prec == max || (T)strtod(buf, nullptr) == v){
+            break;
+        }
+    }
+    return len;
+}
+
+static const double s_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+    1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+};
+
+/**
+ * @brief 小数位数不多的浮点数(日志里最常见的耗时、比例等)不经过 snprintf/strtod
+ * @details 找最小的 d 使 x = round(v * 10^d) 满足 x / 10^d == v：
+ *  x 和 10^d 都能精确表示时除法是正确舍入的，结果就是离 x·10^-d 最近的 double，
+ *  所以 "x·10^-d" 一定能还原成 v，d 最小也就是最短。只处理 %g 不会用科学计数法的范围
+ */
+static bool FormatDoubleFast(std::string& out, double v){
+    double a = v < 0 ? -v : v;
+    if(!(a >= 1e-4 && a < 1e15)){
+        return false;
+    }
+    for(int d = 0; d < (int)(sizeof(s_pow10) / sizeof(s_pow10[0])); ++d){
+        double scaled = a * s_pow10[d];
+        if(scaled >= 9007199254740992.0){
+            // 超过 2^53，整数部分不再精确
+            return false;
+        }
+        unsigned long long x = (unsigned long long)(scaled + 0.5);
+        if((double)x / s_pow10[d] != a){
+            continue;
+        }
+        char buf[48];
+        char* end = buf + sizeof(buf);
+        char* p = FormatUInt(end, x);
+        if(d > 0){
+            // 补足前导零后插入小数点
+            while(end - p <= d){
+                *--p = '0';
+            }
+            char* dot = end - d;
+            memmove(p - 1, p, dot - p);
+            --p;
+            *(dot - 1) = '.';
+        }
+        if(v < 0){
+            *--p = '-';
+        }
+        out.append(p, end - p);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief LogStream 处理不了的类型和操纵符使用的 ostream，直接写入 LogStream 的缓冲区
+ */
+struct LogStream::Fallback{
+    Fallback(std::string* str)
+        :os(&sbuf){
+        sbuf.setTarget(str);
+    }
+    StringAppendBuf sbuf;
+    std::ostream os;
+};
+
+LogStream::LogStream(){
+}
+
+LogStream::~LogStream(){
+    delete m_fallback;
+}
+
+std::ostream& LogStream::stream(){
+    if(!m_fallback){
+        m_fallback = new Fallback(&m_buf);
+    }
+    return m_fallback->os;
+}
+
+void LogStream::updateState(){
+    std::ostream& os = m_fallback->os;
+    m_useStream = os.flags() != (std::ios_base::dec | std::ios_base::skipws)
+        || os.precision() != 6 || os.width() != 0 || os.fill() != ' ';
+}
+
+LogStream& LogStream::operator<<(OstreamManip manip){
+    manip(stream());
+    updateState();
+    return *this;
+}
+
+LogStream& LogStream::operator<<(IosBaseManip manip){
+    manip(stream());
+    updateState();
+    return *this;
+}
+
+LogStream& LogStream::appendInt(long long v){
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    // 取绝对值时避免 LLONG_MIN 溢出
+    unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : v;
+    char* p = FormatUInt(end, u);
+    if(v < 0){
+        *--p = '-';
+    }
+    m_buf.append(p, end - p);
+    return *this;
+}
+
+LogStream& LogStream::appendUInt(unsigned long long v){
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = FormatUInt(end, v);
+    m_buf.append(p, end - p);
+    return *this;
+}
+
+LogStream& LogStream::appendFloat(float v){
+    char buf[32];
+    m_buf.append(buf, FormatFloat(buf, sizeof(buf), v, 6, 9));
+    return *this;
+}
+
+LogStream& LogStream::appendDouble(double v){
+    if(FormatDoubleFast(m_buf, v)){
+        return *this;
+    }
+    char buf[32];
+    m_buf.append(buf, FormatFloat(buf, sizeof(buf), v, 15, 17));
+    return *this;
+}
+
+LogStream& LogStream::appendPointer(const void* v){
+    // 与 ostream 一致: 空指针输出 0，其他输出 0x 加十六进制
+    uintptr_t u = (uintptr_t)v;
+    if(!u){
+        m_buf.push_back('0');
+        return *this;
+    }
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    while(u){
+        *--p = "0123456789abcdef"[u & 0xf];
+        u >>= 4;
+    }
+    *--p = 'x';
+    *--p = '0';
+    m_buf.append(p, end - p);
+    return *this;
+}
+
 /**
  * @brief LogEventWrap 构造函数
  * @param e LogEvent 的智能指针
  */
 LogEventWrap::LogEventWrap(LogEvent::ptr e)
     :m_event(e) {
-
+    if(e->getLevel() >= LogBacktrace::GetCaptureLevel()){
+        // 跳过本函数，#0 是打日志的函数
+        e->setBacktrace(LogBacktrace::Capture(1));
+    }
 }
 
 /**
@@ -48,7 +318,7 @@ LogEventWrap::~LogEventWrap() {
     m_event->getLogger()->log(m_event->getLevel(), m_event);
 }
 
-std::stringstream& LogEventWrap::getSS() {
+LogStream& LogEventWrap::getSS() {
     return m_event->getSS();
 }
 
@@ -74,7 +344,7 @@ void LogEvent::format(const char* fmt, va_list al){
     // vasprintf 会自动分配内存存储格式化后的字符串
     int len = vasprintf(&buf, fmt, al);
     if(len != -1){
-        m_ss << std::string(buf, len);
+        m_ss.append(buf, len);
         free(buf); // vasprintf 分配的内存需要手动释放，uaf可能
     }
 }
@@ -87,7 +357,7 @@ void LogEvent::format(const char* fmt, va_list al){
 class MessageFormatItem : public LogFormatter::FormatItem{
 public:
     MessageFormatItem(const std::string& str = ""){}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         os << event->getContent(); // %m: 消息体
     }
 };
@@ -95,7 +365,7 @@ public:
 class LevelFormatItem : public LogFormatter::FormatItem{
 public:
     LevelFormatItem(const std::string& str = ""){}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         os << LogLevel::ToString(level); // %p: 日志级别
     }
 };
@@ -103,7 +373,7 @@ public:
 class ElapseFormatItem : public LogFormatter::FormatItem{
 public:
     ElapseFormatItem(const std::string& str = ""){}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         os << event->getElapse(); // %r: 启动后的毫秒数
     }
 };
@@ -111,7 +381,7 @@ public:
 class NameFormatItem : public LogFormatter::FormatItem{
 public:
     NameFormatItem(const std::string& str = ""){}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         os << logger->getName(); // %c: 日志器名称
     }
 };
@@ -119,7 +389,7 @@ public:
 class ThreadIdFormatItem : public LogFormatter::FormatItem{
 public:
     ThreadIdFormatItem(const std::string& str = ""){}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {    
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {    
         os << event->getThreadId(); // %t: 线程ID
     }
 };
@@ -127,7 +397,7 @@ public:
 class FiberIdFormatItem : public LogFormatter::FormatItem{
 public:
     FiberIdFormatItem(const std::string& str = ""){}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         os << event->getFiberId(); // %F: 协程ID
     }
 };
@@ -141,7 +411,7 @@ public:
             m_format = "%Y-%m-%d %H:%M:%S";
         }
     }
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         struct tm tm;
         time_t time = event->getTime();
         localtime_r(&time, &tm); // 线程安全的时间转换
@@ -156,7 +426,7 @@ private:
 class FilenameFormatItem : public LogFormatter::FormatItem{
 public:
     FilenameFormatItem(const std::string& str = ""){}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         os << event->getFile(); // %f: 文件名
     }
 };
@@ -164,7 +434,7 @@ public:
 class LineFormatItem : public LogFormatter::FormatItem{
 public:
     LineFormatItem(const std::string& str = ""){}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         os << event->getLine(); // %l: 行号
     }
 };
@@ -172,7 +442,7 @@ public:
 class NewLineFormatItem : public LogFormatter::FormatItem{
 public:
     NewLineFormatItem(const std::string& str = ""){}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         os << std::endl; // %n: 换行符
     }
 };
@@ -181,28 +451,121 @@ class StringFormatItem : public LogFormatter::FormatItem{
 public:
     StringFormatItem(const std::string& str)
         :m_string(str) {}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         os << m_string; // 普通字符串
     }
 private:
     std::string m_string;
 };
 
+class ContextFormatItem : public LogFormatter::FormatItem{
+public:
+    // %X{key}: 上下文字段；%X: 所有字段，外层在前，key=value 以空格分隔
+    ContextFormatItem(const std::string& key = "")
+        :m_key(key) {}
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
+        const LogContextNode* ctx = event->getContext().get();
+        if(!m_key.empty()){
+            const std::string* v = LogContext::Find(ctx, m_key);
+            if(v){
+                os << *v;
+            }
+            return;
+        }
+        std::vector<const LogContextNode*> nodes;
+        for(; ctx; ctx = ctx->parent.get()){
+            nodes.push_back(ctx);
+        }
+        for(auto it = nodes.rbegin(); it != nodes.rend(); ++it){
+            if(it != nodes.rbegin()){
+                os << ' ';
+            }
+            os << (*it)->key << '=' << (*it)->value;
+        }
+    }
+private:
+    std::string m_key;
+};
+
+class BacktraceFormatItem : public LogFormatter::FormatItem{
+public:
+    // %s{LEVEL}: 不低于 LEVEL 的日志输出调用栈，默认 ERROR；存活期间让打日志的线程抓栈
+    BacktraceFormatItem(const std::string& level = "")
+        :m_level(LogLevel::FromString(level)) {
+        if(m_level == LogLevel::UNKNOWN){
+            m_level = LogLevel::ERROR;
+        }
+        LogBacktrace::Require(m_level);
+    }
+    ~BacktraceFormatItem() {
+        LogBacktrace::Unrequire(m_level);
+    }
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
+        const LogBacktrace::ptr& bt = event->getBacktrace();
+        if(bt && level >= m_level){
+            bt->format(os);
+        }
+    }
+private:
+    LogLevel::Level m_level;
+};
+
 class TabFormatItem : public LogFormatter::FormatItem{
 public:
     TabFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+    void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override {
         os << "\t"; // %T: Tab
     }
 private:
     std::string m_string;
 };
 
+// 线程当前的上下文链头
+static thread_local LogContextNode::ptr t_log_context;
+
+const LogContextNode::ptr& LogContext::Current(){
+    return t_log_context;
+}
+
+const std::string* LogContext::Find(const LogContextNode* ctx, const std::string& key){
+    for(; ctx; ctx = ctx->parent.get()){
+        if(ctx->key == key){
+            return &ctx->value;
+        }
+    }
+    return nullptr;
+}
+
+std::function<void()> LogContext::Wrap(std::function<void()> cb){
+    LogContextNode::ptr ctx = t_log_context;
+    if(!ctx){
+        return cb;
+    }
+    return [ctx, cb](){
+        LogContextGuard guard(ctx);
+        cb();
+    };
+}
+
+LogContextGuard::LogContextGuard(const std::string& key, const std::string& value)
+    :m_prev(t_log_context){
+    t_log_context = std::make_shared<const LogContextNode>(key, value, m_prev);
+}
+
+LogContextGuard::LogContextGuard(const LogContextNode::ptr& ctx)
+    :m_prev(t_log_context){
+    t_log_context = ctx;
+}
+
+LogContextGuard::~LogContextGuard(){
+    t_log_context.swap(m_prev);
+}
+
 /**
  * @brief LogEvent 构造函数
  * 初始化所有日志事件属性
  */
-LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level
+LogEvent::LogEvent(Logger* logger, LogLevel::Level level
             , const char* file, int32_t line, uint32_t elapse
             , uint32_t thread_id, uint32_t fiber_id, uint64_t time)
     :m_file(file)
@@ -211,6 +574,7 @@ LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level
     ,m_threadId(thread_id)
     ,m_fiberId(fiber_id)
     ,m_time(time)
+    ,m_context(LogContext::Current())
     ,m_logger(logger)
     ,m_level(level) {
 
@@ -251,72 +615,691 @@ void Logger::delAppender(LogAppender::ptr appender){
     }
 }
 
+void Logger::clearAppenders(){
+    m_appenders.clear();
+}
+
+void LogAppender::logBatch(const LogEvent::ptr* events, size_t count){
+    for(size_t i = 0; i < count; ++i){
+        log(events[i]->getLogger(), events[i]->getLevel(), events[i]);
+    }
+}
+
+__thread int ScopedLogLevel::t_level = ScopedLogLevel::NONE;
+
+std::function<void()> ScopedLogLevel::Wrap(std::function<void()> cb){
+    int level = t_level;
+    if(level == NONE){
+        return cb;
+    }
+    return [level, cb](){
+        ScopedLogLevel scoped(level);
+        cb();
+    };
+}
+
 /**
  * @brief 核心日志方法
  * 当日志级别满足要求时，分发给所有 Appender
  */
-void Logger::log(LogLevel::Level level,LogEvent::ptr event){
-    if(level >= m_level){
-        auto self = shared_from_this();
-        for(auto& i : m_appenders){
-            i->log(self,level,event);
+void Logger::log(LogLevel::Level level, const LogEvent::ptr& event){
+    if(level >= m_level || level >= ScopedLogLevel::Get()){
+        m_metrics.addEvent(level);
+        // 自己没有 Appender 时借用 root 的 Appender，但日志名称仍然是自己的
+        auto& appenders = (m_appenders.empty() && m_root) ? m_root->m_appenders : m_appenders;
+        for(auto& i : appenders){
+            i->log(this, level, event);
+        }
+    }
+}
+
+void Logger::logBatch(const LogEvent::ptr* events, size_t count){
+    // 大多数情况下整批都满足级别，直接透传，不复制
+    int min_level = std::min<int>(m_level, ScopedLogLevel::Get());
+    size_t i = 0;
+    while(i < count && events[i]->getLevel() >= min_level){
+        ++i;
+    }
+    std::vector<LogEvent::ptr> filtered;
+    if(i < count){
+        filtered.assign(events, events + i);
+        for(; i < count; ++i){
+            if(events[i]->getLevel() >= min_level){
+                filtered.push_back(events[i]);
+            }
         }
+        events = filtered.data();
+        count = filtered.size();
+    }
+    if(count == 0){
+        return;
+    }
+    for(size_t j = 0; j < count; ++j){
+        m_metrics.addEvent(events[j]->getLevel());
+    }
+    auto& appenders = (m_appenders.empty() && m_root) ? m_root->m_appenders : m_appenders;
+    for(auto& a : appenders){
+        a->logBatch(events, count);
     }
 }
 
 // --- 下面是各种级别的快捷入口 ---
 
-void Logger::debug(LogEvent::ptr event){
+void Logger::debug(const LogEvent::ptr& event){
     log(LogLevel::DEBUG,event);
 }
 
-void Logger::info(LogEvent::ptr event){
+void Logger::info(const LogEvent::ptr& event){
     log(LogLevel::INFO,event);
 }
-void Logger::warn(LogEvent::ptr event){
+void Logger::warn(const LogEvent::ptr& event){
     log(LogLevel::WARN,event);
 }
 
-void Logger::error(LogEvent::ptr event){
+void Logger::error(const LogEvent::ptr& event){
     log(LogLevel::ERROR,event);
 }
 
-void Logger::fatal(LogEvent::ptr event){
+void Logger::fatal(const LogEvent::ptr& event){
     log(LogLevel::FATAL,event);
 }
 
-FileLogAppender::FileLogAppender(const std::string& filename)
-    :m_filename(filename){
+/**
+ * @brief 定时写出 FileLogAppender 的用户态缓冲区和各线程的控制台缓冲区
+ * @details 1. 所有 FileLogAppender 构造时登记、析构时注销，后台线程每 LOG_FLUSH_INTERVAL_MS 持锁写出一遍，
+ *     再调用 AddFlushTimer 登记的 Appender 的 onFlushTimer 和 StdoutLogAppender::Flush，
+ *     空闲的 Appender、不再打日志的线程缓冲的日志也能按时输出；
+ *     进程正常退出时再写出一遍；
+ *  2. fork 前持有 mutex、每个 Appender 的 m_writeMutex 和控制台缓冲区的锁并写出缓冲，直到 fork 返回才释放:
+ *     子进程不会继承被其他线程持有的锁，也不会把父进程缓冲的日志再写一次；
+ *     子进程里没有后台线程，下一次写日志时重新启动。
+ *  锁的顺序: mutex -> FileLogAppender::m_writeMutex / onFlushTimer 内 Appender 自己的锁 -> 控制台缓冲区的锁
+ */
+struct LogFlusher {
+    std::mutex mutex;
+    std::set<FileLogAppender*> files;
+    std::set<LogAppender*> timers;      //AddFlushTimer 登记的 Appender
+    std::atomic<bool> running{false};
+
+    static void PrepareFork();
+    static void ParentFork();
+    static void ChildFork();
+};
+
+static const uint64_t LOG_FLUSH_INTERVAL_MS = 50;
+
+// 控制台缓冲区在 fork 时的处理，定义在 StdoutBuffer 之后
+static void StdoutPrepareFork();
+static void StdoutParentFork();
+static void StdoutChildFork();
+
+// 进程退出时不析构，退出较晚的线程仍可使用
+static LogFlusher& GetLogFlusher(){
+    static LogFlusher* s_flusher = new LogFlusher;
+    return *s_flusher;
+}
+
+static void FlushAll(){
+    LogFlusher& f = GetLogFlusher();
+    std::lock_guard<std::mutex> lock(f.mutex);
+    for(auto i : f.files){
+        i->flush();
+    }
+    for(auto i : f.timers){
+        i->onFlushTimer();
+    }
+}
+
+static void LogFlushThread(){
+    while(true){
+        std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+        FlushAll();
+        StdoutLogAppender::Flush();
+    }
+}
+
+void LogFlusher::PrepareFork(){
+    LogFlusher& f = GetLogFlusher();
+    f.mutex.lock();
+    for(auto i : f.files){
+        i->m_writeMutex.lock();
+        i->flushLocked();
+    }
+    StdoutPrepareFork();
+}
+
+void LogFlusher::ParentFork(){
+    StdoutParentFork();
+    LogFlusher& f = GetLogFlusher();
+    for(auto i : f.files){
+        i->m_writeMutex.unlock();
+    }
+    f.mutex.unlock();
+}
+
+void LogFlusher::ChildFork(){
+    StdoutChildFork();
+    LogFlusher& f = GetLogFlusher();
+    for(auto i : f.files){
+        // fork 前已经写出，这里只是保证子进程从空缓冲区开始
+        i->m_buffer.clear();
+        i->m_bufferLevels = 0;
+        i->m_bufferCount = 0;
+        i->m_writeMutex.unlock();
+    }
+    f.running.store(false, std::memory_order_relaxed);
+    f.mutex.unlock();
+}
+
+// 注册 fork 处理函数和退出时的写出(只注册一次)
+static void InstallLogForkHandlers(){
+    static bool s_init = (pthread_atfork(LogFlusher::PrepareFork, LogFlusher::ParentFork, LogFlusher::ChildFork) == 0
+                          && atexit(FlushAll) == 0);
+    (void)s_init;
+}
+
+// 启动后台线程(本进程还没有时)，调用方不能持有 m_writeMutex 和控制台缓冲区的锁
+static void EnsureLogFlusher(){
+    LogFlusher& f = GetLogFlusher();
+    if(f.running.load(std::memory_order_relaxed)){
+        return;
+    }
+    InstallLogForkHandlers();
+    std::lock_guard<std::mutex> lock(f.mutex);
+    if(!f.running.load(std::memory_order_relaxed)){
+        std::thread(LogFlushThread).detach();
+        f.running.store(true, std::memory_order_relaxed);
+    }
+}
+
+void LogAppender::AddFlushTimer(LogAppender* appender){
+    EnsureLogFlusher();
+    LogFlusher& f = GetLogFlusher();
+    std::lock_guard<std::mutex> lock(f.mutex);
+    f.timers.insert(appender);
+}
+
+void LogAppender::DelFlushTimer(LogAppender* appender){
+    LogFlusher& f = GetLogFlusher();
+    std::lock_guard<std::mutex> lock(f.mutex);
+    f.timers.erase(appender);
+}
+
+FileLogAppender::FileLogAppender(const std::string& filename, bool append)
+    :m_filename(filename)
+    ,m_append(append){
     reopen(); // 新增：构造时打开文件
+    EnsureLogFlusher();
+    LogFlusher& f = GetLogFlusher();
+    std::lock_guard<std::mutex> lock(f.mutex);
+    f.files.insert(this);
+}
+
+FileLogAppender::~FileLogAppender(){
+    {
+        LogFlusher& f = GetLogFlusher();
+        std::lock_guard<std::mutex> lock(f.mutex);
+        f.files.erase(this);
+    }
+    flush();
+    if(m_fd >= 0){
+        close(m_fd);
+    }
 }
 
 bool FileLogAppender::reopen(){
-    if(m_filestream) {
-        m_filestream.close();
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    flushLocked();
+    return openFile();
+}
+
+void FileLogAppender::flush(){
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    flushLocked();
+}
+
+void FileLogAppender::setBufferSize(size_t size){
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    flushLocked();
+    m_bufferSize = size;
+}
+
+bool FileLogAppender::openFile(){
+    if(m_fd >= 0) {
+        close(m_fd);
+    }
+    m_fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC
+                | (m_append ? 0 : O_TRUNC), 0644);
+    if(m_fd < 0){
+        m_metrics.add(LogMetrics::ERRORS);
+        std::cerr << "FileLogAppender open " << m_filename << " failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    fstat(m_fd, &st);
+    m_dev = st.st_dev;
+    m_ino = st.st_ino;
+    if(m_index){
+        // 日志文件是新的(或被清空)时，旧索引作废
+        m_index->open(!m_append || st.st_size == 0);
+    }
+    return true;
+}
+
+void FileLogAppender::setIndex(uint64_t block_size){
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    flushLocked();
+    m_index.reset(new LogIndexWriter(m_filename, block_size));
+    // 构造时已经打开过日志文件(可能清空了)，按文件当前大小判断
+    m_index->open(m_fd < 0 || lseek(m_fd, 0, SEEK_END) == 0);
+}
+
+void FileLogAppender::setShared(uint64_t max_size, uint32_t max_backups){
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    flushLocked();
+    m_append = true;
+    m_maxSize = max_size;
+    m_maxBackups = max_backups;
+}
+
+void FileLogAppender::rotate(){
+    // 每次重新打开锁文件: flock 的锁属于打开的文件表项，fork 前打开的 fd 会被父子进程共用
+    int lock_fd = open((m_filename + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(lock_fd < 0){
+        m_metrics.add(LogMetrics::ERRORS);
+        return;
     }
-    m_filestream.open(m_filename);
-    return !!m_filestream;//0->false,其他->true
+    while(flock(lock_fd, LOCK_EX) != 0 && errno == EINTR);
+    struct stat st;
+    bool rotated = stat(m_filename.c_str(), &st) != 0
+                   || (uint64_t)st.st_dev != m_dev || (uint64_t)st.st_ino != m_ino;
+    if(!rotated && (uint64_t)st.st_size >= m_maxSize){
+        if(m_maxBackups == 0){
+            unlink(m_filename.c_str());
+            unlink(LogIndex::IndexFile(m_filename).c_str());
+        }
+        // 只移动连续存在的 <filename>.1 ~ .last-1，移到 .max_backups 时覆盖最旧的
+        uint32_t last = 1;
+        while(last < m_maxBackups && access((m_filename + "." + std::to_string(last)).c_str(), F_OK) == 0){
+            ++last;
+        }
+        for(uint32_t i = m_maxBackups ? last : 0; i > 0; --i){
+            std::string from = i == 1 ? m_filename : m_filename + "." + std::to_string(i - 1);
+            std::string to = m_filename + "." + std::to_string(i);
+            rename(from.c_str(), to.c_str());
+            rename(LogIndex::IndexFile(from).c_str(), LogIndex::IndexFile(to).c_str());
+        }
+    }
+    // 改名后打开的是新文件；旧的索引块写入改名后的索引文件
+    openFile();
+    flock(lock_fd, LOCK_UN);
+    close(lock_fd);
 }
 
-void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) {
+bool FileLogAppender::writeLocked(const std::string& str, uint64_t min_time, uint64_t max_time
+                                  ,uint32_t levels, uint32_t count){
+    if(m_fd < 0 || !WriteAll(m_fd, str.c_str(), str.size())){
+        return false;
+    }
+    if(!m_index && !m_maxSize){
+        return true;
+    }
+    // O_APPEND: write 返回后文件位置就是这次写入的末尾(其他进程的写入不影响本进程的文件位置)
+    off_t end = lseek(m_fd, 0, SEEK_CUR);
+    if(m_index && end >= (off_t)str.size()){
+        m_index->add(end, str.size(), min_time, max_time, levels, count);
+    }
+    // 文件已被其他进程切分时，本进程写入的旧文件也早已超过 m_maxSize，同样进入 rotate 重新打开
+    if(m_maxSize && end >= (off_t)m_maxSize){
+        rotate();
+    }
+    return true;
+}
+
+void FileLogAppender::flushLocked(){
+    if(m_buffer.empty()){
+        return;
+    }
+    LogMetricsTimer timer;
+    bool ok = writeLocked(m_buffer, m_bufferMinTime, m_bufferMaxTime, m_bufferLevels, m_bufferCount);
+    m_metrics.add(LogMetrics::WRITE_NS, timer.lap());
+    m_metrics.add(ok ? LogMetrics::BYTES : LogMetrics::ERRORS, ok ? m_buffer.size() : 1);
+    m_buffer.clear();
+    m_bufferLevels = 0;
+    m_bufferCount = 0;
+}
+
+void FileLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) {
     if(level >= m_level){
-        m_filestream << m_formatter->format(logger,level,event);
+        EnsureLogFlusher();
+        LogMetricsTimer timer;
+        std::string str = m_formatter->format(logger, level, event);
+        m_metrics.add(LogMetrics::FORMAT_NS, timer.lap());
+        m_metrics.addEvent(level);
+        uint64_t time = event->getTime();
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        if(m_buffer.empty()){
+            m_bufferMinTime = m_bufferMaxTime = time;
+        }
+        m_buffer.append(str);
+        m_bufferMinTime = std::min(m_bufferMinTime, time);
+        m_bufferMaxTime = std::max(m_bufferMaxTime, time);
+        m_bufferLevels |= 1u << level;
+        ++m_bufferCount;
+        if(level >= LogLevel::WARN || m_buffer.size() >= m_bufferSize){
+            flushLocked();
+        }
+    }
+}
+
+// 把一批日志中满足级别的部分格式化到同一个缓冲区，并按级别计数
+static std::string FormatBatch(LogFormatter::ptr formatter, LogLevel::Level min_level
+                               ,const LogEvent::ptr* events, size_t count, LogMetrics& metrics){
+    std::stringstream ss;
+    for(size_t i = 0; i < count; ++i){
+        const LogEvent::ptr& e = events[i];
+        if(e->getLevel() >= min_level){
+            formatter->format(ss, e->getLogger(), e->getLevel(), e);
+            metrics.addEvent(e->getLevel());
+        }
+    }
+    return ss.str();
+}
+
+void FileLogAppender::logBatch(const LogEvent::ptr* events, size_t count) {
+    LogMetricsTimer timer;
+    std::string str = FormatBatch(m_formatter, m_level, events, count, m_metrics);
+    m_metrics.add(LogMetrics::FORMAT_NS, timer.lap());
+    if(str.empty()){
+        return;
+    }
+    uint64_t min_time = ~0ull, max_time = 0;
+    uint32_t levels = 0, n = 0;
+    for(size_t i = 0; i < count; ++i){
+        const LogEvent::ptr& e = events[i];
+        if(e->getLevel() >= m_level){
+            min_time = std::min(min_time, e->getTime());
+            max_time = std::max(max_time, e->getTime());
+            levels |= 1u << e->getLevel();
+            ++n;
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    if(!m_buffer.empty()){
+        // 已缓冲的日志在前，合并成一次 write
+        m_buffer.append(str);
+        m_bufferMinTime = std::min(m_bufferMinTime, min_time);
+        m_bufferMaxTime = std::max(m_bufferMaxTime, max_time);
+        m_bufferLevels |= levels;
+        m_bufferCount += n;
+        flushLocked();
+        return;
+    }
+    timer.lap();
+    bool ok = writeLocked(str, min_time, max_time, levels, n);
+    m_metrics.add(LogMetrics::WRITE_NS, timer.lap());
+    m_metrics.add(ok ? LogMetrics::BYTES : LogMetrics::ERRORS, ok ? str.size() : 1);
+}
+
+// 缓冲的控制台日志最多停留的时间
+static const uint64_t STDOUT_MAX_DELAY_NS = 100 * 1000 * 1000;
+
+struct StdoutBuffer;
+
+// 本线程已构造的控制台缓冲区(不触发 t_stdout_buffer 的构造)
+static thread_local StdoutBuffer* t_stdout_self = nullptr;
+
+// 所有线程的控制台缓冲区，进程退出时不析构，退出较晚的线程仍可使用
+static std::mutex& GetStdoutMutex(){
+    static std::mutex* s_mutex = new std::mutex;
+    return *s_mutex;
+}
+static std::vector<StdoutBuffer*>& GetStdoutBuffers(){
+    static std::vector<StdoutBuffer*>* s_buffers = new std::vector<StdoutBuffer*>;
+    return *s_buffers;
+}
+
+/**
+ * @brief 控制台输出的线程私有缓冲区
+ * @details mutex 只在其他线程调用 Flush() 时才会有竞争
+ */
+struct StdoutBuffer{
+    StdoutBuffer()
+        :os(&sbuf){
+        sbuf.setTarget(&record);
+        static bool s_atexit = (atexit(StdoutLogAppender::Flush), true);
+        (void)s_atexit;
+        InstallLogForkHandlers();
+        t_stdout_self = this;
+        std::lock_guard<std::mutex> lock(GetStdoutMutex());
+        GetStdoutBuffers().push_back(this);
+    }
+    ~StdoutBuffer(){
+        {
+            std::lock_guard<std::mutex> lock(GetStdoutMutex());
+            auto& buffers = GetStdoutBuffers();
+            buffers.erase(std::find(buffers.begin(), buffers.end(), this));
+        }
+        t_stdout_self = nullptr;
+        std::lock_guard<std::mutex> lock(mutex);
+        flush();
+    }
+    // 调用方持有 mutex，写失败返回 false
+    bool flush(){
+        bool ok = true;
+        if(!data.empty()){
+            ok = WriteAll(STDOUT_FILENO, data.c_str(), data.size());
+            data.clear();
+        }
+        LogMemoryBudget::Release(charged);
+        charged = 0;
+        return ok;
+    }
+
+    std::mutex mutex;
+    std::string data;       //待写出的完整日志
+    uint64_t first_ns = 0;  //data 中最早一条日志的时间
+    size_t charged = 0;     //data 计入 LogMemoryBudget 的字节数
+    std::string record;     //正在格式化的一条日志
+    StringAppendBuf sbuf;
+    std::ostream os;
+};
+
+static thread_local StdoutBuffer t_stdout_buffer;
+
+// fork 前持有登记表和所有缓冲区的锁并写出
+static void StdoutPrepareFork(){
+    GetStdoutMutex().lock();
+    for(auto i : GetStdoutBuffers()){
+        i->mutex.lock();
+        i->flush();
+    }
+}
+
+static void StdoutParentFork(){
+    for(auto i : GetStdoutBuffers()){
+        i->mutex.unlock();
     }
+    GetStdoutMutex().unlock();
 }
 
-void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) {
-        if(level >= m_level){
-            std::string str = m_formatter->format(logger,level,event);
-            std::cout << str;
+// 子进程只剩 fork 的线程，其他线程的缓冲区从登记表移除(它们的 thread_local 不会再析构)
+static void StdoutChildFork(){
+    auto& buffers = GetStdoutBuffers();
+    for(auto i : buffers){
+        i->data.clear();
+        i->mutex.unlock();
+    }
+    buffers.erase(std::remove_if(buffers.begin(), buffers.end(), [](StdoutBuffer* b){
+        return b != t_stdout_self;
+    }), buffers.end());
+    GetStdoutMutex().unlock();
+}
+
+// 各级别的颜色，下标为 LogLevel::Level
+static const char* s_level_colors[] = {
+    "",             //UNKNOWN
+    "\x1b[36m",     //DEBUG 青色
+    "\x1b[32m",     //INFO 绿色
+    "\x1b[33m",     //WARN 黄色
+    "\x1b[31m",     //ERROR 红色
+    "\x1b[1;31m"    //FATAL 加粗红色
+};
+static const char s_color_reset[] = "\x1b[0m";
+
+StdoutLogAppender::StdoutLogAppender(Color color){
+    m_tty = isatty(STDOUT_FILENO);
+    struct stat st;
+    m_pipe = fstat(STDOUT_FILENO, &st) == 0 && (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode));
+    m_color = color == ALWAYS || (color == AUTO && m_tty);
+    m_limit = m_tty ? 0 : (m_pipe ? PIPE_BUF : 64 * 1024);
+}
+
+StdoutLogAppender::~StdoutLogAppender(){
+    Flush();
+}
+
+void StdoutLogAppender::Flush(){
+    std::lock_guard<std::mutex> lock(GetStdoutMutex());
+    for(auto i : GetStdoutBuffers()){
+        std::lock_guard<std::mutex> buf_lock(i->mutex);
+        i->flush();
+    }
+}
+
+void StdoutLogAppender::formatRecord(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event){
+    StdoutBuffer& b = t_stdout_buffer;
+    std::string& rec = b.record;
+    rec.clear();
+    if(m_color && level > LogLevel::UNKNOWN && level <= LogLevel::FATAL){
+        rec.append(s_level_colors[level]);
+        m_formatter->format(b.os, logger, level, event);
+        // 颜色在换行之前结束，不影响下一行
+        bool newline = !rec.empty() && rec.back() == '\n';
+        if(newline){
+            rec.pop_back();
+        }
+        rec.append(s_color_reset, sizeof(s_color_reset) - 1);
+        if(newline){
+            rec.push_back('\n');
         }
+    } else {
+        m_formatter->format(b.os, logger, level, event);
     }
+}
+
+// 写出缓冲区并计入统计，调用方持有 b.mutex
+static void FlushStdoutBuffer(StdoutBuffer& b, LogMetrics& metrics){
+    size_t size = b.data.size();
+    if(size == 0){
+        return;
+    }
+    LogMetricsTimer timer;
+    bool ok = b.flush();
+    metrics.add(LogMetrics::WRITE_NS, timer.lap());
+    metrics.add(ok ? LogMetrics::BYTES : LogMetrics::ERRORS, ok ? size : 1);
+}
+
+void StdoutLogAppender::append(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event){
+    LogMetricsTimer timer;
+    formatRecord(logger, level, event);
+    m_metrics.add(LogMetrics::FORMAT_NS, timer.lap());
+    m_metrics.addEvent(level);
+    StdoutBuffer& b = t_stdout_buffer;
+    const std::string& rec = b.record;
+    std::lock_guard<std::mutex> lock(b.mutex);
+    // 放不下就先写出已有的，保证每次 write 都在日志边界上且不超过阈值
+    if(b.data.size() + rec.size() > m_limit){
+        FlushStdoutBuffer(b, m_metrics);
+    }
+    bool direct = rec.size() > m_limit;
+    size_t charged = 0;
+    if(!direct){
+        LogMemoryBudget::Result r = LogMemoryBudget::Acquire(rec.size(), level, &charged, false);
+        if(r == LogMemoryBudget::SHED){
+            m_metrics.add(LogMetrics::DROPPED);
+            return;
+        }
+        if(r == LogMemoryBudget::FULL){
+            // 内存预算用完: 不再缓冲，连同已有的一起同步写出(等待的是本线程自己的写入)
+            FlushStdoutBuffer(b, m_metrics);
+            direct = true;
+        }
+    }
+    if(direct){
+        timer.lap();
+        bool ok = WriteAll(STDOUT_FILENO, rec.c_str(), rec.size());
+        m_metrics.add(LogMetrics::WRITE_NS, timer.lap());
+        m_metrics.add(ok ? LogMetrics::BYTES : LogMetrics::ERRORS, ok ? rec.size() : 1);
+        return;
+    }
+    if(b.data.empty()){
+        b.first_ns = GetMonotonicNS();
+    }
+    b.data.append(rec);
+    b.charged += charged;
+}
+
+void StdoutLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) {
+    if(level < m_level){
+        return;
+    }
+    if(m_limit){
+        EnsureLogFlusher();
+    }
+    append(logger, level, event);
+    StdoutBuffer& b = t_stdout_buffer;
+    std::lock_guard<std::mutex> lock(b.mutex);
+    if(level >= LogLevel::WARN || GetMonotonicNS() - b.first_ns >= STDOUT_MAX_DELAY_NS){
+        FlushStdoutBuffer(b, m_metrics);
+    }
+}
+
+void StdoutLogAppender::logBatch(const LogEvent::ptr* events, size_t count) {
+    if(m_tty){
+        // 终端: 整批一次 write
+        std::string& rec = t_stdout_buffer.record;
+        std::string out;
+        LogMetricsTimer timer;
+        for(size_t i = 0; i < count; ++i){
+            const LogEvent::ptr& e = events[i];
+            if(e->getLevel() >= m_level){
+                formatRecord(e->getLogger(), e->getLevel(), e);
+                out.append(rec);
+                m_metrics.addEvent(e->getLevel());
+            }
+        }
+        m_metrics.add(LogMetrics::FORMAT_NS, timer.lap());
+        if(!out.empty()){
+            bool ok = WriteAll(STDOUT_FILENO, out.c_str(), out.size());
+            m_metrics.add(LogMetrics::WRITE_NS, timer.lap());
+            m_metrics.add(ok ? LogMetrics::BYTES : LogMetrics::ERRORS, ok ? out.size() : 1);
+        }
+        return;
+    }
+    EnsureLogFlusher();
+    bool urgent = false;
+    for(size_t i = 0; i < count; ++i){
+        const LogEvent::ptr& e = events[i];
+        if(e->getLevel() >= m_level){
+            append(e->getLogger(), e->getLevel(), e);
+            urgent = urgent || e->getLevel() >= LogLevel::WARN;
+        }
+    }
+    StdoutBuffer& b = t_stdout_buffer;
+    std::lock_guard<std::mutex> lock(b.mutex);
+    if(urgent || GetMonotonicNS() - b.first_ns >= STDOUT_MAX_DELAY_NS){
+        FlushStdoutBuffer(b, m_metrics);
+    }
+}
 
 LogFormatter::LogFormatter(const std::string& pattern)
     :m_pattern(pattern) {
         init();// 初始化解析模式字符串
 }
 
-std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event){
+std::string LogFormatter::format(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event){
     std::stringstream ss;
     for(auto& i : m_items){
         i->format(ss,logger,level,event);
@@ -324,6 +1307,13 @@ std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level
     return ss.str();
 }
 
+std::ostream& LogFormatter::format(std::ostream& ofs, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event){
+    for(auto& i : m_items){
+        i->format(ofs, logger, level, event);
+    }
+    return ofs;
+}
+
 /**
  * @brief 初始化日志格式解析器
  * 
@@ -443,6 +1433,8 @@ void LogFormatter::init(){
         XX(l, LineFormatItem),      //%l -- 行号
         XX(T, TabFormatItem),       //%T -- tab 缩进
         XX(F, FiberIdFormatItem),   //%F -- 协程id
+        XX(X, ContextFormatItem),   //%X{key} -- 上下文字段
+        XX(s, BacktraceFormatItem), //%s{LEVEL} -- 调用栈
 #undef XX
     };
 
@@ -485,12 +1477,163 @@ LoggerManager::LoggerManager() {
     m_root.reset(new Logger);
     // 默认添加一个标准输出 Appender
     m_root->addAppender(LogAppender::ptr(new StdoutLogAppender));
+
+    m_loggers[m_root->m_name] = m_root;
 }
 
 Logger::ptr LoggerManager::getLogger(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
     auto it = m_loggers.find(name);
-    // 如果找不到，返回默认的 root logger
-    return it == m_loggers.end() ? m_root : it->second;
+    if(it != m_loggers.end()) {
+        return it->second;
+    }
+    // 找不到则创建一个新的日志器，没有 Appender 时使用 root 输出
+    Logger::ptr logger(new Logger(name));
+    logger->m_root = m_root;
+    m_loggers[name] = logger;
+    return logger;
+}
+
+// Prometheus 标签值转义: \ " 换行
+static std::string EscapeLabel(const std::string& v){
+    std::string rt;
+    rt.reserve(v.size());
+    for(char c : v){
+        if(c == '\\' || c == '"'){
+            rt.push_back('\\');
+            rt.push_back(c);
+        } else if(c == '\n'){
+            rt.append("\\n");
+        } else {
+            rt.push_back(c);
+        }
+    }
+    return rt;
+}
+
+/**
+ * @brief 一个指标族: HELP/TYPE 只输出一次，后面跟所有序列
+ */
+struct MetricFamily{
+    MetricFamily(const char* n, const char* t, const char* h)
+        :name(n), type(t), help(h){
+    }
+    void add(const std::string& labels, const std::string& value){
+        if(labels.empty()){
+            lines << name << ' ' << value << '\n';
+        } else {
+            lines << name << '{' << labels << "} " << value << '\n';
+        }
+    }
+    void add(const std::string& labels, uint64_t value){
+        add(labels, std::to_string(value));
+    }
+    void addSeconds(const std::string& labels, uint64_t ns){
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.9f", ns / 1e9);
+        add(labels, buf);
+    }
+    void dump(std::ostream& os) const{
+        os << "# HELP " << name << ' ' << help << '\n'
+           << "# TYPE " << name << ' ' << type << '\n'
+           << lines.str();
+    }
+
+    const char* name;
+    const char* type;
+    const char* help;
+    std::stringstream lines;
+};
+
+std::string LoggerManager::exportMetrics(){
+    MetricFamily log_events("le0n_log_events_total", "counter", "Events accepted by the logger level filter");
+    MetricFamily events("le0n_appender_events_total", "counter", "Events written by the appender");
+    MetricFamily bytes("le0n_appender_bytes_total", "counter", "Bytes written by the appender");
+    MetricFamily dropped("le0n_appender_dropped_total", "counter", "Events dropped by the appender");
+    MetricFamily errors("le0n_appender_errors_total", "counter", "Open/write failures of the appender");
+    MetricFamily format("le0n_appender_format_seconds_total", "counter", "Time spent formatting");
+    MetricFamily write("le0n_appender_write_seconds_total", "counter", "Time spent writing");
+    MetricFamily depth("le0n_appender_queue_depth", "gauge", "Records waiting in the appender queue");
+    MetricFamily mem_limit("le0n_log_memory_budget_bytes", "gauge", "Log buffer memory budget, 0 means unlimited");
+    MetricFamily mem_used("le0n_log_memory_used_bytes", "gauge", "Log buffer memory in use");
+    MetricFamily mem_peak("le0n_log_memory_peak_bytes", "gauge", "Peak log buffer memory in use");
+    MetricFamily shed("le0n_log_memory_shed_total", "counter", "Events shed because of the memory budget");
+    MetricFamily shed_bytes("le0n_log_memory_shed_bytes_total", "counter", "Bytes shed because of the memory budget");
+    MetricFamily blocked("le0n_log_memory_blocked_total", "counter", "Times a logging thread waited for the memory budget");
+    MetricFamily blocked_time("le0n_log_memory_blocked_seconds_total", "counter", "Time spent waiting for the memory budget");
+    mem_limit.add("", LogMemoryBudget::GetLimit());
+    mem_used.add("", LogMemoryBudget::GetUsed());
+    mem_peak.add("", LogMemoryBudget::GetPeak());
+    for(int l = LogLevel::DEBUG; l <= LogLevel::INFO; ++l){
+        shed.add(std::string("level=\"") + LogLevel::ToString((LogLevel::Level)l) + "\"", LogMemoryBudget::GetShed(l));
+    }
+    shed_bytes.add("", LogMemoryBudget::GetShedBytes());
+    blocked.add("", LogMemoryBudget::GetBlocked());
+    blocked_time.addSeconds("", LogMemoryBudget::GetBlockedNS());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(auto& i : m_loggers){
+        const Logger::ptr& logger = i.second;
+        std::string logger_label = "logger=\"" + EscapeLabel(logger->getName()) + "\"";
+        LogMetricsSnapshot snap = logger->getMetrics().snapshot();
+        for(int l = LogLevel::DEBUG; l < LogMetrics::EVENTS_END; ++l){
+            log_events.add(logger_label + ",level=\"" + LogLevel::ToString((LogLevel::Level)l) + "\""
+                           ,snap.values[l]);
+        }
+        int idx = 0;
+        for(auto& a : logger->getAppenders()){
+            std::string labels = logger_label + ",appender=\"" + std::to_string(idx++)
+                                 + "\",type=\"" + a->getType() + "\"";
+            LogMetricsSnapshot as = a->getMetrics().snapshot();
+            for(int l = LogLevel::DEBUG; l < LogMetrics::EVENTS_END; ++l){
+                events.add(labels + ",level=\"" + LogLevel::ToString((LogLevel::Level)l) + "\""
+                           ,as.values[l]);
+            }
+            bytes.add(labels, as.values[LogMetrics::BYTES]);
+            dropped.add(labels, as.values[LogMetrics::DROPPED]);
+            errors.add(labels, as.values[LogMetrics::ERRORS]);
+            format.addSeconds(labels, as.values[LogMetrics::FORMAT_NS]);
+            write.addSeconds(labels, as.values[LogMetrics::WRITE_NS]);
+            int64_t d = a->getQueueDepth();
+            if(d >= 0){
+                depth.add(labels, (uint64_t)d);
+            }
+        }
+    }
+
+    std::stringstream ss;
+    log_events.dump(ss);
+    events.dump(ss);
+    bytes.dump(ss);
+    dropped.dump(ss);
+    errors.dump(ss);
+    format.dump(ss);
+    write.dump(ss);
+    depth.dump(ss);
+    mem_limit.dump(ss);
+    mem_used.dump(ss);
+    mem_peak.dump(ss);
+    shed.dump(ss);
+    shed_bytes.dump(ss);
+    blocked.dump(ss);
+    blocked_time.dump(ss);
+    return ss.str();
+}
+
+bool LoggerManager::writeMetrics(const std::string& file){
+    std::string text = exportMetrics();
+    std::string tmp = file + ".tmp." + std::to_string(getpid());
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0){
+        return false;
+    }
+    bool ok = WriteAll(fd, text.c_str(), text.size());
+    ok = close(fd) == 0 && ok;
+    if(!ok || rename(tmp.c_str(), file.c_str()) != 0){
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
 }
 
 }
@@ -3,28 +3,36 @@
 
 #include <string>
 #include <stdint.h>
+#include <string.h>
 #include <memory>
 #include <list>
 #include <sstream>
 #include <fstream>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <functional>
 #include "singleton.h"
 #include "util.h"
+#include "log_metrics.h"
+#include "log_backtrace.h"
 
 /**
  * @brief 使用流式方式将日志级别level的日志写入到logger
  * 
  * 核心逻辑：
- * 1. 检查日志级别是否允许输出。
+ * 1. 检查日志级别是否允许输出(日志器级别，或当前线程的 ScopedLogLevel 覆盖级别)。
  * 2. 创建一个 LogEvent 智能指针，封装了当前文件、行号、时间等信息。
  * 3. 使用 LogEventWrap 包装这个 Event。
- * 4. LogEventWrap::getSS() 返回一个 stringstream，用户可以使用 << 写入消息。
+ * 4. LogEventWrap::getSS() 返回一个 LogStream，用户可以使用 << 写入消息。
  * 5. 宏结束处，LogEventWrap 临时对象析构，在析构函数中调用 logger->log() 提交日志。
+ *
+ * 整个过程只使用日志器的裸指针，不复制 Logger::ptr：日志器由 LoggerManager 持有且不会删除，
+ * 多线程同时打日志时不会争抢日志器引用计数所在的缓存行。
  */
 #define LE0N_LOG_LEVEL(logger, level) \
-    if(logger->getLevel() <= level) \
-        le0n::LogEventWrap(le0n::LogEvent::ptr(new le0n::LogEvent(logger, level, \
+    if(logger->getLevel() <= level || le0n::ScopedLogLevel::Get() <= level) \
+        le0n::LogEventWrap(le0n::LogEvent::ptr(new le0n::LogEvent(logger.get(), level, \
                         __FILE__, __LINE__, 0, le0n::GetThreadId(), \
                 le0n::GetFiberId(), time(0)))).getSS()
 
@@ -41,8 +49,8 @@
  * 核心逻辑与流式类似，区别在于直接调用 format 方法进行 printf 风格的格式化。
  */
 #define LE0N_LOG_FMT_LEVEL(logger, level, fmt, ...) \
-        if(logger->getLevel() <= level) \
-            le0n::LogEventWrap(le0n::LogEvent::ptr(new le0n::LogEvent(logger, level, \
+        if(logger->getLevel() <= level || le0n::ScopedLogLevel::Get() <= level) \
+            le0n::LogEventWrap(le0n::LogEvent::ptr(new le0n::LogEvent(logger.get(), level, \
                         __FILE__, __LINE__, 0, le0n::GetThreadId(), \
                 le0n::GetFiberId(), time(0)))).getEvent()->format(fmt, __VA_ARGS__)
 
@@ -53,11 +61,31 @@
 #define LE0N_LOG_FMT_ERROR(logger, fmt, ...) LE0N_LOG_FMT_LEVEL(logger, le0n::LogLevel::ERROR, fmt, __VA_ARGS__)
 #define LE0N_LOG_FMT_FATAL(logger, fmt, ...) LE0N_LOG_FMT_LEVEL(logger, le0n::LogLevel::FATAL, fmt, __VA_ARGS__)
 
+/**
+ * @brief 当前作用域内，本线程打的日志按 level 放宽级别判断(如 LE0N_LOG_SCOPED_LEVEL(DEBUG))
+ * @details 需要按条件打开时直接使用 le0n::ScopedLogLevel
+ */
+#define LE0N_LOG_SCOPED_LEVEL(level) \
+    le0n::ScopedLogLevel LE0N_LOG_CONCAT(__le0n_scoped_level_, __LINE__)(le0n::LogLevel::level)
+
+/**
+ * @brief 当前作用域内，本线程的日志都带上 key=value 字段(格式 %X{key})
+ */
+#define LE0N_LOG_CONTEXT(key, value) \
+    le0n::LogContextGuard LE0N_LOG_CONCAT(__le0n_log_context_, __LINE__)(key, value)
+
+#define LE0N_LOG_CONCAT_IMPL(a, b) a##b
+#define LE0N_LOG_CONCAT(a, b) LE0N_LOG_CONCAT_IMPL(a, b)
+
 #define LE0N_LOG_ROOT() le0n::LoggerMgr::GetInstance()->getRoot()
 
+// 按名称获取日志器，不存在时创建（没有 Appender 的日志器会转交给 root 输出）
+#define LE0N_LOG_NAME(name) le0n::LoggerMgr::GetInstance()->getLogger(name)
+
 namespace le0n{
 
 class Logger;
+class LogIndexWriter;
 
 // 日志级别：用于区分日志的重要性，便于过滤
 // 比如：只看 ERROR 级别的日志，忽略 DEBUG
@@ -75,6 +103,10 @@ public:
      * @brief 将日志级别转换为字符串用于输出
      */
     static const char* ToString(LogLevel::Level level);
+    /**
+     * @brief 将字符串转换为日志级别(不区分大小写)，无法识别时返回 UNKNOWN
+     */
+    static LogLevel::Level FromString(const std::string& str);
     /**
     * C++ const 用法精要（极简版）
     * 🎯 核心原则：能加就加，就近原则
@@ -113,6 +145,197 @@ public:
     */
 };
 
+/**
+ * @brief 在当前线程临时放宽日志级别，用于只给单个请求打开 DEBUG
+ * @details
+ *  1. 构造时设置本线程的覆盖级别，析构时恢复之前的值，可以嵌套，最内层生效；
+ *  2. 日志级别 >= 日志器级别，或者 >= 本线程覆盖级别时输出；Appender 自己的级别仍然生效；
+ *  3. 没有覆盖时线程变量为 NONE(大于所有级别)，被日志器级别挡住的日志只多读一次线程变量；
+ *  4. 任务交给其他线程执行时用 Wrap() 包装，执行时恢复投递线程的覆盖级别。
+ *  按条件打开: ScopedLogLevel scoped(debug ? LogLevel::DEBUG : ScopedLogLevel::Get());
+ */
+class ScopedLogLevel{
+public:
+    // 没有覆盖
+    static const int NONE = 0x7fffffff;
+
+    /**
+     * @brief 构造函数
+     * @param[in] level LogLevel::Level，或 Get() 保存下来的值(包括 NONE)
+     */
+    explicit ScopedLogLevel(int level)
+        :m_prev(t_level) {
+        t_level = level;
+    }
+    ~ScopedLogLevel() { t_level = m_prev; }
+
+    ScopedLogLevel(const ScopedLogLevel&) = delete;
+    ScopedLogLevel& operator=(const ScopedLogLevel&) = delete;
+
+    // 本线程当前的覆盖级别，没有覆盖时为 NONE
+    static int Get() { return t_level; }
+
+    /**
+     * @brief 包装任务，在执行任务的线程上恢复当前线程的覆盖级别
+     * @details 当前没有覆盖时原样返回
+     */
+    static std::function<void()> Wrap(std::function<void()> cb);
+private:
+    int m_prev;
+    // 用 __thread + initial-exec: 常量初始化，没有 thread_local 的初始化检查，
+    // 在 lible0n.so 之外访问也不经过 __tls_get_addr，只是一次 %fs 相对的读取
+    static __thread int t_level __attribute__((tls_model("initial-exec")));
+};
+
+/**
+ * @brief 日志内容流：兼容 std::ostream 的 << 写法，直接追加到连续的字符串缓冲区
+ * @details
+ *  1. 整数查两位一组的数字表转换，浮点数输出能精确还原的最短形式(%.15g 不够再用 %.16g/%.17g)，
+ *     字符串直接拷贝，不经过 locale 和 streambuf 的虚函数；
+ *  2. 其他类型(自定义的 operator<<)和操纵符(std::hex、std::setw 等)交给内部的 std::ostream，
+ *     它写入同一个缓冲区，先后顺序不变；
+ *  3. 操纵符改变了格式状态后，之后的内置类型也交给 std::ostream，直到状态恢复默认，输出和 stringstream 一致。
+ *  与 stringstream 的区别: 浮点数默认输出最短还原形式，而不是 6 位有效数字。
+ */
+class LogStream{
+public:
+    struct Fallback;
+    typedef std::ostream& (*OstreamManip)(std::ostream&);
+    typedef std::ios_base& (*IosBaseManip)(std::ios_base&);
+
+    LogStream();
+    ~LogStream();
+    LogStream(const LogStream&) = delete;
+    LogStream& operator=(const LogStream&) = delete;
+
+    LogStream& operator<<(bool v) { return fast() ? appendChar(v ? '1' : '0') : slow(v); }
+    LogStream& operator<<(char v) { return fast() ? appendChar(v) : slow(v); }
+    LogStream& operator<<(signed char v) { return fast() ? appendChar(v) : slow(v); }
+    LogStream& operator<<(unsigned char v) { return fast() ? appendChar(v) : slow(v); }
+    LogStream& operator<<(short v) { return fast() ? appendInt(v) : slow(v); }
+    LogStream& operator<<(unsigned short v) { return fast() ? appendUInt(v) : slow(v); }
+    LogStream& operator<<(int v) { return fast() ? appendInt(v) : slow(v); }
+    LogStream& operator<<(unsigned int v) { return fast() ? appendUInt(v) : slow(v); }
+    LogStream& operator<<(long v) { return fast() ? appendInt(v) : slow(v); }
+    LogStream& operator<<(unsigned long v) { return fast() ? appendUInt(v) : slow(v); }
+    LogStream& operator<<(long long v) { return fast() ? appendInt(v) : slow(v); }
+    LogStream& operator<<(unsigned long long v) { return fast() ? appendUInt(v) : slow(v); }
+    LogStream& operator<<(float v) { return fast() ? appendFloat(v) : slow(v); }
+    LogStream& operator<<(double v) { return fast() ? appendDouble(v) : slow(v); }
+    LogStream& operator<<(const void* v) { return fast() ? appendPointer(v) : slow(v); }
+    LogStream& operator<<(const char* v) {
+        // 与 ostream 一致: 空指针不输出
+        if(!v) {
+            return *this;
+        }
+        return fast() ? append(v, strlen(v)) : slow(v);
+    }
+    LogStream& operator<<(char* v) { return *this << (const char*)v; }
+    LogStream& operator<<(const std::string& v) { return fast() ? append(v.c_str(), v.size()) : slow(v); }
+
+    // 操纵符(std::endl、std::hex 等)
+    LogStream& operator<<(OstreamManip manip);
+    LogStream& operator<<(IosBaseManip manip);
+
+    // 其他类型交给 std::ostream
+    template<class T>
+    LogStream& operator<<(const T& v) {
+        stream() << v;
+        updateState();
+        return *this;
+    }
+
+    LogStream& append(const char* data, size_t len) {
+        m_buf.append(data, len);
+        return *this;
+    }
+
+    const std::string& str() const { return m_buf; }
+    size_t size() const { return m_buf.size(); }
+
+    /**
+     * @brief 兼容用的 std::ostream，写入同一个缓冲区
+     */
+    std::ostream& stream();
+private:
+    bool fast() const { return !m_useStream; }
+    LogStream& appendChar(char c) {
+        m_buf.push_back(c);
+        return *this;
+    }
+    LogStream& appendInt(long long v);
+    LogStream& appendUInt(unsigned long long v);
+    LogStream& appendFloat(float v);
+    LogStream& appendDouble(double v);
+    LogStream& appendPointer(const void* v);
+    template<class T>
+    LogStream& slow(const T& v) {
+        stream() << v;
+        updateState();
+        return *this;
+    }
+    // 格式状态不是默认值时，内置类型也走 std::ostream
+    void updateState();
+private:
+    std::string m_buf;
+    Fallback* m_fallback = nullptr;
+    bool m_useStream = false;
+};
+
+/**
+ * @brief MDC(Mapped Diagnostic Context) 的一个字段
+ * @details 节点创建后不再修改，每个节点指向外层的节点，整条链就是线程某一时刻的上下文。
+ *  日志事件只保存链头的 shared_ptr 作为快照，不复制字符串；
+ *  异步输出时上下文已经变化也不影响快照。
+ */
+struct LogContextNode {
+    typedef std::shared_ptr<const LogContextNode> ptr;
+
+    LogContextNode(const std::string& k, const std::string& v, const ptr& p)
+        :key(k), value(v), parent(p) {}
+
+    std::string key;
+    std::string value;
+    ptr parent;     //外层字段
+};
+
+/**
+ * @brief 线程的日志上下文
+ */
+class LogContext{
+public:
+    // 当前线程的上下文(链头)，没有字段时为空
+    static const LogContextNode::ptr& Current();
+
+    /**
+     * @brief 在上下文中查找字段，同名时内层优先
+     * @return 找不到返回 nullptr
+     */
+    static const std::string* Find(const LogContextNode* ctx, const std::string& key);
+
+    /**
+     * @brief 包装任务，在执行任务的线程上使用当前线程的上下文
+     * @details 当前没有上下文时原样返回
+     */
+    static std::function<void()> Wrap(std::function<void()> cb);
+};
+
+/**
+ * @brief 压入一个上下文字段，析构时弹出(恢复构造前的上下文)
+ */
+class LogContextGuard{
+public:
+    LogContextGuard(const std::string& key, const std::string& value);
+    // 整体替换成另一个上下文(如其他线程的快照)
+    explicit LogContextGuard(const LogContextNode::ptr& ctx);
+    ~LogContextGuard();
+
+    LogContextGuard(const LogContextGuard&) = delete;
+    LogContextGuard& operator=(const LogContextGuard&) = delete;
+private:
+    LogContextNode::ptr m_prev;
+};
+
 // 日志事件：封装了日志发生瞬间的所有信息（时间、位置、线程、内容等）
 // 作用：数据传输对象 (DTO)。它封装了日志发生那一瞬间的所有上下文信息。将这些散落的信息打包，方便传递给 Format 和 Appender
 class LogEvent{
@@ -120,7 +343,7 @@ public:
     typedef std::shared_ptr<LogEvent> ptr;
     /**
      * @brief 构造函数
-     * @param[in] logger 日志器
+     * @param[in] logger 日志器(由调用方保证在事件处理期间有效)
      * @param[in] level 日志级别
      * @param[in] file 文件名
      * @param[in] line 文件行号
@@ -130,7 +353,7 @@ public:
      * @param[in] time 日志事件(秒)
      * @param[in] thread_name 线程名称
      */
-    LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level
+    LogEvent(Logger* logger, LogLevel::Level level
             , const char* file, int32_t m_line, uint32_t elapse
             , uint32_t thread_id, uint32_t fiber_id, uint64_t time);
     ~LogEvent();
@@ -143,12 +366,17 @@ public:
     uint64_t getTime() const {return m_time;}
     
     // 获取日志内容（用户通过 << 写入的部分）
-    std::string getContent() const {return m_ss.str();}
-    std::shared_ptr<Logger> getLogger() const {return m_logger;}
+    const std::string& getContent() const {return m_ss.str();}
+    Logger* getLogger() const {return m_logger;}
     LogLevel::Level getLevel() const {return m_level;}
+    // 创建事件时线程的上下文快照
+    const LogContextNode::ptr& getContext() const {return m_context;}
+    // 打日志时抓取的调用栈，没有抓取时为空(见 LogBacktrace)
+    const LogBacktrace::ptr& getBacktrace() const {return m_backtrace;}
+    void setBacktrace(const LogBacktrace::ptr& v) {m_backtrace = v;}
 
-    // 获取 stringstream，主要用于流式日志写入
-    std::stringstream& getSS() {return m_ss;}
+    // 获取日志内容流，主要用于流式日志写入
+    LogStream& getSS() {return m_ss;}
     /**
      * @brief 使用格式化字符串格式化日志内容
      * @param[in] fmt 格式化字符串
@@ -163,9 +391,11 @@ private:
     uint32_t m_threadId = 0;        //线程id
     uint32_t m_fiberId = 0;         //协程id
     uint64_t m_time = 0;            //时间戳
-    std::stringstream m_ss;         //日志内容（消息体）
+    LogStream m_ss;                 //日志内容（消息体）
+    LogContextNode::ptr m_context;  //上下文快照
+    LogBacktrace::ptr m_backtrace;  //调用栈
 
-    std::shared_ptr<Logger> m_logger;
+    Logger* m_logger;
     LogLevel::Level m_level;
 };
 
@@ -177,10 +407,11 @@ private:
  */
 class LogEventWrap{
 public:
+    // 日志级别不低于 LogBacktrace 抓取级别时，在这里(打日志的线程上)抓栈
     LogEventWrap(LogEvent::ptr e);
     ~LogEventWrap();    //LogEventWrap 利用析构函数触发真正写日志的操作
     LogEvent::ptr getEvent() const { return m_event;}
-    std::stringstream& getSS();
+    LogStream& getSS();
 private:
     LogEvent::ptr m_event;
 };
@@ -207,6 +438,8 @@ public:
      *  %T 制表符
      *  %F 协程id
      *  %N 线程名称
+     *  %X{key} 上下文(MDC)字段，%X 输出所有字段
+     *  %s{LEVEL} 不低于 LEVEL(默认 ERROR)的日志输出调用栈，每帧一行，如 "...%m%s%n"
      *
      *  默认格式 "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"
      */
@@ -219,7 +452,9 @@ public:
      * @param[in] level 日志级别
      * @param[in] event 日志事件
      */
-    std::string format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event);
+    std::string format(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event);
+    // 格式化追加到流，批量输出时多条日志共用一个缓冲区
+    std::ostream& format(std::ostream& ofs, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event);
 
 public:
     // 内部类：格式化子项（抽象基类）
@@ -235,7 +470,7 @@ public:
             * @param[in] level 日志等级
             * @param[in] event 日志事件
             */
-            virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) = 0;
+            virtual void format(std::ostream& os, Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) = 0;
     };
     /**
      * @brief 初始化,解析日志模板
@@ -265,26 +500,53 @@ public:
      * @param[in] logger 日志器
      * @param[in] level 日志级别
      * @param[in] event 日志事件
-     * @details 子类必须实现该方法，负责将日志事件写入到具体的输出目标（如控制台、文件等）
+     * @details 子类必须实现该方法，负责将日志事件写入到具体的输出目标（如控制台、文件等）。
+     *  logger 和 event 只在调用期间保证有效，需要异步处理的子类自己复制 event 指针
+     */
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) = 0;
+
+    /**
+     * @brief 批量写入日志
+     * @param[in] events 连续的日志事件，日志器和级别取自每个事件自身
+     * @param[in] count 事件个数
+     * @details 默认逐条调用 log()；能够合并开销(一次写文件、一次发送)的子类应当重写
      */
-    virtual void log(std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) = 0;
+    virtual void logBatch(const LogEvent::ptr* events, size_t count);
 
     void setFormatter(LogFormatter::ptr val) {m_formatter = val;}
     LogFormatter::ptr getFormatter() const { return m_formatter; }
 
     LogLevel::Level getLevel() const { return m_level; }
     void setLevel(LogLevel::Level val) { m_level = val; }
+
+    // 统计计数: 各级别条数、字节数、丢弃数、错误数、格式化/写入耗时
+    const LogMetrics& getMetrics() const { return m_metrics; }
+    // 等待输出的日志数量，没有队列的 Appender 返回 -1
+    virtual int64_t getQueueDepth() const { return -1; }
+    // 类型名，导出统计时使用
+    virtual const char* getType() const { return "LogAppender"; }
+
+    /**
+     * @brief 登记到后台写出线程，每个周期(50ms)调用一次 onFlushTimer()
+     * @details 自己缓冲日志的 Appender 在构造时登记、析构时注销，没有新日志时缓冲的日志也能按时写出
+     */
+    static void AddFlushTimer(LogAppender* appender);
+    static void DelFlushTimer(LogAppender* appender);
+    // 后台写出线程定时调用
+    virtual void onFlushTimer() {}
 protected:
-    LogLevel::Level m_level; // 每个输出地可以有自己的级别过滤
+    LogLevel::Level m_level = LogLevel::DEBUG; // 每个输出地可以有自己的级别过滤
     LogFormatter::ptr m_formatter; // 每个输出地可以有自己的格式器
+    LogMetrics m_metrics;
 };
 
 
 /**
  * @brief 日志器：核心控制类，负责收集日志并分发到各个 Appender
- * @details 继承 enable_shared_from_this 是为了在 log() 方法中安全地把 this 指针传给 Appender
+ * @details 分发时直接把 this 传给 Appender，不经过 shared_from_this()
  */
 class Logger : public std::enable_shared_from_this<Logger>{
+friend class LoggerManager;
 public:
     typedef std::shared_ptr<Logger> ptr;
     /**
@@ -299,13 +561,19 @@ public:
      * @param[in] event 日志事件
      * @details 负责将日志事件分发到所有已添加的 Appender
      */
-    void log(LogLevel::Level level,LogEvent::ptr event);
+    void log(LogLevel::Level level, const LogEvent::ptr& event);
 
-    void debug(LogEvent::ptr event);
-    void info(LogEvent::ptr event);
-    void warn(LogEvent::ptr event);
-    void error(LogEvent::ptr event);
-    void fatal(LogEvent::ptr event);
+    void debug(const LogEvent::ptr& event);
+    void info(const LogEvent::ptr& event);
+    void warn(const LogEvent::ptr& event);
+    void error(const LogEvent::ptr& event);
+    void fatal(const LogEvent::ptr& event);
+
+    /**
+     * @brief 批量分发日志，事件的日志器都应该是自己
+     * @details 先按日志器级别过滤，再对每个 Appender 调用一次 logBatch
+     */
+    void logBatch(const LogEvent::ptr* events, size_t count);
     /**
      * @brief 添加/删除 Appender
      * @param[in] appender 日志输出目标
@@ -313,25 +581,79 @@ public:
      */
     void addAppender(LogAppender::ptr appender);
     void delAppender(LogAppender::ptr appender);
+    void clearAppenders();
     LogLevel::Level getLevel() const { return m_level; }
     void setLevel(LogLevel::Level val) { m_level = val; }
     
     const std::string& getName() const { return m_name; }
+    const std::list<LogAppender::ptr>& getAppenders() const { return m_appenders; }
+    // 统计计数: 通过级别过滤的各级别日志条数
+    const LogMetrics& getMetrics() const { return m_metrics; }
 private:
     std::string m_name;                     // 日志名称
     LogLevel::Level m_level;                // 日志级别
     std::list<LogAppender::ptr> m_appenders;// Appender 列表（可以有多个输出地）
     LogFormatter::ptr m_formatter;         // 日志格式器（默认格式器，当Appender没有设置格式器时使用）
+    Logger::ptr m_root;                     // 自己没有 Appender 时转交给 root 输出
+    LogMetrics m_metrics;
 };
 
 /**
  * @brief 输出到控制台的 Appender
+ * @details 不经过 std::cout(不受 stdio 同步和 iostream 锁影响)，日志格式化到线程私有缓冲区后 write(1, ...)，
+ *  按标准输出的类型选择缓冲策略:
+ *  1. 终端: 不缓冲，每次 log() 一次 write，每次 logBatch() 整批一次 write；
+ *  2. 管道: 在线程私有缓冲区里攒到 PIPE_BUF，按日志边界写出，每次 write 都是原子的，
+ *     多个线程/进程共用一个管道时日志不会交错(单条超过 PIPE_BUF 的日志除外)；
+ *  3. 其他(文件等): 攒到 64K 写出。
+ *  缓冲时 WARN 及以上级别的日志立即写出，其余日志最多缓冲 100ms(由本线程下一条日志或后台线程每 50ms 写出，
+ *  不再打日志的空闲线程缓冲的日志也会按时输出)，
+ *  线程退出、进程正常退出、调用 flush() 时写出所有线程的缓冲区。
  */
 class StdoutLogAppender : public LogAppender{
 public:
     typedef std::shared_ptr<StdoutLogAppender> ptr;
-    virtual void log(Logger::ptr logger, LogLevel::Level level,LogEvent::ptr event) override;
 
+    /**
+     * @brief 级别颜色
+     */
+    enum Color {
+        // 标准输出是终端时使用颜色
+        AUTO = 0,
+        NEVER = 1,
+        ALWAYS = 2
+    };
+
+    /**
+     * @brief 构造函数，检测标准输出的类型
+     * @param[in] color 是否给整条日志加上级别对应的 ANSI 颜色
+     */
+    StdoutLogAppender(Color color = AUTO);
+    ~StdoutLogAppender();
+
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override;
+    virtual void logBatch(const LogEvent::ptr* events, size_t count) override;
+
+    /**
+     * @brief 写出所有线程缓冲的控制台日志
+     */
+    static void Flush();
+
+    virtual const char* getType() const override { return "StdoutLogAppender"; }
+    bool isTty() const { return m_tty; }
+    bool isPipe() const { return m_pipe; }
+    bool hasColor() const { return m_color; }
+private:
+    // 格式化一条日志(含颜色)到线程私有的临时缓冲区
+    void formatRecord(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event);
+    // 格式化一条日志放进线程私有缓冲区，必要时写出
+    void append(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event);
+private:
+    bool m_tty = false;
+    bool m_pipe = false;
+    bool m_color = false;
+    // 缓冲区写出阈值
+    size_t m_limit = 0;
 };
 
 /**
@@ -343,18 +665,85 @@ public:
     /**
      * @brief 构造函数
      * @param[in] filename 文件名
+     * @param[in] append 为 true 时保留已有内容追加写入，否则打开时清空文件
+     */
+    FileLogAppender(const std::string& filename, bool append = false);
+    ~FileLogAppender();
+    /**
+     * @brief 写入一条日志
+     * @details 先放进用户态缓冲区，攒满 setBufferSize 设置的大小、遇到 WARN 及以上级别的日志、
+     *  下一次整批写入或后台线程定时(50ms)写出时一次 write。进程崩溃时最多丢失这段时间内的 INFO/DEBUG 日志
      */
-    FileLogAppender(const std::string& filename);
-    virtual void log(Logger::ptr logger, LogLevel::Level level,LogEvent::ptr event) override;
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override;
+    // 整批格式化后连同已缓冲的日志一次 write
+    virtual void logBatch(const LogEvent::ptr* events, size_t count) override;
+
+    // 写出缓冲区中的日志
+    void flush();
+
+    /**
+     * @brief 设置用户态缓冲区大小，0 表示每条日志一次 write，不缓冲
+     */
+    void setBufferSize(size_t size);
 
      /**
      * @brief 重新打开日志文件
      * @return 成功返回true
      */
     bool reopen();
+
+    /**
+     * @brief 开启稀疏时间索引 "<filename>.idx"(见 log_index.h)，供 le0n_logslice 按时间段取日志
+     * @param[in] block_size 每写入多少字节记一条索引
+     * @details 应在开始写日志前调用。开启后每次写入在锁内 write + lseek 取得文件位置
+     */
+    void setIndex(uint64_t block_size = 64 * 1024);
+
+    /**
+     * @brief 多进程共享模式：多个进程写同一个文件，按大小切分
+     * @param[in] max_size 文件达到该大小后切分，0 表示不切分
+     * @param[in] max_backups 切分后保留 <filename>.1 ~ <filename>.N(.1 最新)，更早的删除
+     * @details 应在开始写日志前调用，构造时应传 append = true(否则构造时已经清空了文件)。
+     *  1. 之后 reopen 不再清空文件；每条日志(logBatch 为整批)一次 write，O_APPEND 下整段追加，
+     *     不会和其他进程的写入交错；
+     *  2. 某次写入后文件位置超过 max_size 的进程在 "<filename>.lock" 上加 flock 排他锁，
+     *     若文件仍是自己打开的那个就依次改名(索引文件一起改名)并打开新文件，
+     *     若已被其他进程切分过就只重新打开。还没发现切分的进程继续写入改名后的文件，不丢失；
+     *  3. 开启切分后每次写入在锁内 write + lseek 取得文件位置。
+     */
+    void setShared(uint64_t max_size = 0, uint32_t max_backups = 5);
+
+    virtual const char* getType() const override { return "FileLogAppender"; }
+private:
+    // 定时写出缓冲区；fork 时持有 m_writeMutex
+    friend struct LogFlusher;
+    // 持有 m_writeMutex 时调用
+    bool openFile();
+    // 持有 m_writeMutex 时调用，与其他进程协调后切分或重新打开
+    void rotate();
+    // 持有 m_writeMutex 时调用，写入并记录索引，超过 m_maxSize 时切分，levels 为级别位图
+    bool writeLocked(const std::string& str, uint64_t min_time, uint64_t max_time
+                     ,uint32_t levels, uint32_t count);
+    // 持有 m_writeMutex 时调用，写出 m_buffer 并计入统计
+    void flushLocked();
 private:
     std::string m_filename;
-    std::ofstream m_filestream;
+    bool m_append;
+    int m_fd = -1;
+    // 当前打开的文件，用于判断是否已被其他进程切分
+    uint64_t m_dev = 0;
+    uint64_t m_ino = 0;
+    uint64_t m_maxSize = 0;
+    uint32_t m_maxBackups = 0;
+    std::mutex m_writeMutex;
+    std::shared_ptr<LogIndexWriter> m_index;
+    // 用户态缓冲区及其中日志的时间范围、级别位图和条数(用于索引)
+    size_t m_bufferSize = 64 * 1024;
+    std::string m_buffer;
+    uint64_t m_bufferMinTime = 0;
+    uint64_t m_bufferMaxTime = 0;
+    uint32_t m_bufferLevels = 0;
+    uint32_t m_bufferCount = 0;
 };
 
 /**
@@ -375,8 +764,21 @@ public:
      * @details 解析配置文件，初始化所有日志器
      */
     void init();
-    Logger::ptr getRoot() const { return m_root; }
+    // 返回引用，LE0N_LOG_ROOT() 不产生引用计数操作
+    const Logger::ptr& getRoot() const { return m_root; }
+
+    /**
+     * @brief 导出所有日志器及其 Appender 的统计，Prometheus 文本格式
+     */
+    std::string exportMetrics();
+
+    /**
+     * @brief 把 exportMetrics() 写入文件(先写临时文件再改名，供 node_exporter textfile 采集)
+     * @return 成功返回true
+     */
+    bool writeMetrics(const std::string& file);
 private:
+    std::mutex m_mutex;
     std::map<std::string, Logger::ptr> m_loggers;
     Logger::ptr m_root;
 };
@@ -0,0 +1,332 @@
+#include "log_async.h"
+#include "log_budget.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+namespace le0n{
+
+static std::atomic<uint64_t> s_async_appender_id(0);
+
+/**
+ * @brief 线程私有: Appender id -> 本线程在该 Appender 中的队列
+ * @details 线程退出时把自己的队列都标记为 dead，合并线程取空后释放；
+ *  Appender 先析构时队列标记为 orphan，本线程下次登记新队列时顺便清理。
+ *  id 不会复用，Appender 析构后残留的条目不会被误用
+ */
+// 最近一次使用的队列，命中时不访问 t_queue_holder
+static thread_local uint64_t t_last_id = 0;
+static thread_local void* t_last_queue = nullptr;
+// t_queue_holder 已析构(线程退出过程中又打日志)，之后直接同步输出
+static thread_local bool t_queue_holder_destroyed = false;
+
+struct AsyncQueueHolder {
+    ~AsyncQueueHolder() {
+        for(auto& i : queues) {
+            i.second->dead.store(true, std::memory_order_release);
+        }
+        t_queue_holder_destroyed = true;
+        t_last_id = 0;
+    }
+
+    std::unordered_map<uint64_t, std::shared_ptr<AsyncLogAppender::Queue> > queues;
+};
+
+static thread_local AsyncQueueHolder t_queue_holder;
+
+// 每批交给目标 Appender 的最大条数
+static const size_t MAX_BATCH = 1024;
+
+AsyncLogAppender::Queue::Queue(size_t capacity)
+    :pending(IDLE)
+    ,tail(0)
+    ,head(0) {
+    size_t cap = 1;
+    while(cap < capacity) {
+        cap <<= 1;
+    }
+    slots.resize(cap);
+    mask = cap - 1;
+}
+
+bool AsyncLogAppender::Queue::push(uint64_t ts, const LogEvent::ptr& event, size_t charged) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    if(t - cached_head > mask) {
+        cached_head = head.load(std::memory_order_acquire);
+        if(t - cached_head > mask) {
+            return false;
+        }
+    }
+    Item& item = slots[t & mask];
+    item.ts = ts;
+    item.event = event;
+    item.charged = charged;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+size_t AsyncLogAppender::Queue::pop(std::deque<Item>& out) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    uint64_t t = tail.load(std::memory_order_acquire);
+    for(uint64_t i = h; i != t; ++i) {
+        Item& item = slots[i & mask];
+        out.push_back(Item{item.ts, std::move(item.event), item.charged});
+    }
+    head.store(t, std::memory_order_release);
+    return t - h;
+}
+
+AsyncLogAppender::AsyncLogAppender(LogAppender::ptr target, size_t queue_size)
+    :m_target(target)
+    ,m_queueSize(queue_size)
+    ,m_id(++s_async_appender_id)
+    ,m_emitted(0)
+    ,m_waiting(false)
+    ,m_stopping(false)
+    ,m_inflight(0) {
+    m_thread = std::thread(std::bind(&AsyncLogAppender::run, this));
+}
+
+AsyncLogAppender::~AsyncLogAppender() {
+    stop();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(auto& i : m_queues) {
+        i->orphan.store(true, std::memory_order_release);
+    }
+}
+
+AsyncLogAppender::Queue* AsyncLogAppender::getQueue() {
+    if(t_last_id == m_id) {
+        return (Queue*)t_last_queue;
+    }
+    if(t_queue_holder_destroyed) {
+        return nullptr;
+    }
+    AsyncQueueHolder& holder = t_queue_holder;
+    std::shared_ptr<Queue>& q = holder.queues[m_id];
+    if(!q) {
+        // 登记新队列时顺便清理已析构的 Appender 留下的队列(删除其他元素不影响 q 的引用)
+        for(auto it = holder.queues.begin(); it != holder.queues.end();) {
+            if(it->second && it->second->orphan.load(std::memory_order_acquire)) {
+                it = holder.queues.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        q = std::make_shared<Queue>(m_queueSize);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queues.push_back(q);
+    }
+    t_last_id = m_id;
+    t_last_queue = q.get();
+    return q.get();
+}
+
+void AsyncLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) {
+    if(level < m_level) {
+        return;
+    }
+    m_metrics.addEvent(level);
+    // 先登记在途再检查停止标志，与 stop 之后合并线程读取在途数配对:
+    // 没有看到停止标志的生产者，一定会被合并线程等到入队完成
+    m_inflight.fetch_add(1, std::memory_order_seq_cst);
+    Queue* q = nullptr;
+    if(m_stopping.load(std::memory_order_seq_cst) || !(q = getQueue())) {
+        m_inflight.fetch_sub(1, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(m_targetMutex);
+        m_target->log(logger, level, event);
+        return;
+    }
+    // 先申请内存再公布时间戳: 等待预算期间不能挡住合并线程的水位线
+    size_t charged = 0;
+    if(LogMemoryBudget::Acquire(sizeof(LogEvent) + event->getContent().size(), level, &charged)
+            == LogMemoryBudget::SHED) {
+        m_inflight.fetch_sub(1, std::memory_order_release);
+        m_metrics.add(LogMetrics::DROPPED);
+        return;
+    }
+    // 先声明"正在取时间戳"，再读时钟；合并线程据此保证不会越过这条日志
+    q->pending.store(BUSY, std::memory_order_seq_cst);
+    uint64_t ts = GetMonotonicNS();
+    q->pending.store(ts, std::memory_order_release);
+    while(!q->push(ts, event, charged)) {
+        // 队列满: 叫醒合并线程，等它腾出空间(停止期间合并线程也会一直取到在途数为 0)
+        m_cond.notify_one();
+        std::this_thread::yield();
+    }
+    q->pending.store(IDLE, std::memory_order_release);
+    m_inflight.fetch_sub(1, std::memory_order_release);
+    if(m_waiting.load(std::memory_order_relaxed)) {
+        m_cond.notify_one();
+    }
+}
+
+uint64_t AsyncLogAppender::getWatermark(const std::vector<Queue*>& queues) {
+    // 必须先读时钟再读各队列的 pending:
+    // 读到 IDLE 的生产者，之后取到的时间戳一定不小于 now
+    uint64_t watermark = GetMonotonicNS();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for(auto q : queues) {
+        uint64_t p = q->pending.load(std::memory_order_seq_cst);
+        if(p == BUSY) {
+            // 时间戳未知(可能小于 now)，这一轮不推进水位线
+            return m_lastWatermark;
+        }
+        watermark = std::min(watermark, p);
+    }
+    return std::max(watermark, m_lastWatermark);
+}
+
+size_t AsyncLogAppender::merge(uint64_t watermark) {
+    typedef std::pair<uint64_t, size_t> HeapItem;   //(时间戳, 队列下标)
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem> > heap;
+    for(size_t i = 0; i < m_local.size(); ++i) {
+        if(!m_local[i].empty() && m_local[i].front().ts <= watermark) {
+            heap.push(std::make_pair(m_local[i].front().ts, i));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_targetMutex);
+    if(!m_target->getFormatter()) {
+        m_target->setFormatter(m_formatter);
+    }
+
+    size_t total = 0;
+    size_t charged = 0;
+    std::vector<LogEvent::ptr> batch;
+    batch.reserve(std::min(MAX_BATCH, (size_t)64));
+    while(!heap.empty()) {
+        size_t idx = heap.top().second;
+        heap.pop();
+        std::deque<Item>& local = m_local[idx];
+        batch.push_back(std::move(local.front().event));
+        charged += local.front().charged;
+        local.pop_front();
+        if(!local.empty() && local.front().ts <= watermark) {
+            heap.push(std::make_pair(local.front().ts, idx));
+        }
+        if(batch.size() >= MAX_BATCH) {
+            m_target->logBatch(batch.data(), batch.size());
+            total += batch.size();
+            m_emitted.fetch_add(batch.size(), std::memory_order_release);
+            batch.clear();
+            LogMemoryBudget::Release(charged);
+            charged = 0;
+        }
+    }
+    if(!batch.empty()) {
+        m_target->logBatch(batch.data(), batch.size());
+        total += batch.size();
+        m_emitted.fetch_add(batch.size(), std::memory_order_release);
+        LogMemoryBudget::Release(charged);
+    }
+    return total;
+}
+
+void AsyncLogAppender::run() {
+    std::vector<Queue*> queues;     //与 m_queues、m_local 一一对应
+    while(true) {
+        bool stopping = m_stopping.load(std::memory_order_seq_cst);
+        // 看到停止标志后在途数为 0: 之后不会再有日志入队，这一轮取出的就是全部
+        bool drained = stopping && m_inflight.load(std::memory_order_seq_cst) == 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for(size_t i = queues.size(); i < m_queues.size(); ++i) {
+                queues.push_back(m_queues[i].get());
+            }
+        }
+        m_local.resize(queues.size());
+
+        // 先算水位线再取数据: 取到的日志要么时间戳不超过水位线，要么留到下一轮
+        uint64_t watermark = getWatermark(queues);
+        size_t popped = 0;
+        for(size_t i = 0; i < queues.size(); ++i) {
+            popped += queues[i]->pop(m_local[i]);
+        }
+        if(stopping) {
+            // 停止时不再等水位线，取到的全部输出
+            watermark = IDLE;
+        } else {
+            m_lastWatermark = watermark;
+        }
+        size_t emitted = merge(watermark);
+        if(drained) {
+            break;
+        }
+
+        // 释放生产者线程已退出且已取空的队列(先读 dead 再判断空，线程退出前的入队都已可见)
+        bool has_local = false;
+        for(size_t i = 0; i < queues.size();) {
+            if(m_local[i].empty() && queues[i]->dead.load(std::memory_order_acquire) && queues[i]->isEmpty()) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_retiredPushed += queues[i]->getPushed();
+                m_queues.erase(m_queues.begin() + i);
+                queues.erase(queues.begin() + i);
+                m_local.erase(m_local.begin() + i);
+                continue;
+            }
+            has_local = has_local || !m_local[i].empty();
+            ++i;
+        }
+        if(popped || emitted) {
+            continue;
+        }
+        if(has_local || stopping) {
+            // 等水位线越过缓存中的日志，或等在途的生产者入队
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_waitMutex);
+        m_waiting.store(true, std::memory_order_relaxed);
+        // 生产者的通知可能在设置 m_waiting 之前发出，超时保证最多延迟 10ms
+        m_cond.wait_for(lock, std::chrono::milliseconds(10));
+        m_waiting.store(false, std::memory_order_relaxed);
+    }
+}
+
+void AsyncLogAppender::flush() {
+    uint64_t pushed = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pushed = m_retiredPushed;
+        for(auto& i : m_queues) {
+            pushed += i->getPushed();
+        }
+    }
+    // 停止过程中合并线程会一直输出到全部取空，这里同样能等到
+    while(m_emitted.load(std::memory_order_acquire) < pushed) {
+        m_cond.notify_one();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+int64_t AsyncLogAppender::getQueueDepth() const {
+    uint64_t pushed = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pushed = m_retiredPushed;
+        for(auto& i : m_queues) {
+            pushed += i->getPushed();
+        }
+    }
+    uint64_t emitted = m_emitted.load(std::memory_order_acquire);
+    return pushed > emitted ? pushed - emitted : 0;
+}
+
+size_t AsyncLogAppender::getQueueCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queues.size();
+}
+
+void AsyncLogAppender::stop() {
+    if(m_stopping.exchange(true, std::memory_order_seq_cst)) {
+        return;
+    }
+    m_cond.notify_one();
+    if(m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+}
@@ -0,0 +1,132 @@
+#ifndef __LE0N_LOG_ASYNC_H__
+#define __LE0N_LOG_ASYNC_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "log.h"
+
+namespace le0n{
+
+/**
+ * @brief 异步日志 Appender：每个线程一个无锁 SPSC 队列，合并线程按时间戳归并后输出
+ * @details
+ *  1. 生产者线程只写自己的队列，线程之间不共享任何写入的缓存行；
+ *     每条日志记录入队时的单调时钟，队列满时等待合并线程腾出空间(不丢日志)。
+ *  2. 合并线程对所有队列做 k 路归并，按时间戳顺序成批交给目标 Appender 的 logBatch，
+ *     因此即使有多个生产者，输出文件里的日志仍然是全局有序的。
+ *  3. 为了不把"已经取了时间戳但还没入队"的日志排到后面，生产者入队期间会公布
+ *     自己的时间戳，合并线程只输出时间戳不超过所有在途日志的部分(水位线)。
+ *  4. 队列中的事件占用的内存从 LogMemoryBudget 申请，超过预算时按级别丢弃(计入 DROPPED)或等待。
+ *  注意: 日志事件只保存 Logger 的裸指针，日志器必须比 Appender 活得更久
+ *  (LoggerManager 创建的日志器不会删除)。
+ */
+class AsyncLogAppender : public LogAppender{
+public:
+    typedef std::shared_ptr<AsyncLogAppender> ptr;
+
+    /**
+     * @brief 构造函数，启动合并线程
+     * @param[in] target 实际输出的 Appender
+     * @param[in] queue_size 每个线程的队列容量(向上取 2 的幂)
+     */
+    AsyncLogAppender(LogAppender::ptr target, size_t queue_size = 4096);
+    ~AsyncLogAppender();
+
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override;
+
+    /**
+     * @brief 等待调用之前入队的日志全部交给目标 Appender
+     */
+    void flush();
+
+    /**
+     * @brief 输出剩余的日志并停止合并线程，之后的日志直接同步输出(加锁串行调用目标 Appender)
+     * @details 先设置停止标志，之后进入 log 的线程直接同步输出；合并线程一直输出到
+     *  在途(已通过停止检查、还没入队)的生产者为 0 且所有队列都取空后才退出，停止前进入的日志不会丢失
+     */
+    void stop();
+
+    LogAppender::ptr getTarget() const { return m_target; }
+
+    // 已入队但还没有交给目标 Appender 的条数
+    virtual int64_t getQueueDepth() const override;
+    // 当前的生产者队列数(生产者线程退出且队列取空后释放)
+    size_t getQueueCount() const;
+    virtual const char* getType() const override { return "AsyncLogAppender"; }
+private:
+    friend struct AsyncQueueHolder;
+
+    struct Item {
+        uint64_t ts;
+        LogEvent::ptr event;
+        size_t charged;     //计入 LogMemoryBudget 的字节数，输出后归还
+    };
+
+    /**
+     * @brief 单生产者单消费者环形队列
+     * @details 生产者和消费者的下标放在不同的缓存行上
+     */
+    struct Queue {
+        Queue(size_t capacity);
+
+        bool push(uint64_t ts, const LogEvent::ptr& event, size_t charged);
+        // 取出当前所有元素追加到 out，返回个数
+        size_t pop(std::deque<Item>& out);
+        uint64_t getPushed() const { return tail.load(std::memory_order_acquire); }
+        bool isEmpty() const { return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire); }
+
+        // 在途日志的时间戳: IDLE 空闲，BUSY 正在取时间戳
+        std::atomic<uint64_t> pending;
+        char pad0[64];
+        std::atomic<uint64_t> tail;     //生产者写
+        uint64_t cached_head = 0;       //生产者缓存的消费者下标
+        char pad1[64];
+        std::atomic<uint64_t> head;     //消费者写
+        char pad2[64];
+        std::vector<Item> slots;
+        uint64_t mask;
+        std::atomic<bool> dead{false};      //生产者线程已退出，取空后由合并线程释放
+        std::atomic<bool> orphan{false};    //Appender 已析构，生产者线程下次登记新队列时释放
+    };
+
+    static const uint64_t IDLE = ~0ull;
+    static const uint64_t BUSY = 0;
+
+    Queue* getQueue();
+    void run();
+    // 计算这一轮可以安全输出的时间戳上限
+    uint64_t getWatermark(const std::vector<Queue*>& queues);
+    // 把 m_local 里时间戳不超过 watermark 的日志按顺序输出，返回条数
+    size_t merge(uint64_t watermark);
+private:
+    LogAppender::ptr m_target;
+    size_t m_queueSize;
+    uint64_t m_id;                          //全局唯一，线程用它找自己的队列
+
+    mutable std::mutex m_mutex;             //保护 m_queues 和 m_retiredPushed
+    // 生产者线程也持有自己的队列，线程退出和 Appender 析构的先后不确定
+    std::vector<std::shared_ptr<Queue> > m_queues;
+    uint64_t m_retiredPushed = 0;           //已释放的队列入队过的条数
+
+    // 以下只由合并线程访问
+    std::vector<std::deque<Item> > m_local; //每个队列已取出、还没输出的日志
+    uint64_t m_lastWatermark = 0;
+
+    std::atomic<uint64_t> m_emitted;        //已输出的条数
+    std::atomic<bool> m_waiting;            //合并线程是否在等待
+    std::atomic<bool> m_stopping;
+    std::atomic<uint32_t> m_inflight;       //已通过停止检查、还没入队的生产者数
+    std::mutex m_targetMutex;               //串行化对目标 Appender 的调用(合并线程和停止后的同步输出)
+    std::mutex m_waitMutex;
+    std::condition_variable m_cond;
+    std::thread m_thread;
+};
+
+}
+
+#endif
@@ -0,0 +1,145 @@
+#include "log_backtrace.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace le0n{
+
+std::atomic<int> LogBacktrace::s_captureLevel(LogBacktrace::NONE);
+
+/**
+ * @brief 地址 -> 解析后的符号
+ * @details 只增不删，元素的地址在插入其他元素后保持不变，查到后可以在锁外使用
+ */
+struct SymbolCache {
+    std::mutex mutex;
+    std::unordered_map<uintptr_t, std::string> symbols;
+};
+
+// 进程退出时不析构，退出较晚的线程仍可使用
+static SymbolCache& GetSymbolCache() {
+    static SymbolCache* s_cache = new SymbolCache;
+    return *s_cache;
+}
+
+static std::string Resolve(void* addr) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%p ", addr);
+    std::string rt = buf;
+    // 返回地址是 call 的下一条指令，减 1 落在调用指令内(noreturn 调用位于函数末尾时不会算到下一个函数)
+    void* pc = (char*)addr - 1;
+    Dl_info info;
+    if(!dladdr(pc, &info) || !info.dli_fname) {
+        return rt + "??";
+    }
+    if(info.dli_sname) {
+        int status = -1;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        rt += status == 0 && demangled ? demangled : info.dli_sname;
+        free(demangled);
+        snprintf(buf, sizeof(buf), "+0x%lx", (unsigned long)((char*)addr - (char*)info.dli_saddr));
+    } else {
+        // 没有导出的符号(static 函数、没有 -rdynamic)只能给出模块内偏移
+        snprintf(buf, sizeof(buf), "+0x%lx", (unsigned long)((char*)addr - (char*)info.dli_fbase));
+        rt += "??";
+    }
+    rt += buf;
+    rt += " (";
+    rt += info.dli_fname;
+    rt += ")";
+    return rt;
+}
+
+__attribute__((noinline))
+LogBacktrace::ptr LogBacktrace::Capture(int skip) {
+    void* frames[MAX_FRAMES + 8];
+    skip = skip < 0 ? 1 : skip + 1;
+    int n = backtrace(frames, std::min<int>(MAX_FRAMES + skip, sizeof(frames) / sizeof(frames[0])));
+    ptr rt = std::make_shared<LogBacktrace>();
+    for(int i = skip; i < n && rt->m_size < MAX_FRAMES; ++i) {
+        rt->m_frames[rt->m_size++] = frames[i];
+    }
+    return rt;
+}
+
+// 手动指定的级别和各级别登记的格式项数
+struct CaptureRequirements {
+    std::mutex mutex;
+    int manual = LogBacktrace::NONE;
+    std::map<int, int> levels;
+};
+
+// 进程退出时不析构，静态 LogFormatter 析构时仍可注销
+static CaptureRequirements& GetCaptureRequirements() {
+    static CaptureRequirements* s_req = new CaptureRequirements;
+    return *s_req;
+}
+
+// 持有 CaptureRequirements::mutex 时调用
+static int CalcCaptureLevel(const CaptureRequirements& req) {
+    return req.levels.empty() ? req.manual : std::min(req.manual, req.levels.begin()->first);
+}
+
+void LogBacktrace::SetCaptureLevel(int level) {
+    CaptureRequirements& req = GetCaptureRequirements();
+    std::lock_guard<std::mutex> lock(req.mutex);
+    req.manual = level;
+    s_captureLevel.store(CalcCaptureLevel(req), std::memory_order_relaxed);
+}
+
+void LogBacktrace::Require(int level) {
+    CaptureRequirements& req = GetCaptureRequirements();
+    std::lock_guard<std::mutex> lock(req.mutex);
+    ++req.levels[level];
+    s_captureLevel.store(CalcCaptureLevel(req), std::memory_order_relaxed);
+}
+
+void LogBacktrace::Unrequire(int level) {
+    CaptureRequirements& req = GetCaptureRequirements();
+    std::lock_guard<std::mutex> lock(req.mutex);
+    auto it = req.levels.find(level);
+    if(it == req.levels.end()) {
+        return;
+    }
+    if(--it->second == 0) {
+        req.levels.erase(it);
+    }
+    s_captureLevel.store(CalcCaptureLevel(req), std::memory_order_relaxed);
+}
+
+size_t LogBacktrace::GetCacheSize() {
+    SymbolCache& cache = GetSymbolCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    return cache.symbols.size();
+}
+
+void LogBacktrace::format(std::ostream& os) const {
+    SymbolCache& cache = GetSymbolCache();
+    for(int i = 0; i < m_size; ++i) {
+        uintptr_t key = (uintptr_t)m_frames[i];
+        const std::string* sym = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto it = cache.symbols.find(key);
+            if(it != cache.symbols.end()) {
+                sym = &it->second;
+            }
+        }
+        if(!sym) {
+            // 解析不持锁，多个线程同时解析同一个地址时结果相同，保留先插入的
+            std::string str = Resolve(m_frames[i]);
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            sym = &cache.symbols.emplace(key, std::move(str)).first->second;
+        }
+        os << "\n\t#" << i << ' ' << *sym;
+    }
+}
+
+}
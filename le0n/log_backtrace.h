@@ -0,0 +1,61 @@
+#ifndef __LE0N_LOG_BACKTRACE_H__
+#define __LE0N_LOG_BACKTRACE_H__
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+
+namespace le0n{
+
+/**
+ * @brief 日志事件携带的调用栈(格式项 %s)
+ * @details 1. 打日志的线程只用 backtrace() 记录返回地址，不做符号解析、不分配字符串；
+ *  2. 格式化时(可能在异步输出线程)才解析符号: dladdr 取函数名和所在模块，abi::__cxa_demangle 还原 C++ 名称，
+ *     结果按地址缓存在进程级的表里，同一个调用点再次出错时只有抓栈的开销；
+ *  3. 是否抓栈由全局抓取级别决定，默认不抓；每个存活的 %s/%s{LEVEL} 格式项登记一次所需级别，
+ *     抓取级别取其中最低者，格式项随 LogFormatter 销毁(临时的格式器、重新加载配置被替换)时注销并重新计算。
+ *     可执行文件需要以 -rdynamic 链接，否则其中的函数只能显示为 模块+偏移。
+ */
+class LogBacktrace{
+public:
+    typedef std::shared_ptr<LogBacktrace> ptr;
+    // 不抓栈
+    static const int NONE = 0x7fffffff;
+    // 最多记录的栈帧数
+    static const int MAX_FRAMES = 32;
+
+    /**
+     * @brief 记录当前线程的调用栈
+     * @param[in] skip 除 Capture 自身外再跳过的栈帧数
+     */
+    static ptr Capture(int skip = 0);
+
+    // 不低于该级别(LogLevel::Level)的日志在创建时抓栈，NONE 表示不抓
+    static int GetCaptureLevel() { return s_captureLevel.load(std::memory_order_relaxed); }
+    // 手动指定的抓取级别，和格式项登记的级别取较低者；NONE 表示只由格式项决定
+    static void SetCaptureLevel(int level);
+    // 登记/注销一个需要 level 及以上调用栈的格式项，重新计算抓取级别
+    static void Require(int level);
+    static void Unrequire(int level);
+
+    // 已解析并缓存的地址数
+    static size_t GetCacheSize();
+
+    /**
+     * @brief 输出解析后的调用栈，每帧一行，行首为 "\n\t"
+     * @details 形如 "\n\t#0 0x401234 foo(int)+0x1c (/path/to/bin)"
+     */
+    void format(std::ostream& os) const;
+
+    int size() const { return m_size; }
+    void* const* frames() const { return m_frames; }
+private:
+    static std::atomic<int> s_captureLevel;
+    void* m_frames[MAX_FRAMES];
+    int m_size = 0;
+};
+
+}
+
+#endif
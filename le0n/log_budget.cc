@@ -0,0 +1,186 @@
+#include "log_budget.h"
+#include "config.h"
+#include "util.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace le0n{
+
+std::atomic<uint64_t> LogMemoryBudget::s_limit(0);
+std::atomic<uint64_t> LogMemoryBudget::s_admit(0);
+std::atomic<uint64_t> LogMemoryBudget::s_dropDebug(0);
+std::atomic<uint64_t> LogMemoryBudget::s_dropInfo(0);
+std::atomic<uint64_t> LogMemoryBudget::s_used(0);
+std::atomic<uint64_t> LogMemoryBudget::s_reserved(0);
+std::atomic<uint64_t> LogMemoryBudget::s_peak(0);
+std::atomic<uint64_t> LogMemoryBudget::s_shed[LogMemoryBudget::LEVEL_COUNT];
+std::atomic<uint64_t> LogMemoryBudget::s_shedBytes(0);
+std::atomic<uint64_t> LogMemoryBudget::s_blocked(0);
+std::atomic<uint64_t> LogMemoryBudget::s_blockedNS(0);
+std::atomic<uint32_t> LogMemoryBudget::s_waiters(0);
+
+// 和 LogLevel::Level 一致(这里不依赖 log.h)
+static const int LEVEL_DEBUG = 1;
+static const int LEVEL_INFO = 2;
+
+// 等待预算的线程在这里等待归还，进程退出时不析构
+static std::mutex& GetWaitMutex() {
+    static std::mutex* s_mutex = new std::mutex;
+    return *s_mutex;
+}
+static std::condition_variable& GetWaitCond() {
+    static std::condition_variable* s_cond = new std::condition_variable;
+    return *s_cond;
+}
+
+// 比例只在设置时使用，由 GetWaitMutex 保护
+static double s_drop_debug_ratio = 0.5;
+static double s_drop_info_ratio = 0.75;
+
+static ConfigVar<uint64_t>::ptr g_log_memory_budget =
+    Config::Lookup("log.memory.budget", (uint64_t)0, "log buffer memory budget(bytes), 0 means unlimited");
+static ConfigVar<double>::ptr g_log_memory_drop_debug =
+    Config::Lookup("log.memory.drop_debug", 0.5, "drop DEBUG logs above this fraction of the budget");
+static ConfigVar<double>::ptr g_log_memory_drop_info =
+    Config::Lookup("log.memory.drop_info", 0.75, "drop INFO logs above this fraction of the budget");
+
+struct LogMemoryBudgetIniter {
+    LogMemoryBudgetIniter() {
+        g_log_memory_budget->addListener([](const uint64_t& old_value, const uint64_t& new_value){
+            LogMemoryBudget::SetLimit(new_value);
+        });
+        auto on_ratio = [](const double& old_value, const double& new_value){
+            LogMemoryBudget::SetRatios(g_log_memory_drop_debug->getValue(), g_log_memory_drop_info->getValue());
+        };
+        g_log_memory_drop_debug->addListener(on_ratio);
+        g_log_memory_drop_info->addListener(on_ratio);
+        LogMemoryBudget::SetRatios(g_log_memory_drop_debug->getValue(), g_log_memory_drop_info->getValue());
+        LogMemoryBudget::SetLimit(g_log_memory_budget->getValue());
+    }
+};
+
+static LogMemoryBudgetIniter s_log_memory_budget_initer;
+
+// 持有 GetWaitMutex 时调用；固定缓冲区占满预算时额度为 0，只剩"占用为 0 时放行"
+static void UpdateThresholds(uint64_t limit, uint64_t reserved, std::atomic<uint64_t>& admit
+                             ,std::atomic<uint64_t>& drop_debug, std::atomic<uint64_t>& drop_info) {
+    uint64_t avail = limit > reserved ? limit - reserved : 0;
+    admit.store(avail, std::memory_order_relaxed);
+    drop_debug.store((uint64_t)(avail * s_drop_debug_ratio), std::memory_order_relaxed);
+    drop_info.store((uint64_t)(avail * s_drop_info_ratio), std::memory_order_relaxed);
+}
+
+void LogMemoryBudget::SetLimit(uint64_t limit) {
+    std::lock_guard<std::mutex> lock(GetWaitMutex());
+    UpdateThresholds(limit, s_reserved.load(std::memory_order_relaxed), s_admit, s_dropDebug, s_dropInfo);
+    s_limit.store(limit, std::memory_order_relaxed);
+    // 预算调大或关闭，等待的线程重新判断
+    GetWaitCond().notify_all();
+}
+
+void LogMemoryBudget::SetRatios(double drop_debug, double drop_info) {
+    std::lock_guard<std::mutex> lock(GetWaitMutex());
+    s_drop_debug_ratio = drop_debug;
+    s_drop_info_ratio = drop_info;
+    UpdateThresholds(s_limit.load(std::memory_order_relaxed), s_reserved.load(std::memory_order_relaxed)
+                     ,s_admit, s_dropDebug, s_dropInfo);
+}
+
+uint64_t LogMemoryBudget::GetShed(int level) {
+    return level >= 0 && level < LEVEL_COUNT ? s_shed[level].load(std::memory_order_relaxed) : 0;
+}
+
+static void UpdatePeak(std::atomic<uint64_t>& peak, uint64_t used) {
+    uint64_t cur = peak.load(std::memory_order_relaxed);
+    while(used > cur && !peak.compare_exchange_weak(cur, used, std::memory_order_relaxed));
+}
+
+LogMemoryBudget::Result LogMemoryBudget::Acquire(size_t bytes, int level, size_t* charged, bool wait) {
+    *charged = 0;
+    uint64_t limit = s_limit.load(std::memory_order_relaxed);
+    if(!limit) {
+        return GRANTED;
+    }
+    uint64_t start = 0;
+    uint64_t used = s_used.load(std::memory_order_seq_cst);
+    while(true) {
+        uint64_t threshold = level <= LEVEL_DEBUG ? s_dropDebug.load(std::memory_order_relaxed)
+                             : level <= LEVEL_INFO ? s_dropInfo.load(std::memory_order_relaxed)
+                             : s_admit.load(std::memory_order_relaxed);
+        // 没有排队的日志时总是放行，单条超过阈值的日志也能输出(固定缓冲区不算在内)
+        if(used == 0 || used + bytes <= threshold) {
+            if(s_used.compare_exchange_weak(used, used + bytes, std::memory_order_seq_cst)) {
+                break;
+            }
+            continue;
+        }
+        if(level <= LEVEL_INFO) {
+            s_shed[level < 0 ? 0 : level].fetch_add(1, std::memory_order_relaxed);
+            s_shedBytes.fetch_add(bytes, std::memory_order_relaxed);
+            return SHED;
+        }
+        if(!wait) {
+            return FULL;
+        }
+        if(!start) {
+            start = GetMonotonicNS();
+            s_blocked.fetch_add(1, std::memory_order_relaxed);
+        }
+        {
+            std::unique_lock<std::mutex> lock(GetWaitMutex());
+            // 先登记再检查占用，Release 先减占用再看登记，两者不会错过
+            s_waiters.fetch_add(1, std::memory_order_seq_cst);
+            used = s_used.load(std::memory_order_seq_cst);
+            if(used != 0 && used + bytes > s_admit.load(std::memory_order_relaxed)) {
+                GetWaitCond().wait_for(lock, std::chrono::milliseconds(10));
+            }
+            s_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+        limit = s_limit.load(std::memory_order_relaxed);
+        if(!limit) {
+            s_blockedNS.fetch_add(GetMonotonicNS() - start, std::memory_order_relaxed);
+            return GRANTED;
+        }
+        used = s_used.load(std::memory_order_seq_cst);
+    }
+    if(start) {
+        s_blockedNS.fetch_add(GetMonotonicNS() - start, std::memory_order_relaxed);
+    }
+    UpdatePeak(s_peak, used + bytes + s_reserved.load(std::memory_order_relaxed));
+    *charged = bytes;
+    return GRANTED;
+}
+
+size_t LogMemoryBudget::Reserve(size_t bytes) {
+    // 不管是否开启预算都计入，之后再设置预算(如加载配置)时也能扣掉
+    std::lock_guard<std::mutex> lock(GetWaitMutex());
+    uint64_t reserved = s_reserved.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    UpdateThresholds(s_limit.load(std::memory_order_relaxed), reserved, s_admit, s_dropDebug, s_dropInfo);
+    UpdatePeak(s_peak, s_used.load(std::memory_order_relaxed) + reserved);
+    return bytes;
+}
+
+void LogMemoryBudget::Unreserve(size_t charged) {
+    if(!charged) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(GetWaitMutex());
+    uint64_t reserved = s_reserved.fetch_sub(charged, std::memory_order_relaxed) - charged;
+    UpdateThresholds(s_limit.load(std::memory_order_relaxed), reserved, s_admit, s_dropDebug, s_dropInfo);
+    // 额度变大，等待的线程重新判断
+    GetWaitCond().notify_all();
+}
+
+void LogMemoryBudget::Release(size_t charged) {
+    if(!charged) {
+        return;
+    }
+    s_used.fetch_sub(charged, std::memory_order_seq_cst);
+    if(s_waiters.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(GetWaitMutex());
+        GetWaitCond().notify_all();
+    }
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef __LE0N_LOG_BUDGET_H__
+#define __LE0N_LOG_BUDGET_H__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace le0n{
+
+/**
+ * @brief 进程级的日志缓冲内存预算
+ * @details 所有在内存中攒着等待输出的日志(AsyncLogAppender 队列里的事件、控制台的线程缓冲区、
+ *  UringFileLogAppender 的预分配缓冲区)都从这里申请、写出后归还。磁盘变慢时按级别逐级降级:
+ *  1. 占用超过 预算 * log.memory.drop_debug 后，DEBUG 日志不再进入缓冲，直接丢弃；
+ *  2. 占用超过 预算 * log.memory.drop_info 后，INFO 也丢弃；
+ *  3. WARN 及以上不丢弃，占用超过预算时等待其他日志写出、归还内存后再继续(阻塞打日志的线程)。
+ *  预分配的固定缓冲区(Reserve)单独计数，只从预算中扣掉可用于排队的部分，不参与"占用为 0 时放行"的判断:
+ *  固定缓冲区占满甚至超过预算时，排队的日志仍能逐条放行，不会一直等待。
+ *  预算由配置项 log.memory.budget(字节)设置，0 表示不限制，此时 Acquire/Release 不做任何原子操作。
+ *  丢弃的条数、字节数和等待的次数、时长都会计数，并由 LoggerManager::exportMetrics 导出。
+ */
+class LogMemoryBudget{
+public:
+    enum Result {
+        GRANTED = 0,    //申请成功(或未开启预算)
+        SHED = 1,       //按降级规则丢弃
+        FULL = 2        //wait 为 false 且需要等待
+    };
+
+    /**
+     * @brief 申请 bytes 字节的日志缓冲
+     * @param[in] level 日志级别(LogLevel::Level)，决定紧张时丢弃还是等待
+     * @param[out] charged 实际计入预算的字节数，归还时原样传给 Release(未开启预算时为 0)
+     * @param[in] wait 超过预算时是否等待；为 false 时返回 FULL，由调用方自行处理(如直接同步写出)
+     */
+    static Result Acquire(size_t bytes, int level, size_t* charged, bool wait = true);
+
+    /**
+     * @brief 计入预分配的固定缓冲区，不丢弃也不等待
+     * @details 预算中扣掉这部分后才是排队日志可用的额度；未开启预算时也计入，之后开启时生效
+     * @return 计入的字节数，归还时传给 Unreserve
+     */
+    static size_t Reserve(size_t bytes);
+    // 归还 Reserve 计入的字节
+    static void Unreserve(size_t charged);
+
+    // 归还 Acquire 计入的字节
+    static void Release(size_t charged);
+
+    // 预算(字节)，0 表示不限制；通常由配置项 log.memory.budget 设置
+    static void SetLimit(uint64_t limit);
+    static uint64_t GetLimit() { return s_limit.load(std::memory_order_relaxed); }
+    // 降级阈值，占预算的比例
+    static void SetRatios(double drop_debug, double drop_info);
+
+    // 当前占用(含固定缓冲区)和峰值
+    static uint64_t GetUsed() { return s_used.load(std::memory_order_relaxed) + s_reserved.load(std::memory_order_relaxed); }
+    // 固定缓冲区的占用
+    static uint64_t GetReserved() { return s_reserved.load(std::memory_order_relaxed); }
+    static uint64_t GetPeak() { return s_peak.load(std::memory_order_relaxed); }
+    // 各级别丢弃的条数，level 为 LogLevel::Level
+    static uint64_t GetShed(int level);
+    static uint64_t GetShedBytes() { return s_shedBytes.load(std::memory_order_relaxed); }
+    // 等待的次数和累计时长
+    static uint64_t GetBlocked() { return s_blocked.load(std::memory_order_relaxed); }
+    static uint64_t GetBlockedNS() { return s_blockedNS.load(std::memory_order_relaxed); }
+private:
+    static const int LEVEL_COUNT = 6;
+    static std::atomic<uint64_t> s_limit;
+    static std::atomic<uint64_t> s_admit;       //排队日志可用的额度: 预算减去固定缓冲区
+    static std::atomic<uint64_t> s_dropDebug;   //DEBUG 开始丢弃的占用(字节)
+    static std::atomic<uint64_t> s_dropInfo;    //INFO 开始丢弃的占用(字节)
+    static std::atomic<uint64_t> s_used;        //排队日志的占用
+    static std::atomic<uint64_t> s_reserved;    //固定缓冲区的占用
+    static std::atomic<uint64_t> s_peak;
+    static std::atomic<uint64_t> s_shed[LEVEL_COUNT];
+    static std::atomic<uint64_t> s_shedBytes;
+    static std::atomic<uint64_t> s_blocked;
+    static std::atomic<uint64_t> s_blockedNS;
+    static std::atomic<uint32_t> s_waiters;
+};
+
+}
+
+#endif
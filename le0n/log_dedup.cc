@@ -0,0 +1,173 @@
+#include "log_dedup.h"
+#include <string.h>
+#include <time.h>
+
+namespace le0n{
+
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t Rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t Read64(const char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t Read32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = Rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+static inline uint64_t MergeRound(uint64_t acc, uint64_t val) {
+    acc ^= Round(0, val);
+    return acc * PRIME1 + PRIME4;
+}
+
+/**
+ * @brief XXH64: 每次处理 32 字节，4 路累加互不依赖，编译器可以并行执行(或向量化)
+ */
+static uint64_t HashBytes(const char* p, size_t len, uint64_t seed) {
+    const char* end = p + len;
+    uint64_t h;
+    if(len >= 32) {
+        const char* limit = end - 32;
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        do {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        } while(p <= limit);
+        h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        h = MergeRound(h, v1);
+        h = MergeRound(h, v2);
+        h = MergeRound(h, v3);
+        h = MergeRound(h, v4);
+    } else {
+        h = seed + PRIME5;
+    }
+    h += len;
+    for(; p + 8 <= end; p += 8) {
+        h ^= Round(0, Read64(p));
+        h = Rotl(h, 27) * PRIME1 + PRIME4;
+    }
+    if(p + 4 <= end) {
+        h ^= (uint64_t)Read32(p) * PRIME1;
+        h = Rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for(; p < end; ++p) {
+        h ^= (uint8_t)*p * PRIME5;
+        h = Rotl(h, 11) * PRIME1;
+    }
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t DedupLogAppender::Hash(const LogEvent::ptr& event) {
+    // 文件名是 __FILE__ 字符串常量，同一调用位置指针相同
+    uint64_t seed = (uint64_t)(uintptr_t)event->getLogger() * PRIME1
+                    ^ (uint64_t)(uintptr_t)event->getFile() * PRIME2
+                    ^ ((uint64_t)event->getLine() << 8 | event->getLevel()) * PRIME3;
+    const std::string& content = event->getContent();
+    return HashBytes(content.c_str(), content.size(), seed);
+}
+
+DedupLogAppender::DedupLogAppender(LogAppender::ptr target, uint64_t window)
+    :m_target(target)
+    ,m_windowNS(window * 1000000ull) {
+}
+
+DedupLogAppender::~DedupLogAppender() {
+    flush();
+}
+
+LogEvent::ptr DedupLogAppender::summary() {
+    LogEvent::ptr& last = m_lastEvent;
+    LogEvent::ptr e(new LogEvent(last->getLogger(), last->getLevel(), last->getFile(), last->getLine()
+                    ,last->getElapse(), last->getThreadId(), last->getFiberId(), time(0)));
+    e->getSS() << "last message repeated " << m_repeated << " times";
+    m_repeated = 0;
+    m_lastEvent.reset();
+    return e;
+}
+
+void DedupLogAppender::filter(const LogEvent::ptr& event, uint64_t now, std::vector<LogEvent::ptr>& out) {
+    LogMetricsTimer timer;
+    uint64_t hash = Hash(event);
+    m_metrics.add(LogMetrics::FORMAT_NS, timer.lap());
+    m_metrics.addEvent(event->getLevel());
+    if(m_hasLast && hash == m_lastHash && (!m_windowNS || now - m_lastNS < m_windowNS)) {
+        ++m_repeated;
+        m_lastEvent = event;
+        m_metrics.add(LogMetrics::DROPPED);
+        return;
+    }
+    if(m_repeated) {
+        out.push_back(summary());
+    }
+    m_hasLast = true;
+    m_lastHash = hash;
+    m_lastNS = now;
+    out.push_back(event);
+}
+
+void DedupLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) {
+    if(level < m_level) {
+        return;
+    }
+    std::vector<LogEvent::ptr> out;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    filter(event, GetMonotonicNS(), out);
+    // 持锁输出，汇总和后面的日志不会被其他线程插队
+    for(auto& i : out) {
+        m_target->log(i->getLogger(), i->getLevel(), i);
+    }
+}
+
+void DedupLogAppender::logBatch(const LogEvent::ptr* events, size_t count) {
+    std::vector<LogEvent::ptr> out;
+    out.reserve(count);
+    uint64_t now = GetMonotonicNS();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(size_t i = 0; i < count; ++i) {
+        if(events[i]->getLevel() >= m_level) {
+            filter(events[i], now, out);
+        }
+    }
+    if(!out.empty()) {
+        m_target->logBatch(out.data(), out.size());
+    }
+}
+
+void DedupLogAppender::flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_repeated) {
+        LogEvent::ptr e = summary();
+        m_target->log(e->getLogger(), e->getLevel(), e);
+    }
+}
+
+}
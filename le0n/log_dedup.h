@@ -0,0 +1,69 @@
+#ifndef __LE0N_LOG_DEDUP_H__
+#define __LE0N_LOG_DEDUP_H__
+
+#include <mutex>
+#include <vector>
+#include "log.h"
+
+namespace le0n{
+
+/**
+ * @brief 合并连续重复日志的 Appender("last message repeated N times")
+ * @details
+ *  1. 同一日志器、同一级别、同一调用位置(文件名 + 行号)、内容相同的日志算重复，
+ *     比较的是 64 位哈希值，不保存也不比较日志内容；时间、线程等字段不参与比较；
+ *  2. 重复的日志不交给目标 Appender，只计数；遇到不同的日志、超过窗口时间、调用 flush() 或析构时，
+ *     先输出一条 "last message repeated N times"(级别和位置与被合并的日志相同)；
+ *  3. window 不为 0 时，同一条日志最多合并 window 毫秒，之后的重复日志正常输出一次并重新开始计数，
+ *     持续刷屏时每个窗口仍能看到一条原文和一条汇总；
+ *  4. 汇总要等下一条日志(或 flush)才输出，重复结束后长时间没有新日志时汇总会延后。
+ *  被合并的条数计入 getMetrics() 的 DROPPED。
+ */
+class DedupLogAppender : public LogAppender{
+public:
+    typedef std::shared_ptr<DedupLogAppender> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] target 实际输出的 Appender
+     * @param[in] window 同一条日志最多合并多久(毫秒)，0 表示不限
+     */
+    DedupLogAppender(LogAppender::ptr target, uint64_t window = 0);
+    ~DedupLogAppender();
+
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override;
+    virtual void logBatch(const LogEvent::ptr* events, size_t count) override;
+
+    /**
+     * @brief 输出尚未输出的重复次数汇总
+     */
+    void flush();
+
+    LogAppender::ptr getTarget() const { return m_target; }
+    virtual const char* getType() const override { return "DedupLogAppender"; }
+
+    /**
+     * @brief 计算日志的去重哈希(日志器、级别、调用位置、内容)
+     */
+    static uint64_t Hash(const LogEvent::ptr& event);
+private:
+    // 判断一条日志是否输出，需要输出的(包括汇总)追加到 out，调用方持有 m_mutex
+    void filter(const LogEvent::ptr& event, uint64_t now, std::vector<LogEvent::ptr>& out);
+    // 生成上一条日志的重复次数汇总，调用方持有 m_mutex
+    LogEvent::ptr summary();
+private:
+    std::mutex m_mutex;
+    LogAppender::ptr m_target;
+    uint64_t m_windowNS;
+    bool m_hasLast = false;
+    uint64_t m_lastHash = 0;
+    // 上一条日志第一次输出的时间
+    uint64_t m_lastNS = 0;
+    // 最近一条被合并的日志，汇总使用它的级别、位置、线程
+    LogEvent::ptr m_lastEvent;
+    uint64_t m_repeated = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include "log_index.h"
+#include <algorithm>
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace le0n{
+
+static const char s_magic[8] = {'L', 'E', '0', 'N', 'I', 'D', 'X', 0};
+static const uint32_t INDEX_VERSION = 1;
+
+LogIndexWriter::LogIndexWriter(const std::string& log_file, uint64_t block_size)
+    :m_filename(LogIndex::IndexFile(log_file))
+    ,m_blockSize(block_size ? block_size : 1) {
+    memset(&m_cur, 0, sizeof(m_cur));
+}
+
+LogIndexWriter::~LogIndexWriter() {
+    close();
+}
+
+void LogIndexWriter::close() {
+    if(m_fd >= 0) {
+        flush();
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool LogIndexWriter::open(bool truncate) {
+    close();
+    memset(&m_cur, 0, sizeof(m_cur));
+    m_fd = ::open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC
+                  | (truncate ? O_TRUNC : 0), 0644);
+    if(m_fd < 0) {
+        ++m_errors;
+        std::cerr << "LogIndexWriter open " << m_filename << " failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if(fstat(m_fd, &st) == 0 && st.st_size == 0) {
+        LogIndexHeader header;
+        memcpy(header.magic, s_magic, sizeof(s_magic));
+        header.version = INDEX_VERSION;
+        header.entry_size = sizeof(LogIndexEntry);
+        header.block_size = m_blockSize;
+        if(write(m_fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+            ++m_errors;
+        }
+    }
+    return true;
+}
+
+void LogIndexWriter::add(uint64_t end, uint64_t len, uint64_t min_time, uint64_t max_time
+                         ,uint32_t levels, uint32_t count) {
+    uint64_t begin = end - len;
+    // 文件被外部截断过，当前块作废
+    if(m_cur.count && begin < m_cur.offset) {
+        memset(&m_cur, 0, sizeof(m_cur));
+    }
+    if(!m_cur.count) {
+        m_cur.offset = begin;
+        m_cur.min_time = min_time;
+        m_cur.max_time = max_time;
+    } else {
+        // 中间可能夹着其他进程写入的内容，它们由各自的索引描述
+        m_cur.min_time = std::min(m_cur.min_time, min_time);
+        m_cur.max_time = std::max(m_cur.max_time, max_time);
+    }
+    m_cur.length = end - m_cur.offset;
+    m_cur.levels |= levels;
+    m_cur.count += count;
+    if(m_cur.length >= m_blockSize) {
+        flush();
+    }
+}
+
+void LogIndexWriter::flush() {
+    if(!m_cur.count || m_fd < 0) {
+        return;
+    }
+    // 一条索引一次 write，多个进程同时追加也不会交错
+    if(write(m_fd, &m_cur, sizeof(m_cur)) != (ssize_t)sizeof(m_cur)) {
+        ++m_errors;
+    }
+    memset(&m_cur, 0, sizeof(m_cur));
+}
+
+bool LogIndex::Load(const std::string& index_file, std::vector<LogIndexEntry>& entries
+                    ,uint64_t* block_size) {
+    int fd = ::open(index_file.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return false;
+    }
+    std::string data;
+    char buf[64 * 1024];
+    ssize_t n;
+    while((n = read(fd, buf, sizeof(buf))) > 0) {
+        data.append(buf, n);
+    }
+    ::close(fd);
+    if(n < 0 || data.size() < sizeof(LogIndexHeader)) {
+        return false;
+    }
+    LogIndexHeader header;
+    memcpy(&header, data.c_str(), sizeof(header));
+    if(memcmp(header.magic, s_magic, sizeof(s_magic)) != 0
+            || header.version != INDEX_VERSION
+            || header.entry_size != sizeof(LogIndexEntry)) {
+        return false;
+    }
+    if(block_size) {
+        *block_size = header.block_size;
+    }
+    // 末尾不完整的一条(写到一半)忽略
+    size_t count = (data.size() - sizeof(header)) / sizeof(LogIndexEntry);
+    entries.resize(count);
+    if(count) {
+        memcpy(&entries[0], data.c_str() + sizeof(header), count * sizeof(LogIndexEntry));
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+        [](const LogIndexEntry& a, const LogIndexEntry& b){
+            return a.offset < b.offset;
+        });
+    return true;
+}
+
+uint64_t LogIndex::Select(const std::vector<LogIndexEntry>& entries, uint64_t start, uint64_t end
+                          ,uint32_t level_mask, std::vector<std::pair<uint64_t, uint64_t> >& ranges) {
+    uint64_t covered = 0;
+    auto add = [&ranges](uint64_t b, uint64_t e){
+        if(!ranges.empty() && b <= ranges.back().second) {
+            ranges.back().second = std::max(ranges.back().second, e);
+        } else {
+            ranges.push_back(std::make_pair(b, e));
+        }
+    };
+    for(auto& i : entries) {
+        // 没有任何索引覆盖的空洞(写入方崩溃丢失的块)只能整段扫描
+        if(i.offset > covered) {
+            add(covered, i.offset);
+        }
+        if(i.max_time >= start && i.min_time <= end && (i.levels & level_mask)) {
+            add(i.offset, i.offset + i.length);
+        }
+        covered = std::max(covered, i.offset + i.length);
+    }
+    return covered;
+}
+
+}
@@ -0,0 +1,126 @@
+#ifndef __LE0N_LOG_INDEX_H__
+#define __LE0N_LOG_INDEX_H__
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief 日志文件的稀疏时间索引("<日志文件>.idx")
+ * @details FileLogAppender 每写满一个块(默认 64KB)追加一条索引: 块在日志文件里的字节范围、
+ *  块内日志的最早/最晚时间(秒)、出现过的级别位图。按时间段、级别取日志时只读可能匹配的块。
+ *  1. 索引文件和日志文件一样用 O_APPEND 追加，多个进程写同一个日志文件时各自记录自己写入的块，
+ *     块可以相互重叠，读取时按偏移排序合并；
+ *  2. 最后一个没写满的块在 Appender 关闭(析构/reopen)时写入，进程崩溃时丢失，
+ *     读取方把没有任何索引覆盖的部分(包括最后一个块之后)整段扫描；
+ *  3. 切分日志时，日志文件和索引文件要一起改名。
+ */
+namespace le0n{
+
+/**
+ * @brief 索引文件头
+ */
+struct LogIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t block_size;
+};
+
+/**
+ * @brief 一个块的索引
+ */
+struct LogIndexEntry {
+    uint64_t offset;        //块在日志文件中的起始位置
+    uint64_t length;        //块的字节数
+    uint64_t min_time;      //块内最早的日志时间(秒)
+    uint64_t max_time;      //块内最晚的日志时间(秒)
+    uint32_t levels;        //块内出现过的级别，第 LogLevel::Level 位
+    uint32_t count;         //块内的日志条数
+};
+
+/**
+ * @brief 索引写入方(FileLogAppender 使用，调用方负责加锁)
+ */
+class LogIndexWriter{
+public:
+    typedef std::shared_ptr<LogIndexWriter> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] log_file 日志文件名，索引文件为 log_file + ".idx"
+     * @param[in] block_size 块大小(字节)
+     */
+    LogIndexWriter(const std::string& log_file, uint64_t block_size);
+    // 写入未满的块
+    ~LogIndexWriter();
+
+    /**
+     * @brief 打开(或重新打开)索引文件
+     * @param[in] truncate 日志文件被清空时为 true，同时清空索引
+     * @return 成功返回true
+     */
+    bool open(bool truncate);
+
+    /**
+     * @brief 记录一次写入
+     * @param[in] end 写入后日志文件的位置(写入的范围是 [end - len, end))
+     * @param[in] len 写入的字节数
+     * @param[in] min_time 这次写入的日志里最早的时间
+     * @param[in] max_time 这次写入的日志里最晚的时间
+     * @param[in] levels 这次写入的日志的级别位图
+     * @param[in] count 这次写入的日志条数
+     */
+    void add(uint64_t end, uint64_t len, uint64_t min_time, uint64_t max_time
+             ,uint32_t levels, uint32_t count);
+
+    // 写入未满的块
+    void flush();
+
+    const std::string& getFilename() const { return m_filename; }
+    // 写索引失败的次数
+    uint64_t getErrors() const { return m_errors; }
+private:
+    void close();
+private:
+    std::string m_filename;
+    uint64_t m_blockSize;
+    int m_fd = -1;
+    // 当前块，count 为 0 表示没有
+    LogIndexEntry m_cur;
+    uint64_t m_errors = 0;
+};
+
+/**
+ * @brief 索引读取
+ */
+class LogIndex{
+public:
+    static std::string IndexFile(const std::string& log_file) { return log_file + ".idx"; }
+
+    /**
+     * @brief 读取索引文件
+     * @param[out] entries 所有块(按偏移排序)
+     * @param[out] block_size 块大小
+     * @return 文件不存在或格式不对返回 false
+     */
+    static bool Load(const std::string& index_file, std::vector<LogIndexEntry>& entries
+                     ,uint64_t* block_size = nullptr);
+
+    /**
+     * @brief 选出时间和级别可能匹配的块
+     * @param[in] start 开始时间(秒，含)
+     * @param[in] end 结束时间(秒，含)
+     * @param[in] level_mask 关心的级别位图
+     * @param[out] ranges 需要读取的 [起始, 结束) 范围，相邻或重叠的已合并
+     * @return 索引覆盖到的位置，之后的内容没有索引
+     */
+    static uint64_t Select(const std::vector<LogIndexEntry>& entries, uint64_t start, uint64_t end
+                           ,uint32_t level_mask, std::vector<std::pair<uint64_t, uint64_t> >& ranges);
+};
+
+}
+
+#endif
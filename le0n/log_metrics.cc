@@ -0,0 +1,73 @@
+#include "log_metrics.h"
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+namespace le0n{
+
+static const size_t CACHE_LINE = 64;
+// 分片数(2 的幂)
+static const size_t STRIPES = 16;
+
+struct LogMetricsStripe {
+    std::atomic<uint64_t> values[LogMetrics::COUNTER_COUNT];
+    char pad[CACHE_LINE - sizeof(std::atomic<uint64_t>) * LogMetrics::COUNTER_COUNT % CACHE_LINE];
+};
+
+static std::atomic<uint32_t> s_next_stripe(0);
+// 线程第一次计数时分配分片，轮流使用
+static thread_local uint32_t t_stripe = (uint32_t)-1;
+
+std::atomic<bool> LogMetrics::s_enabled(true);
+
+uint64_t LogMetricsSnapshot::getEvents() const {
+    uint64_t total = 0;
+    for(int i = 0; i < LogMetrics::EVENTS_END; ++i) {
+        total += values[i];
+    }
+    return total;
+}
+
+LogMetrics::LogMetrics() {
+    static_assert(LogMetrics::COUNTER_COUNT <= sizeof(LogMetricsSnapshot::values) / sizeof(uint64_t)
+                  ,"LogMetricsSnapshot too small");
+    static_assert(sizeof(LogMetricsStripe) % CACHE_LINE == 0, "stripe must fill whole cache lines");
+    if(posix_memalign(&m_stripes, CACHE_LINE, sizeof(LogMetricsStripe) * STRIPES) != 0) {
+        throw std::bad_alloc();
+    }
+    LogMetricsStripe* stripes = (LogMetricsStripe*)m_stripes;
+    for(size_t i = 0; i < STRIPES; ++i) {
+        new (&stripes[i]) LogMetricsStripe;
+        for(auto& v : stripes[i].values) {
+            v.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+LogMetrics::~LogMetrics() {
+    free(m_stripes);
+}
+
+std::atomic<uint64_t>* LogMetrics::stripe() {
+    if(t_stripe == (uint32_t)-1) {
+        t_stripe = s_next_stripe.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+    }
+    return ((LogMetricsStripe*)m_stripes)[t_stripe].values;
+}
+
+LogMetricsSnapshot LogMetrics::snapshot() const {
+    LogMetricsSnapshot snap;
+    const LogMetricsStripe* stripes = (const LogMetricsStripe*)m_stripes;
+    for(size_t i = 0; i < STRIPES; ++i) {
+        for(int j = 0; j < COUNTER_COUNT; ++j) {
+            snap.values[j] += stripes[i].values[j].load(std::memory_order_relaxed);
+        }
+    }
+    return snap;
+}
+
+void LogMetrics::SetEnabled(bool v) {
+    s_enabled.store(v, std::memory_order_relaxed);
+}
+
+}
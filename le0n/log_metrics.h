@@ -0,0 +1,96 @@
+#ifndef __LE0N_LOG_METRICS_H__
+#define __LE0N_LOG_METRICS_H__
+
+#include <atomic>
+#include <stdint.h>
+#include "util.h"
+
+namespace le0n{
+
+/**
+ * @brief 某一时刻的统计值(各分片之和)
+ */
+struct LogMetricsSnapshot {
+    // 下标为 LogMetrics::Counter
+    uint64_t values[16] = {0};
+    // 队列中等待输出的条数/字节数，-1 表示不适用
+    int64_t queue_depth = -1;
+
+    uint64_t getEvents() const;
+};
+
+/**
+ * @brief 日志系统自身的统计计数
+ * @details 计数分成若干个按缓存行对齐的分片，线程固定使用其中一个分片，
+ *  线程数不超过分片数时，各线程写自己的缓存行，互不干扰；读取时把各分片相加。
+ *  SetEnabled(false) 后所有计数和计时都跳过(用于测量统计本身的开销)
+ */
+class LogMetrics{
+public:
+    enum Counter {
+        // 0~5: 各级别的日志条数，下标为 LogLevel::Level
+        EVENTS_END = 6,
+        BYTES = EVENTS_END,     //输出的字节数
+        DROPPED,                //丢弃的日志条数
+        ERRORS,                 //写入/打开失败次数
+        FORMAT_NS,              //格式化累计耗时
+        WRITE_NS,               //写入累计耗时
+        COUNTER_COUNT
+    };
+
+    LogMetrics();
+    ~LogMetrics();
+    LogMetrics(const LogMetrics&) = delete;
+    LogMetrics& operator=(const LogMetrics&) = delete;
+
+    void add(Counter counter, uint64_t v = 1) {
+        if(IsEnabled()) {
+            stripe()[counter].fetch_add(v, std::memory_order_relaxed);
+        }
+    }
+
+    // level 为 LogLevel::Level
+    void addEvent(int level, uint64_t v = 1) {
+        if(IsEnabled() && level >= 0 && level < EVENTS_END) {
+            stripe()[level].fetch_add(v, std::memory_order_relaxed);
+        }
+    }
+
+    // 各分片求和，queue_depth 由调用方填写
+    LogMetricsSnapshot snapshot() const;
+
+    static void SetEnabled(bool v);
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+private:
+    std::atomic<uint64_t>* stripe();
+private:
+    static std::atomic<bool> s_enabled;
+    // 分片数组，每个分片独占整数个缓存行
+    void* m_stripes = nullptr;
+};
+
+/**
+ * @brief 分段计时，关闭统计时不读时钟
+ */
+class LogMetricsTimer{
+public:
+    LogMetricsTimer()
+        :m_last(LogMetrics::IsEnabled() ? GetMonotonicNS() : 0) {}
+
+    // 距上一次 lap()(或构造)的纳秒数
+    uint64_t lap() {
+        if(!m_last) {
+            return 0;
+        }
+        uint64_t now = GetMonotonicNS();
+        uint64_t d = now - m_last;
+        m_last = now;
+        return d;
+    }
+private:
+    uint64_t m_last;
+};
+
+}
+
+#endif
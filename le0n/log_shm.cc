@@ -0,0 +1,430 @@
+#include "log_shm.h"
+#include <algorithm>
+#include <iostream>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+namespace le0n{
+
+static const char s_magic[8] = {'L', 'E', '0', 'N', 'S', 'H', 'M', '\0'};
+static const uint32_t SHM_VERSION = 2;
+static const uint32_t SLOT_SIZE = 128;
+
+/**
+ * @brief 槽位
+ * @details seq == pos + 1 表示从 pos 开始的一条日志已提交，只有首个槽位的 seq 有意义；
+ *  size/count 只在首个槽位有效
+ */
+struct ShmLogSlot {
+    std::atomic<uint64_t> seq;
+    uint32_t size;      //日志总字节数
+    uint32_t count;     //占用的槽位数
+    char data[SLOT_SIZE - 16];
+};
+
+static const uint32_t SLOT_DATA = sizeof(((ShmLogSlot*)0)->data);
+
+struct ShmLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint64_t slot_count;
+    int32_t pid;                        //写入方进程
+    std::atomic<uint32_t> closed;       //写入方正常关闭
+    uint64_t start_time;                //写入方进程的启动时间，用于识别 pid 复用(0 表示未知)
+    uint32_t instance;                  //写入方进程内的序号
+    char pad0[20];
+    std::atomic<uint64_t> reserve;      //写入方预留到的位置
+    char pad1[56];
+    std::atomic<uint64_t> read_pos;     //读取方读到的位置
+    char pad2[56];
+    std::atomic<uint32_t> futex;        //唤醒计数
+    std::atomic<uint32_t> waiting;      //读取方是否在睡眠
+    std::atomic<uint64_t> dropped;
+    char pad3[48];
+
+    ShmLogSlot* slots() { return (ShmLogSlot*)(this + 1); }
+};
+
+// 日志的二进制编码: 定长部分 + 文件名 + 日志器名 + 内容
+struct ShmLogRecordHead {
+    uint64_t mono_ns;
+    uint64_t time;
+    uint32_t thread_id;
+    uint32_t fiber_id;
+    uint32_t elapse;
+    int32_t line;
+    uint32_t level;
+    uint32_t file_len;
+    uint32_t logger_len;
+    uint32_t content_len;
+};
+
+static int futex(std::atomic<uint32_t>* addr, int op, uint32_t val, const struct timespec* ts) {
+    // 跨进程共享，不能使用 FUTEX_PRIVATE_FLAG
+    return syscall(SYS_futex, (uint32_t*)addr, op, val, ts, nullptr, 0);
+}
+
+// 进程启动时间(/proc/<pid>/stat 第 22 项，开机以来的时钟滴答数)，进程不存在或读取失败返回 0
+static uint64_t GetProcessStartTime(pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return 0;
+    }
+    char buf[1024];
+    ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if(n <= 0) {
+        return 0;
+    }
+    buf[n] = '\0';
+    // 进程名可能包含空格和括号，从最后一个 ')' 之后开始数: 之后第一项是第 3 项(state)
+    const char* p = strrchr(buf, ')');
+    if(!p) {
+        return 0;
+    }
+    int field = 2;
+    while(*p && field < 22) {
+        if(*p++ == ' ') {
+            ++field;
+        }
+    }
+    return field == 22 ? strtoull(p, nullptr, 10) : 0;
+}
+
+// 本进程创建过的共享内存个数，和 pid、启动时间一起组成共享内存名
+static std::atomic<uint32_t> s_shm_instance(0);
+
+ShmLogAppender::ShmLogAppender(const std::string& prefix, size_t size) {
+    uint64_t slot_count = std::max<uint64_t>(size / SLOT_SIZE, 16);
+    m_size = sizeof(ShmLogHeader) + slot_count * SLOT_SIZE;
+
+    // 名字在所有进程、所有实例之间唯一；已存在时绝不删除(可能是别的写入方还没读完的日志)
+    pid_t pid = getpid();
+    uint64_t start_time = GetProcessStartTime(pid);
+    uint32_t instance = 0;
+    int fd = -1;
+    for(int i = 0; i < 16 && fd < 0; ++i) {
+        instance = ++s_shm_instance;
+        m_name = "/" + prefix + "." + std::to_string(pid) + "." + std::to_string(start_time)
+                 + "." + std::to_string(instance);
+        fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if(fd < 0 && errno != EEXIST) {
+            break;
+        }
+    }
+    if(fd < 0) {
+        std::cerr << "ShmLogAppender shm_open " << m_name << " failed: " << strerror(errno) << std::endl;
+        m_metrics.add(LogMetrics::ERRORS);
+        return;
+    }
+    void* addr = MAP_FAILED;
+    if(ftruncate(fd, m_size) == 0) {
+        addr = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if(addr == MAP_FAILED) {
+        std::cerr << "ShmLogAppender mmap " << m_name << " failed: " << strerror(errno) << std::endl;
+        shm_unlink(m_name.c_str());
+        m_metrics.add(LogMetrics::ERRORS);
+        return;
+    }
+    // ftruncate 出来的内存全为 0，原子变量的初始值就是 0
+    ShmLogHeader* header = (ShmLogHeader*)addr;
+    header->version = SHM_VERSION;
+    header->slot_size = SLOT_SIZE;
+    header->slot_count = slot_count;
+    header->pid = pid;
+    header->start_time = start_time;
+    header->instance = instance;
+    // magic 最后写，读取方看到 magic 才认为初始化完成
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, s_magic, sizeof(s_magic));
+    m_header = header;
+}
+
+ShmLogAppender::~ShmLogAppender() {
+    if(m_header) {
+        m_header->closed.store(1, std::memory_order_release);
+        m_header->futex.fetch_add(1, std::memory_order_release);
+        futex(&m_header->futex, FUTEX_WAKE, 1, nullptr);
+        munmap(m_header, m_size);
+    }
+}
+
+uint64_t ShmLogAppender::getDropped() const {
+    return m_header ? m_header->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+int64_t ShmLogAppender::getQueueDepth() const {
+    if(!m_header) {
+        return -1;
+    }
+    // 已预留但读取方还没读走的槽位数
+    uint64_t reserve = m_header->reserve.load(std::memory_order_relaxed);
+    uint64_t read_pos = m_header->read_pos.load(std::memory_order_relaxed);
+    return reserve > read_pos ? reserve - read_pos : 0;
+}
+
+void ShmLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) {
+    if(level < m_level || !m_header) {
+        return;
+    }
+    static thread_local std::string t_buf;
+    LogMetricsTimer timer;
+    std::string content = event->getContent();
+    const char* file = event->getFile() ? event->getFile() : "";
+    ShmLogRecordHead head;
+    head.mono_ns = GetMonotonicNS();
+    head.time = event->getTime();
+    head.thread_id = event->getThreadId();
+    head.fiber_id = event->getFiberId();
+    head.elapse = event->getElapse();
+    head.line = event->getLine();
+    head.level = level;
+    head.file_len = strlen(file);
+    head.logger_len = logger->getName().size();
+    head.content_len = content.size();
+    t_buf.assign((const char*)&head, sizeof(head));
+    t_buf.append(file, head.file_len);
+    t_buf.append(logger->getName());
+    t_buf.append(content);
+    m_metrics.add(LogMetrics::FORMAT_NS, timer.lap());
+
+    ShmLogHeader* h = m_header;
+    uint64_t count = (t_buf.size() + SLOT_DATA - 1) / SLOT_DATA;
+    if(count > h->slot_count) {
+        h->dropped.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.add(LogMetrics::DROPPED);
+        return;
+    }
+    uint64_t pos = h->reserve.load(std::memory_order_relaxed);
+    do {
+        if(pos + count - h->read_pos.load(std::memory_order_acquire) > h->slot_count) {
+            h->dropped.fetch_add(1, std::memory_order_relaxed);
+            m_metrics.add(LogMetrics::DROPPED);
+            return;
+        }
+    } while(!h->reserve.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed));
+
+    ShmLogSlot* slots = h->slots();
+    const char* data = t_buf.c_str();
+    size_t left = t_buf.size();
+    for(uint64_t i = 0; i < count; ++i) {
+        size_t n = std::min<size_t>(left, SLOT_DATA);
+        memcpy(slots[(pos + i) % h->slot_count].data, data, n);
+        data += n;
+        left -= n;
+    }
+    ShmLogSlot& first = slots[pos % h->slot_count];
+    first.size = t_buf.size();
+    first.count = count;
+    first.seq.store(pos + 1, std::memory_order_release);
+    m_metrics.add(LogMetrics::WRITE_NS, timer.lap());
+    m_metrics.addEvent(level);
+    m_metrics.add(LogMetrics::BYTES, t_buf.size());
+
+    // 提交和检查 waiting 之间需要全屏障，与读取方"设置 waiting 再检查数据"配对
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(h->waiting.load(std::memory_order_relaxed)) {
+        h->futex.fetch_add(1, std::memory_order_release);
+        futex(&h->futex, FUTEX_WAKE, 1, nullptr);
+    }
+}
+
+ShmLogReader::ptr ShmLogReader::Open(const std::string& shm_name) {
+    int fd = shm_open(shm_name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if(fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmLogHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED) {
+        return nullptr;
+    }
+    ShmLogReader::ptr reader(new ShmLogReader);
+    reader->m_name = shm_name;
+    reader->m_header = (ShmLogHeader*)addr;
+    reader->m_size = st.st_size;
+    ShmLogHeader* h = reader->m_header;
+    if(memcmp(h->magic, s_magic, sizeof(s_magic)) != 0
+            || h->version != SHM_VERSION
+            || h->slot_size != SLOT_SIZE
+            || sizeof(ShmLogHeader) + h->slot_count * SLOT_SIZE > reader->m_size) {
+        return nullptr;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return reader;
+}
+
+ShmLogReader::~ShmLogReader() {
+    if(m_header) {
+        munmap(m_header, m_size);
+    }
+}
+
+bool ShmLogReader::isWriterAlive() const {
+    if(m_header->start_time) {
+        // pid 可能已被复用，启动时间一致才是原来的写入方
+        return GetProcessStartTime(m_header->pid) == m_header->start_time;
+    }
+    return kill(m_header->pid, 0) == 0 || errno != ESRCH;
+}
+
+bool ShmLogReader::hasCommitted() const {
+    uint64_t pos = m_header->read_pos.load(std::memory_order_relaxed);
+    ShmLogSlot& slot = m_header->slots()[pos % m_header->slot_count];
+    return slot.seq.load(std::memory_order_acquire) == pos + 1;
+}
+
+size_t ShmLogReader::read(std::vector<ShmLogRecord>& out) {
+    ShmLogHeader* h = m_header;
+    ShmLogSlot* slots = h->slots();
+    uint64_t pos = h->read_pos.load(std::memory_order_relaxed);
+    bool writer_alive = true;
+    bool alive_checked = false;
+    std::string buf;
+    size_t n = 0;
+    while(pos < h->reserve.load(std::memory_order_acquire)) {
+        ShmLogSlot& first = slots[pos % h->slot_count];
+        if(first.seq.load(std::memory_order_acquire) != pos + 1) {
+            // 未提交: 写入方还活着就等它写完，否则这个槽位永远不会提交了
+            if(!alive_checked) {
+                writer_alive = isWriterAlive();
+                alive_checked = true;
+            }
+            if(writer_alive) {
+                break;
+            }
+            ++m_skipped;
+            ++pos;
+            h->read_pos.store(pos, std::memory_order_release);
+            continue;
+        }
+        uint32_t size = first.size;
+        uint32_t count = first.count;
+        buf.clear();
+        for(uint32_t i = 0; i < count; ++i) {
+            size_t len = std::min<size_t>(size - buf.size(), SLOT_DATA);
+            buf.append(slots[(pos + i) % h->slot_count].data, len);
+        }
+        pos += count;
+        // 读完再推进读位置，写入方才能复用这些槽位
+        h->read_pos.store(pos, std::memory_order_release);
+
+        ShmLogRecordHead head;
+        if(buf.size() < sizeof(head)) {
+            continue;
+        }
+        memcpy(&head, buf.c_str(), sizeof(head));
+        if(sizeof(head) + (uint64_t)head.file_len + head.logger_len + head.content_len != buf.size()) {
+            continue;
+        }
+        ShmLogRecord rec;
+        rec.mono_ns = head.mono_ns;
+        rec.time = head.time;
+        rec.thread_id = head.thread_id;
+        rec.fiber_id = head.fiber_id;
+        rec.elapse = head.elapse;
+        rec.line = head.line;
+        rec.level = (LogLevel::Level)head.level;
+        const char* p = buf.c_str() + sizeof(head);
+        rec.file.assign(p, head.file_len);
+        p += head.file_len;
+        rec.logger.assign(p, head.logger_len);
+        p += head.logger_len;
+        rec.content.assign(p, head.content_len);
+        out.push_back(std::move(rec));
+        ++n;
+    }
+    return n;
+}
+
+bool ShmLogReader::wait(uint64_t timeout_ms) {
+    ShmLogHeader* h = m_header;
+    uint32_t val = h->futex.load(std::memory_order_acquire);
+    h->waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool rt = true;
+    if(!hasCommitted() && !h->closed.load(std::memory_order_acquire)) {
+        struct timespec ts;
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = timeout_ms % 1000 * 1000000;
+        rt = futex(&h->futex, FUTEX_WAIT, val, &ts) == 0 || errno == EAGAIN;
+    }
+    h->waiting.store(0, std::memory_order_relaxed);
+    return rt;
+}
+
+bool ShmLogReader::isFinished() const {
+    ShmLogHeader* h = m_header;
+    if(h->read_pos.load(std::memory_order_acquire) != h->reserve.load(std::memory_order_acquire)) {
+        return false;
+    }
+    return h->closed.load(std::memory_order_acquire) || !isWriterAlive();
+}
+
+void ShmLogReader::unlink() {
+    // 确认这个名字下仍是本读取方打开的那块共享内存(写入方 pid、启动时间、序号一致)才删除
+    int fd = shm_open(m_name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if(fd < 0) {
+        return;
+    }
+    struct stat st;
+    void* addr = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ShmLogHeader)) {
+        addr = mmap(nullptr, sizeof(ShmLogHeader), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if(addr == MAP_FAILED) {
+        return;
+    }
+    const ShmLogHeader* h = (const ShmLogHeader*)addr;
+    bool same = memcmp(h->magic, s_magic, sizeof(s_magic)) == 0
+                && h->pid == m_header->pid
+                && h->start_time == m_header->start_time
+                && h->instance == m_header->instance;
+    munmap(addr, sizeof(ShmLogHeader));
+    if(same) {
+        shm_unlink(m_name.c_str());
+    }
+}
+
+uint64_t ShmLogReader::getDropped() const {
+    return m_header->dropped.load(std::memory_order_relaxed);
+}
+
+void ListShmLogs(const std::string& prefix, std::vector<std::string>& names) {
+    DIR* dir = opendir("/dev/shm");
+    if(!dir) {
+        return;
+    }
+    std::string p = prefix + ".";
+    struct dirent* dp = nullptr;
+    while((dp = readdir(dir)) != nullptr) {
+        if(strncmp(dp->d_name, p.c_str(), p.size()) == 0) {
+            names.push_back(std::string("/") + dp->d_name);
+        }
+    }
+    closedir(dir);
+}
+
+}
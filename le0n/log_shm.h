@@ -0,0 +1,140 @@
+#ifndef __LE0N_LOG_SHM_H__
+#define __LE0N_LOG_SHM_H__
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "log.h"
+
+/**
+ * @brief 共享内存日志通道
+ * @details 业务进程用 ShmLogAppender 把日志事件(二进制，不做格式化)写进共享内存环形缓冲区，
+ *  日志进程(le0n_logd)用 ShmLogReader 读取后再格式化、写文件、切分，
+ *  业务进程不做任何文件 I/O。
+ *
+ *  共享内存名为 "/<prefix>.<pid>.<进程启动时间>.<序号>"(位于 /dev/shm)，每个 Appender 一个，
+ *  同一进程的多个 Appender、pid 被复用的新进程都不会重名；由写入方创建，
+ *  读取方读完并确认写入方已退出后删除。
+ *
+ *  缓冲区由定长槽位组成，一条日志占用连续的若干槽位(可以跨越环尾)：
+ *  1. 写入方用 CAS 预留槽位，写完数据后把首个槽位的序号置为 pos + 1 表示提交；
+ *  2. 读取方只读取已提交的日志，读完后推进读位置；
+ *  3. 写入方进程崩溃时，预留了但没有提交的槽位由读取方逐个跳过，已提交的日志不会丢失；
+ *  4. 缓冲区满时丢弃日志并计数，不阻塞业务线程；
+ *  5. 读取方空闲时在 futex 上睡眠，写入方提交后发现读取方在等待才发起唤醒。
+ */
+namespace le0n{
+
+struct ShmLogHeader;
+
+/**
+ * @brief 从共享内存里读出的一条日志
+ */
+struct ShmLogRecord {
+    uint64_t mono_ns = 0;       //单调时钟，用于多个进程之间排序
+    uint64_t time = 0;          //日志时间(秒)
+    uint32_t thread_id = 0;
+    uint32_t fiber_id = 0;
+    uint32_t elapse = 0;
+    int32_t line = 0;
+    LogLevel::Level level = LogLevel::UNKNOWN;
+    std::string file;
+    std::string logger;
+    std::string content;
+};
+
+/**
+ * @brief 写入共享内存的 Appender
+ * @details 日志器名称、文件名、内容等原样写入，格式化由日志进程完成，本 Appender 的格式器不使用
+ */
+class ShmLogAppender : public LogAppender{
+public:
+    typedef std::shared_ptr<ShmLogAppender> ptr;
+
+    /**
+     * @brief 构造函数，创建共享内存
+     * @param[in] prefix 共享内存名前缀，日志进程按前缀发现所有写入方
+     * @param[in] size 缓冲区大小(字节)
+     */
+    ShmLogAppender(const std::string& prefix, size_t size = 4 * 1024 * 1024);
+    // 标记为正常关闭，共享内存由日志进程读完后删除
+    ~ShmLogAppender();
+
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override;
+
+    // 已写入但还没有被读取方取走的槽位数
+    virtual int64_t getQueueDepth() const override;
+    virtual const char* getType() const override { return "ShmLogAppender"; }
+
+    bool isValid() const { return m_header != nullptr; }
+    const std::string& getShmName() const { return m_name; }
+    // 因缓冲区满丢弃的日志条数
+    uint64_t getDropped() const;
+private:
+    std::string m_name;
+    ShmLogHeader* m_header = nullptr;
+    size_t m_size = 0;
+};
+
+/**
+ * @brief 读取一个写入方的共享内存
+ * @details 只允许一个读取方
+ */
+class ShmLogReader{
+public:
+    typedef std::shared_ptr<ShmLogReader> ptr;
+
+    /**
+     * @brief 打开已经存在的共享内存，格式不对返回 nullptr
+     */
+    static ptr Open(const std::string& shm_name);
+    ~ShmLogReader();
+
+    /**
+     * @brief 取出所有已提交的日志
+     * @details 写入方进程已经不存在时，跳过预留了但没有提交的槽位
+     * @return 取出的条数
+     */
+    size_t read(std::vector<ShmLogRecord>& out);
+
+    /**
+     * @brief 没有已提交的日志时等待唤醒
+     * @return 被唤醒或已有数据返回 true，超时返回 false
+     */
+    bool wait(uint64_t timeout_ms);
+
+    /**
+     * @brief 写入方已经关闭或退出，并且所有日志都已读完
+     */
+    bool isFinished() const;
+
+    // 写入方进程是否还存在(比较 pid 和进程启动时间，pid 被复用时返回 false)
+    bool isWriterAlive() const;
+
+    // 删除共享内存(isFinished 之后调用)，该名字下已经不是本读取方打开的共享内存时不删除
+    void unlink();
+
+    const std::string& getShmName() const { return m_name; }
+    uint64_t getDropped() const;
+    // 因写入方崩溃跳过的槽位数
+    uint64_t getSkipped() const { return m_skipped; }
+private:
+    ShmLogReader() {}
+    bool hasCommitted() const;
+private:
+    std::string m_name;
+    ShmLogHeader* m_header = nullptr;
+    size_t m_size = 0;
+    uint64_t m_skipped = 0;
+};
+
+/**
+ * @brief 列出 /dev/shm 下所有以 "<prefix>." 开头的共享内存名
+ */
+void ListShmLogs(const std::string& prefix, std::vector<std::string>& names);
+
+}
+
+#endif
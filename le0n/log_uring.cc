@@ -0,0 +1,498 @@
+#include "log_uring.h"
+#include "log_budget.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+namespace le0n{
+
+// O_DIRECT 要求地址、长度、偏移都按块对齐，取 4K 以兼容大多数设备
+static const size_t ALIGN = 4096;
+// 每次用 fallocate 预留的文件空间，避免每次追加写都分配块
+static const uint64_t PREALLOC = 64ull * 1024 * 1024;
+
+static size_t AlignUp(size_t v) {
+    return (v + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+/**
+ * @brief 最小的 io_uring 封装：只用于提交写请求和回收完成事件
+ */
+struct UringRing {
+    int fd = -1;
+    bool fixed = false;     //缓冲区是否已注册(可使用 WRITE_FIXED)
+    void* sq_ptr = MAP_FAILED;
+    size_t sq_size = 0;
+    void* cq_ptr = MAP_FAILED;
+    size_t cq_size = 0;
+    io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+    size_t sqes_size = 0;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+};
+
+static void UringDestroy(UringRing* ring) {
+    if(ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if(ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if(ring->sq_ptr != MAP_FAILED) {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    if(ring->fd >= 0) {
+        close(ring->fd);
+    }
+    delete ring;
+}
+
+static UringRing* UringCreate(unsigned entries) {
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = syscall(__NR_io_uring_setup, entries, &p);
+    if(fd < 0) {
+        return nullptr;
+    }
+    UringRing* ring = new UringRing;
+    ring->fd = fd;
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_size = ring->cq_size = std::max(ring->sq_size, ring->cq_size);
+    }
+    ring->sq_ptr = mmap(nullptr, ring->sq_size, PROT_READ | PROT_WRITE
+                        ,MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ptr == MAP_FAILED) {
+        UringDestroy(ring);
+        return nullptr;
+    }
+    if(p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(nullptr, ring->cq_size, PROT_READ | PROT_WRITE
+                            ,MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(ring->cq_ptr == MAP_FAILED) {
+            UringDestroy(ring);
+            return nullptr;
+        }
+    }
+    ring->sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = (io_uring_sqe*)mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE
+                        ,MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED) {
+        UringDestroy(ring);
+        return nullptr;
+    }
+    char* sq = (char*)ring->sq_ptr;
+    char* cq = (char*)ring->cq_ptr;
+    ring->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+    return ring;
+}
+
+static int UringEnter(UringRing* ring, unsigned submit, unsigned wait) {
+    while(true) {
+        int rt = syscall(__NR_io_uring_enter, ring->fd, submit, wait
+                         ,wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if(rt < 0 && errno == EINTR) {
+            continue;
+        }
+        return rt;
+    }
+}
+
+/**
+ * @brief 提交一个写请求
+ * @details 在途请求数不超过缓冲区个数，也就不超过 SQ 容量，这里不检查 SQ 是否已满
+ */
+static bool UringWrite(UringRing* ring, int fd, const char* data, size_t len
+                       ,uint64_t offset, size_t idx) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = ring->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->buf_index = idx;
+    sqe->user_data = idx;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    if(UringEnter(ring, 1, 0) == 1) {
+        return true;
+    }
+    // 提交失败，撤回这个 sqe
+    __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+    return false;
+}
+
+// 同步写，处理部分写入
+static bool PwriteAll(int fd, const char* data, size_t len, uint64_t offset) {
+    while(len > 0) {
+        ssize_t n = pwrite(fd, data, len, offset);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+UringFileLogAppender::UringFileLogAppender(const std::string& filename, bool append, bool direct
+                                           ,size_t buffer_size, uint32_t depth)
+    :m_filename(filename)
+    ,m_append(append)
+    ,m_wantDirect(direct)
+    ,m_bufferSize(AlignUp(std::max<size_t>(buffer_size, ALIGN))) {
+    depth = std::max<uint32_t>(depth, 1);
+    m_buffers.resize(depth);
+    for(size_t i = 0; i < m_buffers.size(); ++i) {
+        void* p = nullptr;
+        if(posix_memalign(&p, ALIGN, m_bufferSize) != 0) {
+            throw std::bad_alloc();
+        }
+        // 预先触碰所有页，提交时不再产生缺页
+        memset(p, 0, m_bufferSize);
+        m_buffers[i].data = (char*)p;
+        m_free.push_back(i);
+    }
+    // 缓冲区大小固定，只从预算中扣掉排队日志的额度，不参与降级
+    m_charged = LogMemoryBudget::Reserve(m_bufferSize * m_buffers.size());
+
+    m_ring = UringCreate(depth);
+    if(m_ring) {
+        std::vector<iovec> iovs(m_buffers.size());
+        for(size_t i = 0; i < m_buffers.size(); ++i) {
+            iovs[i].iov_base = m_buffers[i].data;
+            iovs[i].iov_len = m_bufferSize;
+        }
+        // 注册失败(如超过 memlock 限制)时退回普通写请求
+        m_ring->fixed = syscall(__NR_io_uring_register, m_ring->fd, IORING_REGISTER_BUFFERS
+                                ,iovs.data(), iovs.size()) == 0;
+    }
+    openFile();
+    AddFlushTimer(this);
+}
+
+UringFileLogAppender::~UringFileLogAppender() {
+    DelFlushTimer(this);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    closeFile();
+    if(m_ring) {
+        UringDestroy(m_ring);
+    }
+    for(auto& i : m_buffers) {
+        free(i.data);
+    }
+    LogMemoryBudget::Unreserve(m_charged);
+}
+
+bool UringFileLogAppender::openFile() {
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (m_append ? 0 : O_TRUNC);
+    m_direct = false;
+    if(m_wantDirect) {
+        m_fd = open(m_filename.c_str(), flags | O_DIRECT, 0644);
+        m_direct = m_fd >= 0;
+    }
+    if(m_fd < 0) {
+        m_fd = open(m_filename.c_str(), flags, 0644);
+    }
+    if(m_fd < 0) {
+        std::cerr << "UringFileLogAppender open " << m_filename << " failed: " << strerror(errno) << std::endl;
+        addError();
+        return false;
+    }
+    // 自己维护写入偏移(pwrite 语义)，不能使用 O_APPEND
+    off_t size = lseek(m_fd, 0, SEEK_END);
+    m_offset = size < 0 ? 0 : size;
+    m_allocated = m_offset;
+
+    uint64_t tail = m_offset % ALIGN;
+    if(m_direct && tail) {
+        // 追加到未对齐的文件尾: 把最后一个块读回缓冲区，之后整块重写
+        nextBuffer();
+        Buffer& b = m_buffers[m_cur];
+        int rfd = open(m_filename.c_str(), O_RDONLY | O_CLOEXEC);
+        ssize_t n = rfd < 0 ? -1 : pread(rfd, b.data, tail, m_offset - tail);
+        if(rfd >= 0) {
+            close(rfd);
+        }
+        if(n == (ssize_t)tail) {
+            b.size = tail;
+            m_offset -= tail;
+        } else {
+            // 读不回文件尾就无法对齐写入，改用普通方式打开
+            m_free.push_back(m_cur);
+            m_cur = -1;
+            close(m_fd);
+            m_direct = false;
+            m_fd = open(m_filename.c_str(), flags, 0644);
+            return m_fd >= 0;
+        }
+    }
+    return true;
+}
+
+void UringFileLogAppender::closeFile() {
+    if(m_fd < 0) {
+        return;
+    }
+    drain();
+    if(m_cur >= 0) {
+        m_free.push_back(m_cur);
+        m_cur = -1;
+    }
+    // 释放 fallocate 预留但没有用到的空间
+    off_t size = lseek(m_fd, 0, SEEK_END);
+    if(size >= 0 && m_allocated > (uint64_t)size) {
+        if(ftruncate(m_fd, size) != 0) {
+            addError();
+        }
+    }
+    close(m_fd);
+    m_fd = -1;
+}
+
+void UringFileLogAppender::nextBuffer() {
+    while(m_free.empty()) {
+        reap(1);
+    }
+    m_cur = m_free.back();
+    m_free.pop_back();
+    m_buffers[m_cur].size = 0;
+    m_firstNS = 0;
+}
+
+void UringFileLogAppender::append(const char* data, size_t len) {
+    while(len > 0) {
+        if(m_cur < 0) {
+            nextBuffer();
+        }
+        Buffer& b = m_buffers[m_cur];
+        size_t n = std::min(len, m_bufferSize - b.size);
+        memcpy(b.data + b.size, data, n);
+        b.size += n;
+        data += n;
+        len -= n;
+        if(b.size == m_bufferSize) {
+            submitCurrent();
+        }
+    }
+    if(m_cur < 0 || m_buffers[m_cur].size == 0) {
+        return;
+    }
+    uint64_t now = GetMonotonicNS();
+    if(m_firstNS == 0) {
+        m_firstNS = now;
+    } else if(now - m_firstNS >= m_flushIntervalNS) {
+        submitCurrent();
+    }
+}
+
+void UringFileLogAppender::submitCurrent() {
+    if(m_cur < 0 || m_buffers[m_cur].size == 0 || m_fd < 0) {
+        return;
+    }
+    size_t idx = m_cur;
+    Buffer& b = m_buffers[idx];
+    // 写完成后缓冲区会被回收(size 清零)，先记下来
+    size_t size = b.size;
+    m_cur = -1;
+    b.offset = m_offset;
+    b.length = size;
+    size_t tail = 0;
+    if(m_direct) {
+        // 未写满的缓冲区补零到整块，最后一个不完整的块在下一个缓冲区里重写
+        tail = size % ALIGN;
+        b.length = AlignUp(size);
+        memset(b.data + size, 0, b.length - size);
+    }
+    m_offset += size - tail;
+
+    if(m_allocated != (uint64_t)-1 && b.offset + b.length > m_allocated) {
+        uint64_t end = (b.offset + b.length + PREALLOC - 1) / PREALLOC * PREALLOC;
+        if(fallocate(m_fd, FALLOC_FL_KEEP_SIZE, m_allocated, end - m_allocated) == 0) {
+            m_allocated = end;
+        } else {
+            // 文件系统不支持，不再尝试
+            m_allocated = (uint64_t)-1;
+        }
+    }
+
+    ++m_inflight;
+    if(m_ring && UringWrite(m_ring, m_fd, b.data, b.length, b.offset, idx)) {
+        // 顺便回收已经完成的请求，不等待
+        reap(0);
+    } else {
+        bool ok = PwriteAll(m_fd, b.data, b.length, b.offset);
+        complete(idx, ok ? (int)b.length : -errno);
+    }
+
+    if(tail) {
+        // 重写同一个块的请求不能和这个请求同时在途，等它们全部完成
+        while(m_inflight) {
+            reap(1);
+        }
+        // 去掉补齐的零
+        if(ftruncate(m_fd, b.offset + size) != 0) {
+            addError();
+        }
+        if(m_allocated != (uint64_t)-1) {
+            m_allocated = b.offset + size;
+        }
+        // 刚完成的缓冲区可能就是下一个缓冲区，用 memmove
+        nextBuffer();
+        Buffer& next = m_buffers[m_cur];
+        memmove(next.data, b.data + size - tail, tail);
+        next.size = tail;
+    }
+}
+
+void UringFileLogAppender::reap(uint32_t wait) {
+    if(!m_ring || !m_inflight) {
+        return;
+    }
+    if(wait && UringEnter(m_ring, 0, std::min(wait, m_inflight)) < 0) {
+        addError();
+        return;
+    }
+    unsigned head = *m_ring->cq_head;
+    unsigned tail = __atomic_load_n(m_ring->cq_tail, __ATOMIC_ACQUIRE);
+    while(head != tail) {
+        io_uring_cqe* cqe = &m_ring->cqes[head & *m_ring->cq_mask];
+        size_t idx = cqe->user_data;
+        int res = cqe->res;
+        ++head;
+        __atomic_store_n(m_ring->cq_head, head, __ATOMIC_RELEASE);
+        complete(idx, res);
+    }
+}
+
+void UringFileLogAppender::complete(size_t idx, int res) {
+    Buffer& b = m_buffers[idx];
+    if(res < 0) {
+        if(!addError()) {
+            std::cerr << "UringFileLogAppender write " << m_filename << " failed: "
+                      << strerror(-res) << std::endl;
+        }
+    } else if((size_t)res < b.length) {
+        // 部分写入，剩余部分同步补写
+        if(!PwriteAll(m_fd, b.data + res, b.length - res, b.offset + res)) {
+            addError();
+        }
+    }
+    b.size = 0;
+    m_free.push_back(idx);
+    --m_inflight;
+}
+
+void UringFileLogAppender::drain() {
+    submitCurrent();
+    while(m_inflight) {
+        reap(1);
+    }
+}
+
+void UringFileLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) {
+    if(level < m_level) {
+        return;
+    }
+    // 格式化不需要持锁
+    LogMetricsTimer timer;
+    std::string str = m_formatter->format(logger, level, event);
+    m_metrics.add(LogMetrics::FORMAT_NS, timer.lap());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_fd < 0) {
+            m_metrics.add(LogMetrics::DROPPED);
+            return;
+        }
+        append(str.c_str(), str.size());
+    }
+    m_metrics.add(LogMetrics::WRITE_NS, timer.lap());
+    m_metrics.addEvent(level);
+    m_metrics.add(LogMetrics::BYTES, str.size());
+}
+
+void UringFileLogAppender::logBatch(const LogEvent::ptr* events, size_t count) {
+    LogMetricsTimer timer;
+    std::stringstream ss;
+    uint64_t n = 0;
+    for(size_t i = 0; i < count; ++i) {
+        const LogEvent::ptr& e = events[i];
+        if(e->getLevel() >= m_level) {
+            m_formatter->format(ss, e->getLogger(), e->getLevel(), e);
+            m_metrics.addEvent(e->getLevel());
+            ++n;
+        }
+    }
+    std::string str = ss.str();
+    m_metrics.add(LogMetrics::FORMAT_NS, timer.lap());
+    if(str.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_fd < 0) {
+            m_metrics.add(LogMetrics::DROPPED, n);
+            return;
+        }
+        append(str.c_str(), str.size());
+    }
+    m_metrics.add(LogMetrics::WRITE_NS, timer.lap());
+    m_metrics.add(LogMetrics::BYTES, str.size());
+}
+
+void UringFileLogAppender::onFlushTimer() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_fd < 0) {
+        return;
+    }
+    if(m_cur >= 0 && m_buffers[m_cur].size && m_firstNS
+            && GetMonotonicNS() - m_firstNS >= m_flushIntervalNS) {
+        submitCurrent();
+    }
+    reap(0);
+}
+
+void UringFileLogAppender::flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_fd >= 0) {
+        drain();
+    }
+}
+
+bool UringFileLogAppender::reopen() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    closeFile();
+    return openFile();
+}
+
+}
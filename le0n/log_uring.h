@@ -0,0 +1,129 @@
+#ifndef __LE0N_LOG_URING_H__
+#define __LE0N_LOG_URING_H__
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "log.h"
+
+namespace le0n{
+
+struct UringRing;
+
+/**
+ * @brief 通过 io_uring 写文件的 Appender
+ * @details
+ *  1. 日志格式化后拷贝进预先分配的对齐缓冲区，缓冲区写满才提交一次写请求，
+ *     业务线程只在提交时进入内核，而且不等待写完成；
+ *  2. 同时最多有 depth 个缓冲区在途，写完成后回收复用，全部在途时才等待最早的完成；
+ *  3. 可选 O_DIRECT：绕过页缓存，避免脏页回写造成的整体延迟抖动，
+ *     文件系统不支持时自动退回普通打开方式；
+ *  4. 内核不支持 io_uring(或被禁用)时退回同步 pwrite。
+ *  缓冲区里的日志在写满、超过 flush 间隔(没有新日志时由后台写出线程检查)、调用 flush()/reopen() 或析构时才写入文件，
+ *  进程崩溃会丢失还在缓冲区中的日志，需要每条日志落盘的场景请用 FileLogAppender。
+ *  日志文件打不开(包括 reopen 失败)时丢弃日志，计入 DROPPED。
+ */
+class UringFileLogAppender : public LogAppender{
+public:
+    typedef std::shared_ptr<UringFileLogAppender> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] filename 文件名
+     * @param[in] append 为 true 时保留已有内容追加写入，否则打开时清空文件
+     * @param[in] direct 是否使用 O_DIRECT
+     * @param[in] buffer_size 单个缓冲区大小(向上对齐到 4K)
+     * @param[in] depth 缓冲区个数，即最多同时在途的写请求数
+     */
+    UringFileLogAppender(const std::string& filename, bool append = false, bool direct = false
+                         ,size_t buffer_size = 256 * 1024, uint32_t depth = 4);
+    ~UringFileLogAppender();
+
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent::ptr& event) override;
+    virtual void logBatch(const LogEvent::ptr* events, size_t count) override;
+
+    /**
+     * @brief 提交缓冲区中的日志并等待所有写请求完成
+     */
+    void flush();
+
+    /**
+     * @brief 写完缓冲区后重新打开日志文件
+     * @return 成功返回true
+     */
+    bool reopen();
+
+    // 缓冲区里的日志最多停留多久(毫秒)，超过后下一条日志或后台写出线程会提交
+    void setFlushInterval(uint64_t ms) { m_flushIntervalNS = ms * 1000000ull; }
+
+    // 当前缓冲区超过 flush 间隔时提交，并回收已完成的写请求
+    virtual void onFlushTimer() override;
+
+    // 在途的写请求数
+    virtual int64_t getQueueDepth() const override { return m_inflight; }
+    virtual const char* getType() const override { return "UringFileLogAppender"; }
+
+    // 是否真正使用了 io_uring(否则是 pwrite)
+    bool isUring() const { return m_ring != nullptr; }
+    // 是否真正使用了 O_DIRECT
+    bool isDirect() const { return m_direct; }
+    // 写失败次数
+    uint64_t getErrors() const { return m_errors; }
+private:
+    struct Buffer {
+        char* data = nullptr;
+        size_t size = 0;        //已填充的字节数
+        uint64_t offset = 0;    //在途时写入的文件偏移
+        size_t length = 0;      //在途时提交的字节数
+    };
+
+    bool openFile();
+    void closeFile();
+    void append(const char* data, size_t len);
+    // 取一个空闲缓冲区作为当前缓冲区，没有空闲的就等待写完成
+    void nextBuffer();
+    // 提交当前缓冲区
+    void submitCurrent();
+    /**
+     * @brief 回收已完成的写请求
+     * @param[in] wait 至少等待完成的个数
+     */
+    void reap(uint32_t wait);
+    void complete(size_t idx, int res);
+    // 记一次写失败，返回之前的失败次数
+    uint64_t addError() {
+        m_metrics.add(LogMetrics::ERRORS);
+        return m_errors++;
+    }
+    // 提交当前缓冲区并等待所有写请求完成，O_DIRECT 时修正文件大小
+    void drain();
+private:
+    std::mutex m_mutex;
+    std::string m_filename;
+    bool m_append;
+    bool m_wantDirect;
+    bool m_direct = false;
+    int m_fd = -1;
+    size_t m_bufferSize;
+    UringRing* m_ring = nullptr;
+    std::vector<Buffer> m_buffers;
+    std::vector<size_t> m_free;
+    // 当前缓冲区下标，-1 表示没有
+    ssize_t m_cur = -1;
+    uint32_t m_inflight = 0;
+    // 当前缓冲区的数据从文件的这个位置开始写
+    uint64_t m_offset = 0;
+    // 已经用 fallocate 预留到的位置
+    uint64_t m_allocated = 0;
+    // 当前缓冲区第一条日志的时间
+    uint64_t m_firstNS = 0;
+    std::atomic<uint64_t> m_flushIntervalNS{1000000000ull};
+    uint64_t m_errors = 0;
+    // 预分配的缓冲区计入 LogMemoryBudget 的字节数
+    size_t m_charged = 0;
+};
+
+}
+
+#endif
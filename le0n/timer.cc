@@ -0,0 +1,456 @@
+#include "timer.h"
+#include "util.h"
+#include "log.h"
+
+namespace le0n{
+
+// 第 3 层能覆盖的 tick 数，超过这个范围的定时器放入堆
+static const uint64_t s_wheel_span = 1ull << 26;
+
+Timer::Timer(uint64_t us, std::function<void()> cb,
+             bool recurring, TimerManager* manager)
+    :m_recurring(recurring)
+    ,m_us(us)
+    ,m_cb(cb)
+    ,m_manager(manager) {
+    m_next = GetCurrentUS() + m_us;
+}
+
+bool Timer::cancel() {
+    std::unique_lock<std::mutex> lock(m_manager->m_mutex);
+    if(m_cb) {
+        m_cb = nullptr;
+        // 先持有自己，避免从槽位链表删除时被析构
+        Timer::ptr self = shared_from_this();
+        if(m_level >= 0) {
+            m_manager->remove(this);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool Timer::refresh() {
+    std::unique_lock<std::mutex> lock(m_manager->m_mutex);
+    if(!m_cb || m_level < 0) {
+        return false;
+    }
+    Timer::ptr self = shared_from_this();
+    m_manager->remove(this);
+    m_next = GetCurrentUS() + m_us;
+    m_manager->insert(self);
+    ++m_manager->m_count;
+    return true;
+}
+
+bool Timer::reset(uint64_t us, bool from_now) {
+    if(us == m_us && !from_now) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(m_manager->m_mutex);
+    if(!m_cb || m_level < 0) {
+        return false;
+    }
+    Timer::ptr self = shared_from_this();
+    m_manager->remove(this);
+    uint64_t start = 0;
+    if(from_now) {
+        start = GetCurrentUS();
+    } else {
+        start = m_next - m_us;
+    }
+    m_us = us;
+    m_next = start + m_us;
+    m_manager->addTimer(self, lock);
+    return true;
+}
+
+TimerManager::TimerManager(uint64_t tick_us)
+    :m_tick(tick_us ? tick_us : 1) {
+    static const int s_bits[LEVELS] = {8, 6, 6, 6};
+    int shift = 0;
+    for(int i = 0; i < LEVELS; ++i) {
+        m_levels[i].shift = shift;
+        m_levels[i].bits = s_bits[i];
+        m_levels[i].slots.resize(1u << s_bits[i]);
+        m_levels[i].bitmap.resize(((1u << s_bits[i]) + 63) / 64, 0);
+        shift += s_bits[i];
+    }
+    m_previouseTime = GetCurrentUS();
+    m_curTick = m_previouseTime / m_tick;
+}
+
+TimerManager::~TimerManager() {
+}
+
+Timer::ptr TimerManager::addTimer(uint64_t us, std::function<void()> cb
+                                  ,bool recurring) {
+    Timer::ptr timer(new Timer(us, cb, recurring, this));
+    std::unique_lock<std::mutex> lock(m_mutex);
+    addTimer(timer, lock);
+    return timer;
+}
+
+static void OnTimer(std::weak_ptr<void> weak_cond, std::function<void()> cb) {
+    std::shared_ptr<void> tmp = weak_cond.lock();
+    if(tmp) {
+        cb();
+    }
+}
+
+Timer::ptr TimerManager::addConditionTimer(uint64_t us, std::function<void()> cb
+                                    ,std::weak_ptr<void> weak_cond
+                                    ,bool recurring) {
+    return addTimer(us, std::bind(&OnTimer, weak_cond, cb), recurring);
+}
+
+void TimerManager::addTimer(Timer::ptr val, std::unique_lock<std::mutex>& lock) {
+    insert(val);
+    ++m_count;
+    bool at_front = val->m_next < m_nextHint && !m_tickled;
+    if(at_front) {
+        m_tickled = true;
+    }
+    lock.unlock();
+
+    if(at_front) {
+        onTimerInsertedAtFront();
+    }
+}
+
+static inline void SetBit(std::vector<uint64_t>& bitmap, size_t idx) {
+    bitmap[idx >> 6] |= 1ull << (idx & 63);
+}
+
+static inline void ClearBit(std::vector<uint64_t>& bitmap, size_t idx) {
+    bitmap[idx >> 6] &= ~(1ull << (idx & 63));
+}
+
+// 查找下标 >= from 的第一个非空槽，没有返回 -1
+static inline int FindNextBit(const std::vector<uint64_t>& bitmap, size_t from) {
+    size_t word = from >> 6;
+    if(word >= bitmap.size()) {
+        return -1;
+    }
+    uint64_t bits = bitmap[word] & (~0ull << (from & 63));
+    while(true) {
+        if(bits) {
+            return word * 64 + __builtin_ctzll(bits);
+        }
+        if(++word >= bitmap.size()) {
+            return -1;
+        }
+        bits = bitmap[word];
+    }
+}
+
+static inline bool AnyBit(const std::vector<uint64_t>& bitmap) {
+    for(auto& i : bitmap) {
+        if(i) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TimerManager::insert(Timer::ptr val) {
+    uint64_t tick = val->m_next / m_tick;
+    if(tick < m_curTick) {
+        // 已经过期的定时器放进当前槽，下一次 listExpiredCb 立即触发
+        tick = m_curTick;
+    }
+    uint64_t delta = tick - m_curTick;
+    for(int i = 0; i < LEVELS; ++i) {
+        Level& lv = m_levels[i];
+        if(delta < (1ull << (lv.shift + lv.bits))) {
+            size_t slot = (tick >> lv.shift) & ((1ull << lv.bits) - 1);
+            val->m_level = i;
+            val->m_slot = slot;
+            val->m_it = lv.slots[slot].insert(lv.slots[slot].end(), val);
+            SetBit(lv.bitmap, slot);
+            return;
+        }
+    }
+    heapPush(val);
+}
+
+void TimerManager::remove(Timer* val) {
+    if(val->m_level < 0) {
+        return;
+    }
+    if(val->m_level < LEVELS) {
+        Level& lv = m_levels[val->m_level];
+        std::list<Timer::ptr>& slot = lv.slots[val->m_slot];
+        val->m_level = -1;
+        slot.erase(val->m_it);
+        if(slot.empty()) {
+            ClearBit(lv.bitmap, val->m_slot);
+        }
+    } else {
+        val->m_level = -1;
+        heapErase(val->m_slot);
+    }
+    --m_count;
+}
+
+void TimerManager::cascade(int level, size_t slot) {
+    Level& lv = m_levels[level];
+    if(lv.slots[slot].empty()) {
+        return;
+    }
+    std::list<Timer::ptr> tmp;
+    tmp.swap(lv.slots[slot]);
+    ClearBit(lv.bitmap, slot);
+    for(auto& i : tmp) {
+        insert(i);
+    }
+}
+
+void TimerManager::migrateHeap() {
+    while(!m_heap.empty()) {
+        Timer::ptr top = m_heap.front();
+        uint64_t tick = top->m_next / m_tick;
+        if(tick >= m_curTick && tick - m_curTick >= s_wheel_span) {
+            break;
+        }
+        heapErase(0);
+        insert(top);
+    }
+}
+
+/**
+ * @brief 计算当前 tick 之后第一个需要处理的 tick
+ * @details 从低层往高层找：某层当前下标之后有非空槽，则那个槽就是最近的事件；
+ *  该层只有"绕回下一圈"的槽非空，则最近事件是该层绕回的边界(需要在那里级联)；
+ *  该层完全为空才看上一层。返回 ~0ull 表示时间轮为空。
+ */
+uint64_t TimerManager::nextEventTick() const {
+    for(int i = 0; i < LEVELS; ++i) {
+        const Level& lv = m_levels[i];
+        uint64_t idx = (m_curTick >> lv.shift) & ((1ull << lv.bits) - 1);
+        uint64_t base = (m_curTick >> (lv.shift + lv.bits)) << (lv.shift + lv.bits);
+        int next = FindNextBit(lv.bitmap, idx + 1);
+        if(next >= 0) {
+            return base + ((uint64_t)next << lv.shift);
+        }
+        if(AnyBit(lv.bitmap)) {
+            return base + (1ull << (lv.shift + lv.bits));
+        }
+    }
+    return ~0ull;
+}
+
+void TimerManager::advance(uint64_t now, std::vector<Timer::ptr>& expired) {
+    uint64_t target = now / m_tick;
+    Level& lv0 = m_levels[0];
+    while(true) {
+        size_t idx = m_curTick & ((1ull << lv0.bits) - 1);
+        std::list<Timer::ptr>& slot = lv0.slots[idx];
+        for(auto it = slot.begin(); it != slot.end();) {
+            if((*it)->m_next <= now) {
+                (*it)->m_level = -1;
+                expired.push_back(*it);
+                it = slot.erase(it);
+                --m_count;
+            } else {
+                ++it;
+            }
+        }
+        if(slot.empty()) {
+            ClearBit(lv0.bitmap, idx);
+        }
+        if(m_curTick >= target) {
+            break;
+        }
+
+        // 跳过中间的空 tick，直接走到下一个有事件的 tick
+        uint64_t next = nextEventTick();
+        if(!m_heap.empty()) {
+            uint64_t tick = m_heap.front()->m_next / m_tick;
+            uint64_t migrate = tick >= s_wheel_span ? tick - s_wheel_span + 1 : 0;
+            next = std::min(next, std::max(migrate, m_curTick + 1));
+        }
+        m_curTick = std::max(std::min(next, target), m_curTick + 1);
+
+        if((m_curTick & ((1ull << lv0.bits) - 1)) == 0) {
+            // 低层转完一圈，把上一层对应槽位的定时器级联下来
+            for(int i = 1; i < LEVELS; ++i) {
+                size_t s = (m_curTick >> m_levels[i].shift)
+                            & ((1ull << m_levels[i].bits) - 1);
+                cascade(i, s);
+                if(s != 0) {
+                    break;
+                }
+            }
+        }
+        migrateHeap();
+    }
+}
+
+void TimerManager::takeAll(std::vector<Timer::ptr>& expired) {
+    for(int i = 0; i < LEVELS; ++i) {
+        Level& lv = m_levels[i];
+        for(auto& s : lv.slots) {
+            for(auto& t : s) {
+                t->m_level = -1;
+                expired.push_back(t);
+            }
+            s.clear();
+        }
+        std::fill(lv.bitmap.begin(), lv.bitmap.end(), 0);
+    }
+    for(auto& t : m_heap) {
+        t->m_level = -1;
+        expired.push_back(t);
+    }
+    m_heap.clear();
+    m_count = 0;
+}
+
+uint64_t TimerManager::getNextTimer() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_tickled = false;
+    if(m_count == 0) {
+        m_nextHint = ~0ull;
+        return ~0ull;
+    }
+
+    uint64_t best = ~0ull;
+    Level& lv0 = m_levels[0];
+    uint64_t mask0 = (1ull << lv0.bits) - 1;
+    for(auto& t : lv0.slots[m_curTick & mask0]) {
+        best = std::min(best, t->m_next);
+    }
+    if(best == ~0ull) {
+        uint64_t tick = nextEventTick();
+        if(tick != ~0ull) {
+            if(tick - m_curTick <= mask0 && !lv0.slots[tick & mask0].empty()) {
+                for(auto& t : lv0.slots[tick & mask0]) {
+                    best = std::min(best, t->m_next);
+                }
+            } else {
+                // 上层级联的时间点，醒来后再重新计算
+                best = tick * m_tick;
+            }
+        }
+    }
+    if(!m_heap.empty()) {
+        best = std::min(best, m_heap.front()->m_next);
+    }
+    m_nextHint = best;
+
+    uint64_t now = GetCurrentUS();
+    return best > now ? best - now : 0;
+}
+
+void TimerManager::listExpiredCb(std::vector<std::function<void()> >& cbs) {
+    uint64_t now_us = GetCurrentUS();
+    std::vector<Timer::ptr> expired;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    bool rollover = detectClockRollover(now_us);
+    if(m_count == 0) {
+        m_curTick = std::max(m_curTick, now_us / m_tick);
+        return;
+    }
+    if(rollover) {
+        LE0N_LOG_WARN(LE0N_LOG_ROOT()) << "TimerManager clock rollover detected, expire "
+            << m_count << " timers";
+        takeAll(expired);
+        m_curTick = now_us / m_tick;
+    } else {
+        advance(now_us, expired);
+    }
+
+    cbs.reserve(cbs.size() + expired.size());
+    for(auto& timer : expired) {
+        if(!timer->m_cb) {
+            continue;
+        }
+        cbs.push_back(timer->m_cb);
+        if(timer->m_recurring) {
+            timer->m_next = now_us + timer->m_us;
+            insert(timer);
+            ++m_count;
+        } else {
+            timer->m_cb = nullptr;
+        }
+    }
+}
+
+bool TimerManager::hasTimer() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_count != 0;
+}
+
+size_t TimerManager::getTimerCount() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_count;
+}
+
+bool TimerManager::detectClockRollover(uint64_t now_us) {
+    bool rollover = false;
+    if(now_us < m_previouseTime &&
+            now_us < (m_previouseTime - 60 * 60 * 1000 * 1000ull)) {
+        rollover = true;
+    }
+    m_previouseTime = now_us;
+    return rollover;
+}
+
+// ---------------- 远期最小堆(带下标回填，支持 O(log n) 删除) ----------------
+
+void TimerManager::heapPush(Timer::ptr val) {
+    val->m_level = LEVELS;
+    val->m_slot = m_heap.size();
+    m_heap.push_back(val);
+    heapUp(m_heap.size() - 1);
+}
+
+void TimerManager::heapErase(size_t idx) {
+    size_t last = m_heap.size() - 1;
+    if(idx != last) {
+        std::swap(m_heap[idx], m_heap[last]);
+        m_heap[idx]->m_slot = idx;
+    }
+    m_heap.pop_back();
+    if(idx < m_heap.size()) {
+        heapUp(idx);
+        heapDown(idx);
+    }
+}
+
+void TimerManager::heapUp(size_t idx) {
+    while(idx > 0) {
+        size_t parent = (idx - 1) / 2;
+        if(m_heap[parent]->m_next <= m_heap[idx]->m_next) {
+            break;
+        }
+        std::swap(m_heap[parent], m_heap[idx]);
+        m_heap[parent]->m_slot = parent;
+        m_heap[idx]->m_slot = idx;
+        idx = parent;
+    }
+}
+
+void TimerManager::heapDown(size_t idx) {
+    size_t size = m_heap.size();
+    while(true) {
+        size_t left = idx * 2 + 1;
+        if(left >= size) {
+            break;
+        }
+        size_t min = left;
+        if(left + 1 < size && m_heap[left + 1]->m_next < m_heap[left]->m_next) {
+            min = left + 1;
+        }
+        if(m_heap[idx]->m_next <= m_heap[min]->m_next) {
+            break;
+        }
+        std::swap(m_heap[idx], m_heap[min]);
+        m_heap[idx]->m_slot = idx;
+        m_heap[min]->m_slot = min;
+        idx = min;
+    }
+}
+
+}
@@ -0,0 +1,150 @@
+#ifndef __LE0N_TIMER_H__
+#define __LE0N_TIMER_H__
+
+#include <memory>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <functional>
+#include <stdint.h>
+
+namespace le0n{
+
+class TimerManager;
+
+/**
+ * @brief 定时器
+ * @details 只能通过 TimerManager::addTimer 创建，时间单位统一为微秒
+ */
+class Timer : public std::enable_shared_from_this<Timer>{
+friend class TimerManager;
+public:
+    typedef std::shared_ptr<Timer> ptr;
+
+    /**
+     * @brief 取消定时器
+     * @return 定时器还在管理器中返回 true
+     */
+    bool cancel();
+
+    /**
+     * @brief 以当前时间为起点，重新计算到期时间
+     */
+    bool refresh();
+
+    /**
+     * @brief 重置定时器周期
+     * @param[in] us 新的周期(微秒)
+     * @param[in] from_now 是否从当前时间开始计算
+     */
+    bool reset(uint64_t us, bool from_now);
+private:
+    Timer(uint64_t us, std::function<void()> cb,
+          bool recurring, TimerManager* manager);
+private:
+    bool m_recurring = false;           //是否循环定时器
+    uint64_t m_us = 0;                  //执行周期(微秒)
+    uint64_t m_next = 0;                //精确的到期时间(微秒)
+    std::function<void()> m_cb;         //回调
+    TimerManager* m_manager = nullptr;
+
+    // 定时器在管理器中的位置，用于 O(1) 取消
+    int m_level = -1;                   //-1: 不在管理器中, 0~3: 时间轮层号, 4: 远期堆
+    size_t m_slot = 0;                  //时间轮槽位 / 堆下标
+    std::list<Timer::ptr>::iterator m_it;
+};
+
+/**
+ * @brief 定时器管理器
+ * @details 底层是分层时间轮 + 远期最小堆:
+ *  - 第 0 层 256 个槽，每槽一个 tick；第 1~3 层各 64 个槽，每槽覆盖下一层一整圈
+ *  - 插入/取消 O(1)；超出第 3 层范围(默认 tick=1ms 时约 18 小时)的定时器放入最小堆，
+ *    临近时再迁入时间轮
+ *  - 槽内保存精确到期时间，tick 只决定分桶，到期判断按微秒进行
+ *  - 检测系统时间回拨：回拨超过 1 小时时视所有定时器为到期
+ */
+class TimerManager{
+friend class Timer;
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] tick_us 时间轮一个 tick 的长度(微秒)
+     */
+    TimerManager(uint64_t tick_us = 1000);
+    virtual ~TimerManager();
+
+    /**
+     * @brief 添加定时器
+     * @param[in] us 定时器执行间隔(微秒)
+     * @param[in] cb 定时器回调
+     * @param[in] recurring 是否循环
+     */
+    Timer::ptr addTimer(uint64_t us, std::function<void()> cb
+                        ,bool recurring = false);
+
+    /**
+     * @brief 添加条件定时器
+     * @param[in] weak_cond 条件，对象已经释放时回调不执行
+     */
+    Timer::ptr addConditionTimer(uint64_t us, std::function<void()> cb
+                        ,std::weak_ptr<void> weak_cond
+                        ,bool recurring = false);
+
+    /**
+     * @brief 到最近一个定时器执行的时间间隔(微秒)
+     * @details 没有定时器时返回 ~0ull。跨层的定时器返回其迁移时刻，属于保守估计
+     */
+    uint64_t getNextTimer();
+
+    /**
+     * @brief 获取需要执行的定时器的回调函数列表
+     */
+    void listExpiredCb(std::vector<std::function<void()> >& cbs);
+
+    bool hasTimer();
+
+    // 当前管理的定时器数量
+    size_t getTimerCount();
+protected:
+    /**
+     * @brief 有新的最早定时器插入时回调(用于唤醒等待中的调度线程)
+     */
+    virtual void onTimerInsertedAtFront() {}
+private:
+    void addTimer(Timer::ptr val, std::unique_lock<std::mutex>& lock);
+    void insert(Timer::ptr val);
+    void remove(Timer* val);
+    void cascade(int level, size_t slot);
+    void migrateHeap();
+    uint64_t nextEventTick() const;
+    void advance(uint64_t now, std::vector<Timer::ptr>& expired);
+    void takeAll(std::vector<Timer::ptr>& expired);
+    bool detectClockRollover(uint64_t now_us);
+
+    void heapPush(Timer::ptr val);
+    void heapErase(size_t idx);
+    void heapUp(size_t idx);
+    void heapDown(size_t idx);
+private:
+    static const int LEVELS = 4;
+    struct Level {
+        int shift;                              //该层槽位对应的 tick 位移
+        int bits;                               //该层槽位数的位数
+        std::vector<std::list<Timer::ptr> > slots;
+        std::vector<uint64_t> bitmap;           //非空槽位图，用于跳过空槽
+    };
+
+    std::mutex m_mutex;
+    uint64_t m_tick;                        //tick 长度(微秒)
+    uint64_t m_curTick;                     //当前 tick，之前的 tick 都已经处理完
+    Level m_levels[LEVELS];
+    std::vector<Timer::ptr> m_heap;         //远期定时器最小堆
+    size_t m_count = 0;
+    bool m_tickled = false;                 //是否已经触发过 onTimerInsertedAtFront
+    uint64_t m_nextHint = ~0ull;            //上次 getNextTimer 给出的唤醒时间点
+    uint64_t m_previouseTime = 0;           //上次执行时间
+};
+
+}
+
+#endif
@@ -0,0 +1,295 @@
+#include "trace.h"
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+
+namespace le0n{
+
+/**
+ * @brief 一个已经结束的 span
+ */
+struct TraceSpan {
+    const char* name;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    uint32_t fiber_id;
+};
+
+/**
+ * @brief 线程私有的 span 缓冲区(单生产者单消费者)
+ * @details 所属线程推进 tail，导出线程推进 head；线程退出后由导出线程取空并释放
+ */
+struct TraceBuffer {
+    TraceBuffer(uint32_t capacity)
+        :spans(capacity)
+        ,mask(capacity - 1)
+        ,tid(GetThreadId()) {
+        char buf[32] = {0};
+        if(pthread_getname_np(pthread_self(), buf, sizeof(buf)) == 0) {
+            thread_name = buf;
+        }
+    }
+
+    std::vector<TraceSpan> spans;
+    uint32_t mask;
+    pid_t tid;
+    std::string thread_name;
+    // 当前文件里是否已经写过线程名
+    bool named = false;
+    std::atomic<uint64_t> head{0};      //导出线程读到的位置
+    char pad0[56];
+    std::atomic<uint64_t> tail{0};      //所属线程写到的位置
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> exited{false};
+    char pad1[40];
+};
+
+/**
+ * @brief 线程退出时标记缓冲区，交给导出线程释放
+ */
+struct TraceBufferHolder {
+    ~TraceBufferHolder() {
+        if(buffer) {
+            buffer->exited.store(true, std::memory_order_release);
+        }
+    }
+    TraceBuffer* buffer = nullptr;
+};
+
+static thread_local TraceBufferHolder t_trace;
+
+struct TraceState {
+    std::mutex control;                 //串行化 Start/Stop
+    std::mutex mutex;                   //保护 buffers、文件和统计
+    std::vector<TraceBuffer*> buffers;
+    std::ofstream ofs;
+    bool first = true;                  //还没有写过任何事件
+    uint64_t exported = 0;
+    uint64_t dropped = 0;
+    std::atomic<uint32_t> capacity{16384};
+
+    std::thread thread;
+    std::mutex cond_mutex;
+    std::condition_variable cond;
+    bool stopping = false;
+    uint64_t interval = 1000;
+};
+
+// 进程退出时不析构，退出较晚的线程仍可使用
+static TraceState& GetTraceState() {
+    static TraceState* s_state = new TraceState;
+    return *s_state;
+}
+
+std::atomic<bool> Tracer::s_enabled(false);
+
+static TraceBuffer* NewTraceBuffer() {
+    TraceState& st = GetTraceState();
+    TraceBuffer* buffer = new TraceBuffer(st.capacity.load(std::memory_order_relaxed));
+    std::lock_guard<std::mutex> lock(st.mutex);
+    st.buffers.push_back(buffer);
+    return buffer;
+}
+
+void Tracer::Record(const char* name, uint64_t begin_ns, uint64_t end_ns) {
+    TraceBuffer* buffer = t_trace.buffer;
+    if(!buffer) {
+        buffer = t_trace.buffer = NewTraceBuffer();
+    }
+    uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+    if(tail - buffer->head.load(std::memory_order_acquire) > buffer->mask) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceSpan& span = buffer->spans[tail & buffer->mask];
+    span.name = name;
+    span.begin_ns = begin_ns;
+    span.end_ns = end_ns;
+    span.fiber_id = GetFiberId();
+    buffer->tail.store(tail + 1, std::memory_order_release);
+}
+
+// JSON 字符串转义
+static void AppendJsonString(std::string& out, const char* str) {
+    out.push_back('"');
+    for(const char* p = str; *p; ++p) {
+        unsigned char c = *p;
+        if(c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if(c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out.append(buf);
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+}
+
+// 纳秒转成微秒(trace-event 的时间单位)，保留 3 位小数
+static void AppendMicros(std::string& out, uint64_t ns) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%" PRIu64 ".%03u", ns / 1000, (unsigned)(ns % 1000));
+    out.append(buf);
+}
+
+static void AppendSeparator(TraceState& st, std::string& out) {
+    if(st.first) {
+        st.first = false;
+    } else {
+        out.append(",\n");
+    }
+}
+
+// 取空所有缓冲区写入文件，调用方持有 st.mutex
+static void DrainLocked(TraceState& st) {
+    std::string out;
+    std::string pid = std::to_string(getpid());
+    for(auto it = st.buffers.begin(); it != st.buffers.end();) {
+        TraceBuffer* b = *it;
+        // 先读 exited: 看到线程已退出时，它写的所有 span 都已可见
+        bool exited = b->exited.load(std::memory_order_acquire);
+        uint64_t head = b->head.load(std::memory_order_relaxed);
+        uint64_t tail = b->tail.load(std::memory_order_acquire);
+        std::string tid = std::to_string(b->tid);
+        if(head != tail && !b->named && !b->thread_name.empty()) {
+            AppendSeparator(st, out);
+            out.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":").append(pid)
+               .append(",\"tid\":").append(tid).append(",\"args\":{\"name\":");
+            AppendJsonString(out, b->thread_name.c_str());
+            out.append("}}");
+            b->named = true;
+        }
+        for(; head != tail; ++head) {
+            const TraceSpan& span = b->spans[head & b->mask];
+            AppendSeparator(st, out);
+            out.append("{\"name\":");
+            AppendJsonString(out, span.name);
+            out.append(",\"cat\":\"le0n\",\"ph\":\"X\",\"pid\":").append(pid)
+               .append(",\"tid\":").append(tid).append(",\"ts\":");
+            AppendMicros(out, span.begin_ns);
+            out.append(",\"dur\":");
+            AppendMicros(out, span.end_ns - span.begin_ns);
+            out.append(",\"args\":{\"fiber\":").append(std::to_string(span.fiber_id)).append("}}");
+            ++st.exported;
+        }
+        b->head.store(tail, std::memory_order_release);
+        st.dropped += b->dropped.exchange(0, std::memory_order_relaxed);
+        if(exited) {
+            delete b;
+            it = st.buffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if(!out.empty() && st.ofs) {
+        st.ofs.write(out.c_str(), out.size());
+        st.ofs.flush();
+    }
+}
+
+static void TraceFlushThread() {
+    TraceState& st = GetTraceState();
+    std::unique_lock<std::mutex> lock(st.cond_mutex);
+    while(!st.stopping) {
+        st.cond.wait_for(lock, std::chrono::milliseconds(st.interval));
+        if(st.stopping) {
+            break;
+        }
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> guard(st.mutex);
+            DrainLocked(st);
+        }
+        lock.lock();
+    }
+}
+
+bool Tracer::Start(const std::string& file, uint64_t flush_interval, uint32_t buffer_events) {
+    TraceState& st = GetTraceState();
+    std::lock_guard<std::mutex> control(st.control);
+    if(IsEnabled()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        st.ofs.open(file.c_str(), std::ios::out | std::ios::trunc);
+        if(!st.ofs) {
+            st.ofs.clear();
+            return false;
+        }
+        st.ofs << "[\n";
+        st.first = true;
+        st.exported = 0;
+        st.dropped = 0;
+        // 丢掉上次 Stop 之后才结束的 span
+        for(auto it = st.buffers.begin(); it != st.buffers.end();) {
+            TraceBuffer* b = *it;
+            bool exited = b->exited.load(std::memory_order_acquire);
+            b->head.store(b->tail.load(std::memory_order_acquire), std::memory_order_release);
+            b->dropped.store(0, std::memory_order_relaxed);
+            b->named = false;
+            if(exited) {
+                delete b;
+                it = st.buffers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    uint32_t capacity = 2;
+    while(capacity < buffer_events) {
+        capacity <<= 1;
+    }
+    st.capacity.store(capacity, std::memory_order_relaxed);
+    st.interval = flush_interval ? flush_interval : 1;
+    st.stopping = false;
+    st.thread = std::thread(TraceFlushThread);
+    s_enabled.store(true, std::memory_order_release);
+    return true;
+}
+
+void Tracer::Stop() {
+    TraceState& st = GetTraceState();
+    std::lock_guard<std::mutex> control(st.control);
+    if(!IsEnabled()) {
+        return;
+    }
+    s_enabled.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(st.cond_mutex);
+        st.stopping = true;
+    }
+    st.cond.notify_one();
+    st.thread.join();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    DrainLocked(st);
+    st.ofs << "\n]\n";
+    st.ofs.close();
+}
+
+uint64_t Tracer::GetDropped() {
+    TraceState& st = GetTraceState();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    uint64_t dropped = st.dropped;
+    for(auto b : st.buffers) {
+        dropped += b->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+uint64_t Tracer::GetExported() {
+    TraceState& st = GetTraceState();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    return st.exported;
+}
+
+}
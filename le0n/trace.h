@@ -0,0 +1,92 @@
+#ifndef __LE0N_TRACE_H__
+#define __LE0N_TRACE_H__
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+#include "util.h"
+
+/**
+ * @brief 记录当前作用域的耗时(一个 trace span)
+ * @param[in] name span 名称，必须是字符串常量(只保存指针，导出时才读取)
+ * @details 未调用 Tracer::Start() 时只有一次原子读；开启时构造和析构各读一次单调时钟，
+ *  析构时把 [开始, 结束] 写进线程私有的环形缓冲区，不加锁、不分配内存，
+ *  由后台线程定期取走并写成 Chrome trace-event JSON(chrome://tracing、ui.perfetto.dev 可直接打开)
+ */
+#define LE0N_TRACE_SCOPE(name) \
+    le0n::TraceScope LE0N_TRACE_CONCAT(__le0n_trace_scope_, __LINE__)(name)
+
+#define LE0N_TRACE_CONCAT_IMPL(a, b) a##b
+#define LE0N_TRACE_CONCAT(a, b) LE0N_TRACE_CONCAT_IMPL(a, b)
+
+namespace le0n{
+
+/**
+ * @brief trace 的全局开关和导出线程
+ * @details 每个线程第一次记录 span 时创建自己的缓冲区(单生产者单消费者环形队列)，
+ *  导出线程每隔 flush_interval 毫秒把所有线程的缓冲区取空，追加写入 JSON 数组格式的文件。
+ *  文件以 "[" 开头，Stop() 时补上 "]"，进程崩溃时缺少结尾的文件 Chrome/Perfetto 也能打开。
+ *  缓冲区满时丢弃 span 并计数，不阻塞业务线程。
+ */
+class Tracer{
+public:
+    /**
+     * @brief 开始记录
+     * @param[in] file 输出文件(清空重写)
+     * @param[in] flush_interval 导出间隔(毫秒)
+     * @param[in] buffer_events 每个线程缓冲区能容纳的 span 数(向上取 2 的幂)，
+     *  只对之后新建缓冲区的线程生效
+     * @return 打开文件失败或已经在记录时返回 false
+     */
+    static bool Start(const std::string& file, uint64_t flush_interval = 1000
+                      ,uint32_t buffer_events = 16384);
+
+    /**
+     * @brief 停止记录，导出所有缓冲区中的 span 并关闭文件
+     */
+    static void Stop();
+
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // 因缓冲区满丢弃的 span 数(本次 Start 以来)
+    static uint64_t GetDropped();
+    // 已导出的 span 数(本次 Start 以来)
+    static uint64_t GetExported();
+
+    /**
+     * @brief 记录一个已经结束的 span
+     * @param[in] name 字符串常量
+     * @param[in] begin_ns 开始时间(GetMonotonicNS)
+     * @param[in] end_ns 结束时间(GetMonotonicNS)
+     */
+    static void Record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+/**
+ * @brief LE0N_TRACE_SCOPE 使用的 RAII 对象
+ */
+class TraceScope{
+public:
+    explicit TraceScope(const char* name)
+        :m_name(name)
+        ,m_begin(Tracer::IsEnabled() ? GetMonotonicNS() : 0) {
+    }
+
+    ~TraceScope() {
+        if(m_begin) {
+            Tracer::Record(m_name, m_begin, GetMonotonicNS());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+private:
+    const char* m_name;
+    uint64_t m_begin;
+};
+
+}
+
+#endif
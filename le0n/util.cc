@@ -1,4 +1,9 @@
 #include "util.h"
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <string.h>
+#include <time.h>
 
 namespace le0n {
 
@@ -9,4 +14,45 @@ pid_t GetThreadId() {
 uint32_t GetFiberId() {
     return 0;// 先就这样假装有了
 }
-}
\ No newline at end of file
+
+uint64_t GetCurrentMS() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000ul + tv.tv_usec / 1000;
+}
+
+uint64_t GetCurrentUS() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000 * 1000ul + tv.tv_usec;
+}
+
+uint64_t GetMonotonicNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void FSUtil::ListAllFile(std::vector<std::string>& files
+                         ,const std::string& path
+                         ,const std::string& subfix) {
+    DIR* dir = opendir(path.c_str());
+    if(dir == nullptr) {
+        return;
+    }
+    struct dirent* dp = nullptr;
+    while((dp = readdir(dir)) != nullptr) {
+        std::string filename(dp->d_name);
+        if(filename.size() <= subfix.size()
+                || filename.compare(filename.size() - subfix.size(), subfix.size(), subfix) != 0) {
+            continue;
+        }
+        std::string full = path + "/" + filename;
+        struct stat st;
+        if(stat(full.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            files.push_back(full);
+        }
+    }
+    closedir(dir);
+}
+}
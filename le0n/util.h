@@ -7,13 +7,32 @@
 #include <sys/types.h>
 #include <sys/syscall.h>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 namespace le0n {
     
 pid_t GetThreadId();
 uint32_t GetFiberId();
+
+// 获取当前墙上时间（gettimeofday），可能因为校时而回拨
+uint64_t GetCurrentMS();
+uint64_t GetCurrentUS();
+
+// 单调时钟(CLOCK_MONOTONIC)纳秒数，不受校时影响，只用于计时和排序
+uint64_t GetMonotonicNS();
+
+class FSUtil {
+public:
+    /**
+     * @brief 列出目录下(不递归)所有以 subfix 结尾的普通文件，追加到 files
+     */
+    static void ListAllFile(std::vector<std::string>& files
+                            ,const std::string& path
+                            ,const std::string& subfix);
+};
 }
 
 
 
-#endif
\ No newline at end of file
+#endif
@@ -14,7 +14,7 @@
 // ==========================================
 class MyCustomAppender : public le0n::LogAppender {
 public:
-    virtual void log(std::shared_ptr<le0n::Logger> logger, le0n::LogLevel::Level level, le0n::LogEvent::ptr event) override {
+    virtual void log(le0n::Logger* logger, le0n::LogLevel::Level level, const le0n::LogEvent::ptr& event) override {
         // 证明：Logger 确实调用了我的 log 方法
         std::cout << "[MyCustomAppender] 收到日志！内容是: " << event->getContent() << std::endl;
     }
@@ -37,7 +37,7 @@ void test_phase_1_syntax() {
     std::cout << "--- 开始模拟宏展开 ---" << std::endl;
     {
         // 1. 创建 Event (数据)
-        le0n::LogEvent::ptr event(new le0n::LogEvent(logger, le0n::LogLevel::INFO, 
+        le0n::LogEvent::ptr event(new le0n::LogEvent(logger.get(), le0n::LogLevel::INFO, 
                                     __FILE__, __LINE__, 0, le0n::GetThreadId(), 
                                     le0n::GetFiberId(), time(0)));
         
@@ -45,7 +45,7 @@ void test_phase_1_syntax() {
         le0n::LogEventWrap wrap(event);
 
         // 3. 写入内容 (流式操作)
-        // wrap.getSS() 返回 stringstream，所以可以使用 <<
+        // wrap.getSS() 返回 LogStream，所以可以使用 <<
         wrap.getSS() << "这是手动展开宏生成的日志";
 
         // 4. 遇到右大括号 '}'，wrap 对象销毁
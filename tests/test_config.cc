@@ -1,6 +1,14 @@
 #include "le0n/config.h"
+#include "le0n/config_watcher.h"
 #include "le0n/log.h"
+#include <atomic>
+#include <cassert>
 #include <cstddef>
+#include <fstream>
+#include <thread>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <yaml-cpp/node/node.h>
 #include <yaml-cpp/yaml.h>
 
@@ -9,6 +17,20 @@ le0n::ConfigVar<int>::ptr g_int_value_config =
 le0n::ConfigVar<float>::ptr g_float_value_config = 
     le0n::Config::Lookup("system.value", (float)10.2f, "system value");
 
+le0n::ConfigVar<std::vector<int> >::ptr g_int_vec_value_config =
+    le0n::Config::Lookup("system.int_vec", std::vector<int>{1, 2}, "system int vec");
+le0n::ConfigVar<std::list<int> >::ptr g_int_list_value_config =
+    le0n::Config::Lookup("system.int_list", std::list<int>{1, 2}, "system int list");
+le0n::ConfigVar<std::set<int> >::ptr g_int_set_value_config =
+    le0n::Config::Lookup("system.int_set", std::set<int>{1, 2}, "system int set");
+le0n::ConfigVar<std::unordered_set<int> >::ptr g_int_uset_value_config =
+    le0n::Config::Lookup("system.int_uset", std::unordered_set<int>{1, 2}, "system int uset");
+le0n::ConfigVar<std::map<std::string, int> >::ptr g_str_int_map_value_config =
+    le0n::Config::Lookup("system.str_int_map", std::map<std::string, int>{{"k", 2}}, "system str int map");
+le0n::ConfigVar<std::unordered_map<std::string, std::vector<int> > >::ptr g_str_vec_umap_value_config =
+    le0n::Config::Lookup("system.str_vec_umap"
+            ,std::unordered_map<std::string, std::vector<int> >{{"k", {2}}}, "system str vec umap");
+
 void print_yaml(const YAML::Node& node, int level){
     // IsScalar: 判断是否为标量（最基础的值，如字符串、数字）
     if(node.IsScalar()){
@@ -38,8 +60,8 @@ void print_yaml(const YAML::Node& node, int level){
     }
 }
 
-void test_yaml(){
-    YAML::Node root = YAML::LoadFile("/home/le0n/workspace/le0n/bin/conf/log.yml");
+void test_yaml(const char* path){
+    YAML::Node root = YAML::LoadFile(path);
     
     print_yaml(root, 0);
 
@@ -47,11 +69,398 @@ void test_yaml(){
     //LE0N_LOG_INFO(LE0N_LOG_ROOT()) << root;
 }
 
+// 把 YAML 文本当作配置文件加载
+static void load_yaml_text(const char* text){
+    le0n::Config::LoadFromYaml(YAML::Load(text));
+}
+
+void test_config(){
+#define XX(g_var, name, prefix) \
+    { \
+        auto v = g_var->getSnapshot(); \
+        for(auto& i : *v){ \
+            LE0N_LOG_INFO(LE0N_LOG_ROOT()) << #prefix " " #name ": " << i; \
+        } \
+        LE0N_LOG_INFO(LE0N_LOG_ROOT()) << #prefix " " #name " yaml: " << g_var->toString(); \
+    }
+
+    XX(g_int_vec_value_config, int_vec, before);
+    XX(g_int_list_value_config, int_list, before);
+    XX(g_int_set_value_config, int_set, before);
+    XX(g_int_uset_value_config, int_uset, before);
+
+    load_yaml_text(
+        "system:\n"
+        "  port: 9900\n"
+        "  value: 15\n"
+        "  int_vec: [10, 30]\n"
+        "  int_list: [20, 40, 50]\n"
+        "  int_set: [30, 20, 60, 20]\n"
+        "  int_uset: [30, 20, 60, 20]\n"
+        "  str_int_map: {k: 30, k2: 20, k3: 10}\n"
+        "  str_vec_umap:\n"
+        "    x: [10, 20]\n"
+        "    y: [30]\n");
+
+    XX(g_int_vec_value_config, int_vec, after);
+    XX(g_int_list_value_config, int_list, after);
+    XX(g_int_set_value_config, int_set, after);
+    XX(g_int_uset_value_config, int_uset, after);
+#undef XX
+
+    assert(g_int_value_config->getValue() == 9900);
+    assert(g_int_vec_value_config->getValue() == std::vector<int>({10, 30}));
+    assert(g_int_list_value_config->getValue() == std::list<int>({20, 40, 50}));
+    assert(g_int_set_value_config->getValue() == std::set<int>({20, 30, 60}));
+    assert(g_int_uset_value_config->getValue().size() == 3);
+    assert(g_str_int_map_value_config->getValue().at("k2") == 20);
+    assert(g_str_vec_umap_value_config->getValue().at("x") == std::vector<int>({10, 20}));
+    LE0N_LOG_INFO(LE0N_LOG_ROOT()) << "str_vec_umap yaml: " << g_str_vec_umap_value_config->toString();
+
+    // 多级名字写在同一个 key 里
+    load_yaml_text("System.Port: 9901\n");
+    assert(g_int_value_config->getValue() == 9901);
+
+    // fromString 与 toString 互为逆操作
+    assert(g_int_vec_value_config->fromString("[1, 2, 3]"));
+    assert(g_int_vec_value_config->getValue().size() == 3);
+    assert(!g_int_value_config->fromString("[1, 2]"));
+}
+
+// 自定义类型：特化 LexicalCast 即可作为配置项
+class Person{
+public:
+    std::string m_name;
+    int m_age = 0;
+    bool m_sex = false;
+
+    std::string toString() const{
+        std::stringstream ss;
+        ss << "[Person name=" << m_name << " age=" << m_age << " sex=" << m_sex << "]";
+        return ss.str();
+    }
+
+    // 配置值变化检测需要 operator==
+    bool operator==(const Person& oth) const{
+        return m_name == oth.m_name
+            && m_age == oth.m_age
+            && m_sex == oth.m_sex;
+    }
+};
+
+namespace le0n{
+
+template<>
+class LexicalCast<YAML::Node, Person>{
+public:
+    Person operator()(const YAML::Node& node){
+        Person p;
+        p.m_name = node["name"].as<std::string>();
+        p.m_age = node["age"].as<int>();
+        p.m_sex = node["sex"].as<bool>();
+        return p;
+    }
+};
+
+template<>
+class LexicalCast<Person, YAML::Node>{
+public:
+    YAML::Node operator()(const Person& p){
+        YAML::Node node;
+        node["name"] = p.m_name;
+        node["age"] = p.m_age;
+        node["sex"] = p.m_sex;
+        return node;
+    }
+};
+
+}
+
+le0n::ConfigVar<Person>::ptr g_person =
+    le0n::Config::Lookup("class.person", Person(), "system person");
+le0n::ConfigVar<std::map<std::string, std::vector<Person> > >::ptr g_person_vec_map =
+    le0n::Config::Lookup("class.vec_map", std::map<std::string, std::vector<Person> >(), "system person");
+
+void test_class(){
+    int changed = 0;
+    g_person->addListener([&changed](const Person& old_value, const Person& new_value){
+        LE0N_LOG_INFO(LE0N_LOG_ROOT()) << "old_value=" << old_value.toString()
+            << " new_value=" << new_value.toString();
+        ++changed;
+    });
+    load_yaml_text(
+        "class:\n"
+        "  person: {name: le0n, age: 18, sex: true}\n"
+        "  vec_map:\n"
+        "    team:\n"
+        "      - {name: a, age: 20, sex: false}\n"
+        "      - {name: b, age: 21, sex: true}\n");
+    LE0N_LOG_INFO(LE0N_LOG_ROOT()) << g_person->getValue().toString() << " - " << g_person->toString();
+    assert(g_person->getValue().m_name == "le0n");
+    assert(g_person->getValue().m_sex);
+    assert(g_person_vec_map->getValue().at("team").size() == 2);
+    assert(g_person_vec_map->getValue().at("team")[1].m_age == 21);
+    LE0N_LOG_INFO(LE0N_LOG_ROOT()) << "vec_map yaml: " << g_person_vec_map->toString();
+
+    // 值没有变化时不会触发回调
+    load_yaml_text("class:\n  person: {name: le0n, age: 18, sex: true}\n");
+    assert(changed == 1);
+    g_person->clearListener();
+}
+
+// 一个线程不停重载配置，另一个线程读取：读到的快照必须是完整的某一版本
+void test_concurrent(){
+    auto var = le0n::Config::Lookup("test.concurrent", std::vector<int>(100, 0), "");
+    std::atomic<bool> stop(false);
+    std::thread writer([var, &stop](){
+        for(int i = 1; i <= 2000; ++i){
+            var->setValue(std::vector<int>(100, i));
+        }
+        stop = true;
+    });
+    uint64_t reads = 0;
+    while(!stop){
+        auto v = var->getSnapshot();
+        for(auto& i : *v){
+            assert(i == v->front());
+        }
+        ++reads;
+    }
+    writer.join();
+    assert(var->getValue().front() == 2000);
+    // getValue 直接返回当前快照的引用
+    assert(&var->getValue() == var->getSnapshot().get());
+    // 被替换的快照在保留期内仍然有效，保留期过后在下一次 setValue 时回收
+    std::weak_ptr<const std::vector<int> > old = var->getSnapshot();
+    const std::vector<int>& ref = var->getValue();
+    var->setValue(std::vector<int>(100, 2001));
+    assert(!old.expired() && ref.front() == 2000);
+    assert(var->getRetiredCount() == 2001);
+    le0n::ConfigVarBase::SetRetireMS(0);
+    var->setValue(std::vector<int>(100, 2002));
+    assert(old.expired() && var->getRetiredCount() == 0);
+    le0n::ConfigVarBase::SetRetireMS(5000);
+    assert(var->getSnapshot().use_count() == 2);
+    LE0N_LOG_INFO(LE0N_LOG_ROOT()) << "test_concurrent reads=" << reads;
+
+    // 一边注册新配置项(修改前缀树)，一边按前缀树加载和比较 YAML
+    const int N = 500;
+    std::string text = "test:\n  reg:\n";
+    for(int i = 0; i < N; ++i){
+        text += "    k" + std::to_string(i) + ": " + std::to_string(i + 1) + "\n";
+    }
+    YAML::Node root = YAML::Load(text);
+    stop = false;
+    std::thread registrar([&stop, N](){
+        for(int i = 0; i < N; ++i){
+            le0n::Config::Lookup("test.reg.k" + std::to_string(i), 0, "");
+        }
+        stop = true;
+    });
+    while(!stop){
+        le0n::Config::ChangeList changes;
+        le0n::Config::Diff(root, changes);
+        le0n::Config::LoadFromYaml(root);
+    }
+    registrar.join();
+    le0n::Config::LoadFromYaml(root);
+    assert(le0n::Config::Lookup<int>("test.reg.k" + std::to_string(N - 1))->getValue() == N);
+}
+
+static void write_file(const std::string& path, const std::string& content){
+    std::ofstream ofs(path);
+    ofs << content;
+}
+
+// 等待条件成立，最多等 2 秒
+static bool wait_for(std::function<bool()> cond){
+    for(int i = 0; i < 200 && !cond(); ++i){
+        usleep(10 * 1000);
+    }
+    return cond();
+}
+
+void test_watcher(){
+    char dir[] = "/tmp/le0n_conf_XXXXXX";
+    assert(mkdtemp(dir));
+    std::string file = std::string(dir) + "/system.yml";
+    write_file(file, "system:\n  port: 7000\n  value: 1.5\n");
+
+    le0n::ConfigWatcher::ptr watcher(new le0n::ConfigWatcher(dir, 50));
+    assert(watcher->start());
+    assert(g_int_value_config->getValue() == 7000);
+
+    std::atomic<int> port_changed(0), value_changed(0);
+    uint64_t port_id = g_int_value_config->addListener([&port_changed](const int& o, const int& n){
+        ++port_changed;
+    });
+    uint64_t value_id = g_float_value_config->addListener([&value_changed](const float& o, const float& n){
+        ++value_changed;
+    });
+
+    // 只修改 port，value 不变，只有 port 的监听者被触发
+    write_file(file, "system:\n  port: 7001\n  value: 1.5\n");
+    assert(wait_for([](){ return g_int_value_config->getValue() == 7001; }));
+    assert(port_changed == 1);
+    assert(value_changed == 0);
+
+    // 内容不变的重写不会触发任何回调
+    uint64_t count = watcher->getReloadCount();
+    write_file(file, "system:\n  port: 7001\n  value: 1.5\n");
+    assert(wait_for([&watcher, count](){ return watcher->getReloadCount() > count; }));
+    assert(port_changed == 1);
+    assert(value_changed == 0);
+
+    watcher->stop();
+    g_int_value_config->delListener(port_id);
+    g_float_value_config->delListener(value_id);
+    unlink(file.c_str());
+    rmdir(dir);
+}
+
+// Kubernetes ConfigMap 式的更新: system.yml -> ..data/system.yml，..data 指向带版本的目录，
+// 更新时新建版本目录和临时链接，再 rename 成 ..data
+void test_watcher_symlink(){
+    char dir[] = "/tmp/le0n_conf_XXXXXX";
+    assert(mkdtemp(dir));
+    std::string base = dir;
+    assert(mkdir((base + "/..v1").c_str(), 0755) == 0);
+    write_file(base + "/..v1/system.yml", "system:\n  port: 7100\n");
+    assert(symlink("..v1", (base + "/..data").c_str()) == 0);
+    assert(symlink("..data/system.yml", (base + "/system.yml").c_str()) == 0);
+
+    le0n::ConfigWatcher::ptr watcher(new le0n::ConfigWatcher(dir, 50));
+    assert(watcher->start());
+    assert(g_int_value_config->getValue() == 7100);
+
+    assert(mkdir((base + "/..v2").c_str(), 0755) == 0);
+    write_file(base + "/..v2/system.yml", "system:\n  port: 7101\n");
+    assert(symlink("..v2", (base + "/..data_tmp").c_str()) == 0);
+    assert(rename((base + "/..data_tmp").c_str(), (base + "/..data").c_str()) == 0);
+    assert(wait_for([](){ return g_int_value_config->getValue() == 7101; }));
+
+    // 新建指向配置的符号链接也会加载
+    write_file(base + "/..v2/extra.conf", "system:\n  port: 7102\n");
+    assert(symlink("..data/extra.conf", (base + "/z.yml").c_str()) == 0);
+    assert(wait_for([](){ return g_int_value_config->getValue() == 7102; }));
+
+    watcher->stop();
+    const char* files[] = {"/z.yml", "/system.yml", "/..data", "/..v1/system.yml", "/..v2/system.yml", "/..v2/extra.conf"};
+    for(auto& f : files){
+        unlink((base + f).c_str());
+    }
+    rmdir((base + "/..v1").c_str());
+    rmdir((base + "/..v2").c_str());
+    rmdir(dir);
+}
+
+// 自定义的 YAML::Node -> int 转换，值翻倍
+struct DoubleIntFromNode {
+    int operator()(const YAML::Node& node) { return node.as<int>() * 2; }
+};
+
+void test_handle(){
+    static_assert(le0n::ConfigHash("") == 14695981039346656037ull, "ConfigHash must be constexpr");
+    assert(le0n::ConfigHash("system.port") == le0n::ConfigHash(std::string("system.port")));
+
+    auto port = LE0N_CONFIG_HANDLE(int, "system.port");
+    assert(port);
+    assert(port.getVar() == g_int_value_config.get());
+    g_int_value_config->setValue(1234);
+    assert(*port == 1234);
+    // 直接引用当前快照，不拷贝
+    assert(&*port == &g_int_value_config->getValue());
+    auto vec = LE0N_CONFIG_HANDLE(std::vector<int>, "system.int_vec");
+    assert(vec->size() == g_int_vec_value_config->getValue().size());
+
+    // 类型不一致：注册时返回 nullptr，查找和句柄都拿不到
+    assert(!le0n::Config::Lookup("system.port", std::string("x"), ""));
+    assert(!le0n::Config::Lookup<float>("system.port"));
+    assert(!LE0N_CONFIG_HANDLE(float, "system.port"));
+    assert(!LE0N_CONFIG_HANDLE(int, "system.not_exists"));
+
+    // 类型一致的重复注册返回已有的配置项
+    assert(le0n::Config::Lookup("system.port", (int)1, "") == g_int_value_config);
+
+    // 转换仿函数是类型的一部分：自定义转换的配置项不会被当作默认转换的配置项返回
+    auto custom = le0n::Config::Lookup<int, DoubleIntFromNode>("test.custom", 0, "");
+    assert(custom);
+    load_yaml_text("test:\n  custom: 21\n");
+    assert(custom->getValue() == 42);
+    assert((le0n::Config::Lookup<int, DoubleIntFromNode>("test.custom") == custom));
+    assert(!le0n::Config::Lookup<int>("test.custom"));
+    assert(!le0n::Config::Lookup("test.custom", (int)1, ""));
+    assert(!LE0N_CONFIG_HANDLE(int, "test.custom"));
+}
+
+// 快照里的容器、自定义类型和直接从字节解析的标量，结果要与 YAML 加载一致
+void test_snapshot(){
+    char dir[] = "/tmp/le0n_snap_XXXXXX";
+    assert(mkdtemp(dir));
+    std::string yaml_file = std::string(dir) + "/app.yml";
+    std::string snap_file = std::string(dir) + "/app.snap";
+    write_file(yaml_file, "system:\n  port: 6000\n  value: 2.5\n  int_vec: [7, 8, 9]\n"
+            "  str_int_map: {a: 1, b: 2}\n"
+            "class:\n  person: {name: snap, age: 30, sex: true}\n"
+            "  vec_map:\n    x: [{name: p1, age: 1, sex: false}]\n");
+    assert(le0n::ConfigSnapshot::Compile(yaml_file, snap_file));
+    assert(le0n::Config::LoadFromSnapshot(snap_file, yaml_file));
+
+    assert(g_int_value_config->getValue() == 6000);
+    assert(g_float_value_config->getValue() == 2.5f);
+    assert(g_int_vec_value_config->getValue() == std::vector<int>({7, 8, 9}));
+    assert(g_str_int_map_value_config->getValue().at("b") == 2);
+    assert(g_person->getValue().m_name == "snap");
+    assert(g_person->getValue().m_age == 30);
+    assert(g_person_vec_map->getValue().at("x").at(0).m_name == "p1");
+
+    // 损坏的快照(越界的偏移、长度)在 Open 时被拒绝，回退到 YAML
+    std::string data;
+    {
+        std::ifstream ifs(snap_file, std::ios::binary);
+        data.assign((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    }
+    size_t pos = data.find("6000");
+    assert(pos != std::string::npos);
+    std::string bad = data;
+    memset(&bad[pos - sizeof(uint32_t)], 0xff, sizeof(uint32_t));
+    write_file(snap_file, bad);
+    assert(!le0n::ConfigSnapshot::Open(snap_file));
+    g_int_value_config->setValue(1);
+    assert(!le0n::Config::LoadFromSnapshot(snap_file, yaml_file));
+    assert(g_int_value_config->getValue() == 6000);
+
+    // 逐字节改写 Header 之后的内容：要么拒绝，要么每个节点都能在文件范围内解码
+    for(size_t i = sizeof(le0n::ConfigSnapshot::Header); i < data.size(); ++i){
+        bad = data;
+        bad[i] = (char)0xff;
+        write_file(snap_file, bad);
+        le0n::ConfigSnapshot::ptr snap = le0n::ConfigSnapshot::Open(snap_file);
+        for(uint32_t k = 0; snap && k < snap->getKeyCount(); ++k){
+            snap->getNode(snap->getEntry(k)).toYaml();
+        }
+    }
+
+    unlink(snap_file.c_str());
+    unlink(yaml_file.c_str());
+    rmdir(dir);
+}
+
 int main(int argc, char** argv){
     LE0N_LOG_INFO(LE0N_LOG_ROOT()) << g_int_value_config->getValue();
     LE0N_LOG_INFO(LE0N_LOG_ROOT()) << g_float_value_config->toString();
 
-    test_yaml();
+    test_config();
+    test_class();
+    test_concurrent();
+    test_watcher();
+    test_watcher_symlink();
+    test_snapshot();
+    test_handle();
+    if(argc > 1){
+        // 打印指定的 YAML 文件结构，例如 bin/test_config bin/conf/log.yml
+        test_yaml(argv[1]);
+    }
     
     return 0;
 }
\ No newline at end of file
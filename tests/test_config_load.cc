@@ -0,0 +1,193 @@
+#include "le0n/config.h"
+#include "le0n/log.h"
+#include "le0n/util.h"
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <list>
+#include <sstream>
+#include <unistd.h>
+
+/**
+ * 配置加载启动耗时测试：生成一个 10 万个 key 的 YAML，其中只有一小部分注册了配置项，
+ * 对比"先打平整棵树再逐个查表"的旧加载方式和沿前缀树遍历的新方式，
+ * 以及从预编译快照加载(包括快照过期回退 YAML 的情况)。
+ */
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+static const int SECTIONS = 1000;
+static const int KEYS = 100;
+static const int REGISTERED_SECTIONS = 10;
+
+static std::vector<le0n::ConfigVar<int>::ptr> g_vars;
+
+static std::string gen_yaml() {
+    std::stringstream ss;
+    for(int i = 0; i < SECTIONS; ++i) {
+        ss << "sec" << i << ":\n";
+        for(int j = 0; j < KEYS; ++j) {
+            ss << "  key" << j << ": " << i * KEYS + j << "\n";
+        }
+    }
+    return ss.str();
+}
+
+static void register_vars() {
+    for(int i = 0; i < REGISTERED_SECTIONS; ++i) {
+        for(int j = 0; j < KEYS; ++j) {
+            std::stringstream ss;
+            ss << "sec" << i * (SECTIONS / REGISTERED_SECTIONS) << ".key" << j;
+            g_vars.push_back(le0n::Config::Lookup(ss.str(), (int)-1, ""));
+        }
+    }
+}
+
+// 旧版 LoadFromYaml 的做法：递归打平成 (完整路径, 节点) 列表，再逐个转小写查表
+static void legacy_list_all(const std::string& prefix, const YAML::Node& node
+        ,std::list<std::pair<std::string, const YAML::Node> >& output) {
+    if(prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._1234567890")
+            != std::string::npos) {
+        return;
+    }
+    output.push_back(std::make_pair(prefix, node));
+    if(node.IsMap()) {
+        for(auto it = node.begin(); it != node.end(); ++it) {
+            legacy_list_all(prefix.empty() ? it->first.Scalar()
+                    : prefix + "." + it->first.Scalar(), it->second, output);
+        }
+    }
+}
+
+static void legacy_load(const YAML::Node& root) {
+    std::list<std::pair<std::string, const YAML::Node> > all_nodes;
+    legacy_list_all("", root, all_nodes);
+    for(auto& i : all_nodes) {
+        std::string key = i.first;
+        if(key.empty()) {
+            continue;
+        }
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        le0n::ConfigVarBase::ptr var = le0n::Config::LookupBase(key);
+        if(var) {
+            var->fromNode(i.second);
+        }
+    }
+}
+
+static void reset_vars() {
+    for(auto& i : g_vars) {
+        i->setValue(-1);
+    }
+}
+
+static void check_vars() {
+    for(auto& i : g_vars) {
+        assert(i->getValue() >= 0);
+    }
+}
+
+// 冷启动两种方式：解析 YAML 文件 vs 加载快照
+static void bench_snapshot(const std::string& text) {
+    char dir[] = "/tmp/le0n_snapshot_XXXXXX";
+    assert(mkdtemp(dir));
+    std::string yaml_file = std::string(dir) + "/app.yml";
+    std::string snap_file = std::string(dir) + "/app.snap";
+    {
+        std::ofstream ofs(yaml_file);
+        ofs << text;
+    }
+
+    uint64_t t0 = le0n::GetCurrentUS();
+    assert(le0n::ConfigSnapshot::Compile(yaml_file, snap_file));
+    uint64_t t1 = le0n::GetCurrentUS();
+
+    reset_vars();
+    uint64_t t2 = le0n::GetCurrentUS();
+    le0n::Config::LoadFromYaml(YAML::LoadFile(yaml_file));
+    uint64_t t3 = le0n::GetCurrentUS();
+    check_vars();
+
+    reset_vars();
+    uint64_t t4 = le0n::GetCurrentUS();
+    assert(le0n::Config::LoadFromSnapshot(snap_file, yaml_file));
+    uint64_t t5 = le0n::GetCurrentUS();
+    check_vars();
+    assert(g_vars[0]->getValue() == 0);
+    assert(g_vars.back()->getValue() == (SECTIONS - SECTIONS / REGISTERED_SECTIONS) * KEYS + KEYS - 1);
+
+    LE0N_LOG_INFO(g_logger) << "snapshot compile=" << (t1 - t0) / 1000.0 << "ms"
+        << " startup yaml=" << (t3 - t2) / 1000.0 << "ms"
+        << " startup snapshot=" << (t5 - t4) / 1000.0 << "ms";
+
+    // 修改 YAML 后快照过期，回退解析 YAML 并拿到新值
+    {
+        std::ofstream ofs(yaml_file);
+        ofs << "sec0:\n  key0: 4242\n";
+    }
+    assert(!le0n::Config::LoadFromSnapshot(snap_file, yaml_file));
+    assert(g_vars[0]->getValue() == 4242);
+
+    // 快照不存在同样回退
+    unlink(snap_file.c_str());
+    g_vars[0]->setValue(-1);
+    assert(!le0n::Config::LoadFromSnapshot(snap_file, yaml_file));
+    assert(g_vars[0]->getValue() == 4242);
+
+    // 重新编译后使用快照
+    assert(le0n::ConfigSnapshot::Compile(yaml_file, snap_file));
+    g_vars[0]->setValue(-1);
+    assert(le0n::Config::LoadFromSnapshot(snap_file, yaml_file));
+    assert(g_vars[0]->getValue() == 4242);
+
+    unlink(snap_file.c_str());
+    unlink(yaml_file.c_str());
+    rmdir(dir);
+}
+
+// 按名字查找(哈希表) vs 句柄读取
+static void bench_lookup() {
+    const int N = 1000 * 1000;
+    uint64_t sum = 0;
+    uint64_t t0 = le0n::GetCurrentUS();
+    for(int i = 0; i < N; ++i) {
+        sum += le0n::Config::Lookup<int>("sec0.key1")->getValue();
+    }
+    uint64_t t1 = le0n::GetCurrentUS();
+    auto handle = LE0N_CONFIG_HANDLE(int, "sec0.key1");
+    for(int i = 0; i < N; ++i) {
+        sum += *handle;
+    }
+    uint64_t t2 = le0n::GetCurrentUS();
+    assert(sum == 2ull * N * g_vars[1]->getValue());
+    LE0N_LOG_INFO(g_logger) << "lookup by name=" << (t1 - t0) * 1000.0 / N << "ns/op"
+        << " handle=" << (t2 - t1) * 1000.0 / N << "ns/op";
+}
+
+int main(int argc, char** argv) {
+    register_vars();
+    std::string text = gen_yaml();
+
+    uint64_t t0 = le0n::GetCurrentUS();
+    YAML::Node root = YAML::Load(text);
+    uint64_t t1 = le0n::GetCurrentUS();
+
+    legacy_load(root);
+    uint64_t t2 = le0n::GetCurrentUS();
+    check_vars();
+    reset_vars();
+
+    uint64_t t3 = le0n::GetCurrentUS();
+    le0n::Config::LoadFromYaml(root);
+    uint64_t t4 = le0n::GetCurrentUS();
+    check_vars();
+
+    LE0N_LOG_INFO(g_logger) << "keys=" << SECTIONS * KEYS << " registered=" << g_vars.size()
+        << " yaml_parse=" << (t1 - t0) / 1000.0 << "ms"
+        << " legacy_flatten_load=" << (t2 - t1) / 1000.0 << "ms"
+        << " trie_load=" << (t4 - t3) / 1000.0 << "ms";
+
+    bench_snapshot(text);
+    bench_lookup();
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "le0n/hook.h"
+#include "le0n/config.h"
+#include "le0n/log.h"
+#include <cassert>
+#include <thread>
+#include <fcntl.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+void test_hook() {
+    // 把阈值调低到 2ms，usleep(5ms) 会触发 WARN
+    le0n::Config::Lookup<int>("hook.slow_threshold_us")->setValue(2 * 1000);
+
+    usleep(1000);
+    assert(le0n::GetHookStat(le0n::HOOK_USLEEP).count == 0);
+
+    le0n::set_hook_enable(true);
+    usleep(5 * 1000);
+    usleep(100);
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    char buf[64];
+    for(int i = 0; i < 100; ++i) {
+        assert(write(fds[1], "hello", 5) == 5);
+        assert(read(fds[0], buf, sizeof(buf)) == 5);
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    // errno 不被统计代码改写
+    errno = 0;
+    assert(read(-1, buf, sizeof(buf)) == -1);
+    assert(errno == EBADF);
+    le0n::set_hook_enable(false);
+
+    le0n::HookStat usleep_stat = le0n::GetHookStat(le0n::HOOK_USLEEP);
+    assert(usleep_stat.count == 2);
+    assert(usleep_stat.slow == 1);
+    assert(le0n::GetHookStat(le0n::HOOK_WRITE).count == 100);
+    assert(le0n::GetHookStat(le0n::HOOK_READ).count == 101);
+
+    LE0N_LOG_INFO(g_logger) << "hook stats:" << std::endl << le0n::DumpHookStats();
+}
+
+// 线程退出后统计并入汇总，统计对象被释放
+void test_hook_threads() {
+    size_t threads = le0n::GetHookThreadCount();
+    uint64_t writes = le0n::GetHookStat(le0n::HOOK_WRITE).count;
+    int fd = open("/dev/null", O_WRONLY);
+    le0n::set_hook_enable(true);
+    for(int i = 0; i < 50; ++i) {
+        std::thread th([fd](){
+            for(int j = 0; j < 10; ++j) {
+                assert(write(fd, "x", 1) == 1);
+            }
+        });
+        th.join();
+    }
+    le0n::set_hook_enable(false);
+    close(fd);
+    assert(le0n::GetHookThreadCount() == threads);
+    assert(le0n::GetHookStat(le0n::HOOK_WRITE).count == writes + 500);
+    LE0N_LOG_INFO(g_logger) << "test_hook_threads ok";
+}
+
+void bench_hook() {
+    int fd = open("/dev/null", O_WRONLY);
+    const int N = 1000 * 1000;
+    uint64_t t0 = le0n::GetCurrentUS();
+    for(int i = 0; i < N; ++i) {
+        write(fd, "x", 1);
+    }
+    uint64_t t1 = le0n::GetCurrentUS();
+    le0n::set_hook_enable(true);
+    for(int i = 0; i < N; ++i) {
+        write(fd, "x", 1);
+    }
+    le0n::set_hook_enable(false);
+    uint64_t t2 = le0n::GetCurrentUS();
+    close(fd);
+    LE0N_LOG_INFO(g_logger) << "bench_hook write(/dev/null) off="
+        << (t1 - t0) * 1000.0 / N << "ns/op on=" << (t2 - t1) * 1000.0 / N << "ns/op";
+}
+
+int main(int argc, char** argv) {
+    test_hook();
+    test_hook_threads();
+    bench_hook();
+    return 0;
+}
@@ -0,0 +1,1190 @@
+#include "le0n/log.h"
+#include "le0n/config.h"
+#include "le0n/log_async.h"
+#include "le0n/log_budget.h"
+#include "le0n/util.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <string.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+// 什么都不输出的 Appender，压测只统计分发路径本身的开销
+class NullLogAppender : public le0n::LogAppender {
+public:
+    typedef std::shared_ptr<NullLogAppender> ptr;
+    void log(le0n::Logger* logger, le0n::LogLevel::Level level, const le0n::LogEvent::ptr& event) override {
+        assert(logger == event->getLogger());
+    }
+};
+
+// 只实现 log() 的 Appender，使用默认的 logBatch
+class CountLogAppender : public le0n::LogAppender {
+public:
+    void log(le0n::Logger* logger, le0n::LogLevel::Level level, const le0n::LogEvent::ptr& event) override {
+        if(level >= m_level) {
+            ++count;
+        }
+    }
+    int count = 0;
+};
+
+static le0n::LogEvent::ptr make_event(le0n::Logger::ptr logger, le0n::LogLevel::Level level, int i) {
+    le0n::LogEvent::ptr event(new le0n::LogEvent(logger.get(), level, __FILE__, __LINE__, 0
+                , le0n::GetThreadId(), le0n::GetFiberId(), time(0)));
+    event->getSS() << "batch " << i;
+    return event;
+}
+
+static int count_lines(const std::string& file) {
+    std::ifstream ifs(file);
+    std::string line;
+    int n = 0;
+    while(std::getline(ifs, line)) {
+        ++n;
+    }
+    return n;
+}
+
+void test_batch() {
+    char file[] = "/tmp/le0n_batch_XXXXXX";
+    int fd = mkstemp(file);
+    assert(fd >= 0);
+    close(fd);
+
+    le0n::Logger::ptr logger(new le0n::Logger("batch"));
+    logger->setLevel(le0n::LogLevel::INFO);
+    le0n::FileLogAppender::ptr file_appender(new le0n::FileLogAppender(file));
+    file_appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%p %m%n")));
+    file_appender->setLevel(le0n::LogLevel::WARN);
+    std::shared_ptr<CountLogAppender> count_appender(new CountLogAppender);
+    logger->addAppender(file_appender);
+    logger->addAppender(count_appender);
+
+    // DEBUG 被日志器过滤，INFO 被文件 Appender 过滤
+    std::vector<le0n::LogEvent::ptr> events;
+    for(int i = 0; i < 100; ++i) {
+        events.push_back(make_event(logger, (le0n::LogLevel::Level)(i % 4 + 1), i));
+    }
+    logger->logBatch(events.data(), events.size());
+    assert(count_appender->count == 75);
+    assert(count_lines(file) == 50);
+
+    // 逐条输出和批量输出写入同一个文件
+    LE0N_LOG_ERROR(logger) << "single";
+    assert(count_lines(file) == 51);
+    unlink(file);
+}
+
+// 同样的日志逐条写文件 vs 按批写文件
+static void bench_batch() {
+    char file[] = "/tmp/le0n_batch_XXXXXX";
+    int fd = mkstemp(file);
+    assert(fd >= 0);
+    close(fd);
+
+    le0n::Logger::ptr logger(new le0n::Logger("batch"));
+    le0n::FileLogAppender::ptr appender(new le0n::FileLogAppender(file));
+    logger->addAppender(appender);
+
+    const int N = 100 * 1000;
+    const int BATCH = 64;
+    std::vector<le0n::LogEvent::ptr> events;
+    for(int i = 0; i < N; ++i) {
+        events.push_back(make_event(logger, le0n::LogLevel::INFO, i));
+    }
+
+    uint64_t t0 = le0n::GetCurrentUS();
+    for(auto& e : events) {
+        logger->log(e->getLevel(), e);
+    }
+    uint64_t t1 = le0n::GetCurrentUS();
+    for(int i = 0; i < N; i += BATCH) {
+        logger->logBatch(&events[i], std::min(BATCH, N - i));
+    }
+    uint64_t t2 = le0n::GetCurrentUS();
+    assert(count_lines(file) == 2 * N);
+
+    LE0N_LOG_INFO(g_logger) << "bench_batch file single=" << (t1 - t0) * 1000.0 / N << "ns/log"
+        << " batch" << BATCH << "=" << (t2 - t1) * 1000.0 / N << "ns/log";
+    unlink(file);
+}
+
+// 记录收到的序号，检查异步输出是否全局有序
+class SeqLogAppender : public le0n::LogAppender {
+public:
+    void log(le0n::Logger* logger, le0n::LogLevel::Level level, const le0n::LogEvent::ptr& event) override {
+        seqs.push_back(std::stoi(event->getContent()));
+    }
+    std::vector<int> seqs;
+};
+
+void test_async_order() {
+    le0n::Logger::ptr logger(new le0n::Logger("async"));
+    std::shared_ptr<SeqLogAppender> seq_appender(new SeqLogAppender);
+    // 队列很小，覆盖队列满时等待的路径
+    le0n::AsyncLogAppender::ptr async(new le0n::AsyncLogAppender(seq_appender, 16));
+    logger->addAppender(async);
+
+    // 加锁保证"取序号 + 入队"的先后就是真实的先后，但每个线程仍然写自己的队列，
+    // 合并线程必须把各个队列交错归并回序号顺序
+    const int THREADS = 8;
+    const int N = 5000;
+    std::mutex mutex;
+    int seq = 0;
+    std::vector<std::thread> ths;
+    for(int t = 0; t < THREADS; ++t) {
+        ths.push_back(std::thread([&](){
+            for(int i = 0; i < N; ++i) {
+                std::lock_guard<std::mutex> lock(mutex);
+                LE0N_LOG_INFO(logger) << seq++;
+            }
+        }));
+    }
+    for(auto& th : ths) {
+        th.join();
+    }
+    async->flush();
+    assert(seq_appender->seqs.size() == (size_t)THREADS * N);
+    for(size_t i = 0; i < seq_appender->seqs.size(); ++i) {
+        assert(seq_appender->seqs[i] == (int)i);
+    }
+
+    // 停止后退化为同步输出
+    async->stop();
+    LE0N_LOG_INFO(logger) << seq;
+    assert(seq_appender->seqs.back() == seq);
+}
+
+// 检查目标 Appender 不会被并发调用
+class ExclusiveLogAppender : public le0n::LogAppender {
+public:
+    void log(le0n::Logger* logger, le0n::LogLevel::Level level, const le0n::LogEvent::ptr& event) override {
+        assert(!busy.exchange(true));
+        ++count;
+        busy = false;
+    }
+    std::atomic<bool> busy{false};
+    uint64_t count = 0;
+};
+
+// 生产者不停写日志时 stop: 停止前后的日志都输出且不丢，目标 Appender 不被并发调用；
+// 短命线程的队列在线程退出后被释放
+void test_async_stop() {
+    le0n::Logger::ptr logger(new le0n::Logger("async_stop"));
+    le0n::LogMemoryBudget::SetLimit(64 * 1024);
+    for(int round = 0; round < 20; ++round) {
+        std::shared_ptr<ExclusiveLogAppender> target(new ExclusiveLogAppender);
+        le0n::AsyncLogAppender::ptr async(new le0n::AsyncLogAppender(target, 16));
+        logger->addAppender(async);
+        const int THREADS = 4;
+        std::atomic<uint64_t> produced(0);
+        std::atomic<bool> quit(false);
+        std::vector<std::thread> ths;
+        for(int t = 0; t < THREADS; ++t) {
+            ths.push_back(std::thread([&](){
+                while(!quit) {
+                    LE0N_LOG_WARN(logger) << "stop " << produced++;
+                }
+            }));
+        }
+        usleep(2000);
+        async->stop();
+        usleep(1000);
+        quit = true;
+        for(auto& th : ths) {
+            th.join();
+        }
+        assert(target->count == produced);
+        assert(async->getQueueDepth() == 0);
+        logger->clearAppenders();
+    }
+    le0n::LogMemoryBudget::SetLimit(0);
+    assert(le0n::LogMemoryBudget::GetUsed() == 0);
+
+    std::shared_ptr<CountLogAppender> target(new CountLogAppender);
+    le0n::AsyncLogAppender::ptr async(new le0n::AsyncLogAppender(target));
+    logger->addAppender(async);
+    for(int i = 0; i < 200; ++i) {
+        std::thread([&logger, i](){
+            LE0N_LOG_INFO(logger) << "short lived " << i;
+        }).join();
+    }
+    async->flush();
+    assert(target->count == 200);
+    uint64_t start = le0n::GetMonotonicNS();
+    while(async->getQueueCount() != 0) {
+        assert(le0n::GetMonotonicNS() - start < 1000ull * 1000 * 1000);
+        usleep(1000);
+    }
+    assert(async->getQueueDepth() == 0);
+    logger->clearAppenders();
+    LE0N_LOG_INFO(g_logger) << "test_async_stop ok";
+}
+
+// 1~64 个生产者线程写同一个文件：同步 Logger::log vs 分片队列 + 归并线程
+static void bench_async() {
+    char file[] = "/tmp/le0n_async_XXXXXX";
+    int fd = mkstemp(file);
+    assert(fd >= 0);
+    close(fd);
+
+    const int N = 64 * 1000;
+    std::vector<std::string> results;
+    for(int threads = 1; threads <= 64; threads *= 2) {
+        for(int async = 0; async < 2; ++async) {
+            le0n::Logger::ptr logger(new le0n::Logger("bench"));
+            le0n::FileLogAppender::ptr appender(new le0n::FileLogAppender(file));
+            le0n::AsyncLogAppender::ptr async_appender;
+            if(async) {
+                async_appender.reset(new le0n::AsyncLogAppender(appender));
+                logger->addAppender(async_appender);
+            } else {
+                logger->addAppender(appender);
+            }
+
+            std::vector<std::thread> ths;
+            uint64_t begin = le0n::GetCurrentUS();
+            for(int t = 0; t < threads; ++t) {
+                ths.push_back(std::thread([&logger, threads, N](){
+                    for(int i = 0; i < N / threads; ++i) {
+                        LE0N_LOG_INFO(logger) << "bench async " << i;
+                    }
+                }));
+            }
+            for(auto& th : ths) {
+                th.join();
+            }
+            uint64_t produced = le0n::GetCurrentUS();
+            if(async_appender) {
+                async_appender->stop();
+            }
+            appender->flush();
+            uint64_t done = le0n::GetCurrentUS();
+            assert(count_lines(file) == N / threads * threads);
+
+            std::stringstream ss;
+            ss << "threads=" << threads << (async ? " async" : " sync ")
+               << " producer=" << (uint64_t)N * 1000000 / (produced - begin) << " logs/s"
+               << " end_to_end=" << (uint64_t)N * 1000000 / (done - begin) << " logs/s";
+            results.push_back(ss.str());
+        }
+    }
+    for(auto& i : results) {
+        LE0N_LOG_INFO(g_logger) << "bench_async " << i;
+    }
+    unlink(file);
+}
+
+/**
+ * 多线程通过 root 日志器分发日志：每条日志都会经过 LE0N_LOG_ROOT()、Logger::log
+ * 和 Appender 接口，共享的引用计数会在核之间来回传递缓存行
+ */
+static void bench_root_dispatch() {
+    le0n::Logger::ptr root = LE0N_LOG_ROOT();
+    root->clearAppenders();
+    root->addAppender(le0n::LogAppender::ptr(new NullLogAppender));
+
+    const int N = 200 * 1000;
+    std::vector<std::string> results;
+    for(int threads = 1; threads <= 8; threads *= 2) {
+        std::vector<std::thread> ths;
+        uint64_t begin = le0n::GetCurrentUS();
+        for(int t = 0; t < threads; ++t) {
+            ths.push_back(std::thread([N](){
+                for(int i = 0; i < N; ++i) {
+                    LE0N_LOG_INFO(LE0N_LOG_ROOT()) << i;
+                }
+            }));
+        }
+        for(auto& th : ths) {
+            th.join();
+        }
+        uint64_t used = le0n::GetCurrentUS() - begin;
+        std::stringstream ss;
+        ss << "threads=" << threads << " " << (uint64_t)N * threads * 1000000 / used << " logs/s";
+        results.push_back(ss.str());
+    }
+
+    root->clearAppenders();
+    root->addAppender(le0n::LogAppender::ptr(new le0n::StdoutLogAppender));
+    for(auto& i : results) {
+        LE0N_LOG_INFO(g_logger) << "bench_root_dispatch " << i;
+    }
+}
+
+// 旧的控制台输出方式: 经过 std::cout
+class CoutLogAppender : public le0n::LogAppender {
+public:
+    void log(le0n::Logger* logger, le0n::LogLevel::Level level, const le0n::LogEvent::ptr& event) override {
+        if(level >= m_level) {
+            std::cout << m_formatter->format(logger, level, event);
+        }
+    }
+};
+
+/**
+ * @brief 把标准输出重定向到管道，后台线程读出全部内容(模拟容器日志收集)
+ */
+class StdoutCapture {
+public:
+    StdoutCapture() {
+        // 之前缓冲的控制台日志写到原来的标准输出，不会被定时写出到管道里
+        std::cout.flush();
+        le0n::StdoutLogAppender::Flush();
+        int fds[2];
+        assert(pipe(fds) == 0);
+        m_saved = dup(STDOUT_FILENO);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        m_read = fds[0];
+        m_thread = std::thread([this](){
+            char buf[65536];
+            ssize_t n;
+            while((n = read(m_read, buf, sizeof(buf))) > 0) {
+                data.append(buf, n);
+            }
+        });
+    }
+    // 恢复标准输出，等待读完
+    void finish() {
+        std::cout.flush();
+        le0n::StdoutLogAppender::Flush();
+        dup2(m_saved, STDOUT_FILENO);
+        close(m_saved);
+        m_thread.join();
+        close(m_read);
+    }
+    std::string data;
+private:
+    int m_saved;
+    int m_read;
+    std::thread m_thread;
+};
+
+// 多线程写管道: 每条日志完整、不交错，颜色只包住一条日志
+void test_stdout_pipe() {
+    StdoutCapture capture;
+    le0n::Logger::ptr logger(new le0n::Logger("stdout"));
+    le0n::StdoutLogAppender::ptr appender(new le0n::StdoutLogAppender(le0n::StdoutLogAppender::ALWAYS));
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%p %m%n")));
+    logger->addAppender(appender);
+    bool is_pipe = appender->isPipe();
+    bool is_tty = appender->isTty();
+
+    const int THREADS = 4;
+    const int N = 2000;
+    std::vector<std::thread> ths;
+    for(int t = 0; t < THREADS; ++t) {
+        ths.push_back(std::thread([logger, t](){
+            std::vector<le0n::LogEvent::ptr> events;
+            for(int i = 0; i < N; ++i) {
+                le0n::LogEvent::ptr event(new le0n::LogEvent(logger.get(), le0n::LogLevel::WARN
+                            , __FILE__, __LINE__, 0, le0n::GetThreadId(), le0n::GetFiberId(), time(0)));
+                event->getSS() << "t" << t << " " << i << " " << std::string(i % 500, 'x');
+                if(i % 2) {
+                    // 一半逐条，一半成批
+                    logger->log(le0n::LogLevel::WARN, event);
+                } else {
+                    events.push_back(event);
+                    if(events.size() == 16) {
+                        logger->logBatch(events.data(), events.size());
+                        events.clear();
+                    }
+                }
+            }
+            logger->logBatch(events.data(), events.size());
+        }));
+    }
+    for(auto& th : ths) {
+        th.join();
+    }
+    logger->clearAppenders();
+    capture.finish();
+
+    assert(is_pipe && !is_tty);
+    std::istringstream iss(capture.data);
+    std::string line;
+    std::vector<std::vector<int> > seen(THREADS);
+    const std::string color = "\x1b[33m";
+    const std::string reset = "\x1b[0m";
+    while(std::getline(iss, line)) {
+        assert(line.compare(0, color.size(), color) == 0);
+        assert(line.size() >= reset.size() && line.compare(line.size() - reset.size(), reset.size(), reset) == 0);
+        line = line.substr(color.size(), line.size() - color.size() - reset.size());
+        int t = -1, i = -1;
+        assert(sscanf(line.c_str(), "WARN t%d %d", &t, &i) == 2);
+        std::string expect = "WARN t" + std::to_string(t) + " " + std::to_string(i) + " " + std::string(i % 500, 'x');
+        assert(line == expect);
+        seen[t].push_back(i);
+    }
+    for(auto& i : seen) {
+        assert(i.size() == (size_t)N);
+    }
+}
+
+// 线程打完一条 INFO 后不再打日志(也不退出)，缓冲的日志仍在 100ms 左右内写到管道
+void test_stdout_idle_flush() {
+    std::cout.flush();
+    le0n::StdoutLogAppender::Flush();
+    int fds[2];
+    assert(pipe(fds) == 0);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[1]);
+
+    le0n::Logger::ptr logger(new le0n::Logger("stdout"));
+    le0n::StdoutLogAppender::ptr appender(new le0n::StdoutLogAppender(le0n::StdoutLogAppender::NEVER));
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+    assert(appender->isPipe());
+
+    std::atomic<bool> quit(false);
+    uint64_t start = le0n::GetMonotonicNS();
+    std::thread idle([&](){
+        LE0N_LOG_INFO(logger) << "idle line";
+        while(!quit) {
+            usleep(1000);
+        }
+    });
+    std::string got;
+    while(got.find('\n') == std::string::npos) {
+        struct pollfd pfd = {fds[0], POLLIN, 0};
+        assert(poll(&pfd, 1, 1000) == 1);
+        char buf[256];
+        ssize_t n = read(fds[0], buf, sizeof(buf));
+        assert(n > 0);
+        got.append(buf, n);
+    }
+    uint64_t delay_ms = (le0n::GetMonotonicNS() - start) / 1000 / 1000;
+    quit = true;
+    idle.join();
+    logger->clearAppenders();
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(fds[0]);
+
+    assert(got == "idle line\n");
+    assert(delay_ms < 200);
+    LE0N_LOG_INFO(g_logger) << "test_stdout_idle_flush ok: " << delay_ms << "ms";
+}
+
+// 其他线程不停写控制台时 fork: 子进程不继承被持有的锁和其他线程的缓冲，每条日志只输出一次
+void test_stdout_fork() {
+    StdoutCapture capture;
+    le0n::Logger::ptr logger(new le0n::Logger("stdout"));
+    le0n::StdoutLogAppender::ptr appender(new le0n::StdoutLogAppender(le0n::StdoutLogAppender::NEVER));
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+
+    std::atomic<bool> quit(false);
+    std::atomic<int> produced(0);
+    std::thread writer([&](){
+        while(!quit) {
+            LE0N_LOG_INFO(logger) << "bg " << produced++;
+        }
+    });
+    const int FORKS = 100;
+    for(int i = 0; i < FORKS; ++i) {
+        pid_t child = fork();
+        assert(child >= 0);
+        if(child == 0) {
+            LE0N_LOG_INFO(logger) << "child " << i;
+            le0n::StdoutLogAppender::Flush();
+            _exit(0);
+        }
+        int status = 0;
+        uint64_t begin = le0n::GetMonotonicNS();
+        while(waitpid(child, &status, WNOHANG) == 0) {
+            if(le0n::GetMonotonicNS() - begin > 5000ull * 1000 * 1000) {
+                kill(child, SIGKILL);
+                assert(!"child deadlocked after fork");
+            }
+            usleep(1000);
+        }
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    quit = true;
+    writer.join();
+    logger->clearAppenders();
+    capture.finish();
+
+    std::istringstream iss(capture.data);
+    std::string line;
+    std::set<std::string> lines;
+    size_t count = 0;
+    while(std::getline(iss, line)) {
+        assert(lines.insert(line).second);
+        ++count;
+    }
+    assert(count == (size_t)produced + FORKS);
+    LE0N_LOG_INFO(g_logger) << "test_stdout_fork ok: " << count << " lines";
+}
+
+// 写管道: std::cout vs 线程私有缓冲区 + write(1)
+static void bench_stdout() {
+    const int N = 100 * 1000;
+    std::vector<std::string> results;
+    for(int threads = 1; threads <= 4; threads *= 4) {
+        for(int fast = 0; fast < 2; ++fast) {
+            StdoutCapture capture;
+            le0n::Logger::ptr logger(new le0n::Logger("bench"));
+            le0n::LogAppender::ptr appender;
+            if(fast) {
+                appender.reset(new le0n::StdoutLogAppender);
+            } else {
+                appender.reset(new CoutLogAppender);
+            }
+            appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter(
+                            "%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n")));
+            logger->addAppender(appender);
+
+            std::vector<std::thread> ths;
+            uint64_t begin = le0n::GetCurrentUS();
+            for(int t = 0; t < threads; ++t) {
+                ths.push_back(std::thread([logger, threads, N](){
+                    for(int i = 0; i < N / threads; ++i) {
+                        LE0N_LOG_INFO(logger) << "bench stdout " << i;
+                    }
+                }));
+            }
+            for(auto& th : ths) {
+                th.join();
+            }
+            std::cout.flush();
+            uint64_t used = le0n::GetCurrentUS() - begin;
+            capture.finish();
+            // 缓冲的日志在线程退出时已经写出
+            assert(std::count(capture.data.begin(), capture.data.end(), '\n') == N / threads * threads);
+
+            std::stringstream ss;
+            ss << "threads=" << threads << (fast ? " write(1)" : " cout    ")
+               << " " << (uint64_t)N * 1000000 / used << " logs/s";
+            results.push_back(ss.str());
+        }
+    }
+    for(auto& i : results) {
+        LE0N_LOG_INFO(g_logger) << "bench_stdout " << i;
+    }
+}
+
+struct Point {
+    int x;
+    int y;
+};
+
+std::ostream& operator<<(std::ostream& os, const Point& p) {
+    return os << "(" << p.x << "," << p.y << ")";
+}
+
+enum TestEnum {
+    TEST_ENUM_A = 7
+};
+
+// LogStream 和 stringstream 的输出对比
+template<class T>
+static void check_same(const T& v) {
+    le0n::LogStream ls;
+    std::stringstream ss;
+    ls << v;
+    ss << v;
+    if(ls.str() != ss.str()) {
+        std::cerr << "LogStream=" << ls.str() << " stringstream=" << ss.str() << std::endl;
+    }
+    assert(ls.str() == ss.str());
+}
+
+// 最短还原形式: 读回来等于原值，并且位数不超过 17
+static void check_double(double v) {
+    le0n::LogStream ls;
+    ls << v;
+    assert(strtod(ls.str().c_str(), nullptr) == v);
+}
+
+void test_log_stream() {
+    check_same(0);
+    check_same(-1);
+    check_same(7);
+    check_same(42);
+    check_same(100);
+    check_same(12345);
+    check_same(-987654321);
+    check_same(std::numeric_limits<int>::min());
+    check_same(std::numeric_limits<int>::max());
+    check_same(std::numeric_limits<long long>::min());
+    check_same(std::numeric_limits<long long>::max());
+    check_same(std::numeric_limits<unsigned long long>::max());
+    check_same((short)-5);
+    check_same((unsigned short)65535);
+    check_same(3000000000u);
+    check_same('c');
+    check_same(true);
+    check_same(false);
+    check_same("literal");
+    check_same(std::string("string"));
+    check_same((const void*)0x1234abcd);
+    check_same((const void*)nullptr);
+    check_same(Point{1, 2});
+    check_same(TEST_ENUM_A);
+    check_same(1.5);
+    check_same(0.0);
+    check_same(-2.25);
+    check_same(100.0);
+    check_same(1e100);
+    check_same(1.0f / 0.0f);
+    char buf[] = "array";
+    check_same(buf);
+
+    check_double(0.1);
+    check_double(1.0 / 3);
+    check_double(3.141592653589793);
+    check_double(5e-324);
+    check_double(std::numeric_limits<double>::max());
+    for(int i = 0; i < 20000; ++i) {
+        check_double(i * 0.001);
+        check_double(-i / 7.0);
+        check_double(i * 1e-6);
+        check_double(i * 123456.789);
+    }
+    {
+        le0n::LogStream ls;
+        ls << 0.0001 << " " << 0.5 << " " << -12.25 << " " << 123456789012.5;
+        assert(ls.str() == "0.0001 0.5 -12.25 123456789012.5");
+    }
+    {
+        le0n::LogStream ls;
+        ls << 0.1 << " " << 0.1f << " " << 1.0 / 3;
+        assert(ls.str() == "0.1 0.1 0.3333333333333333");
+    }
+
+    // 操纵符改变状态后，后面的内置类型和 stringstream 一致
+    {
+        le0n::LogStream ls;
+        std::stringstream ss;
+        ls << "a" << std::hex << 255 << " " << std::setw(6) << std::setfill('0') << 42
+           << std::dec << " " << 255 << std::endl << Point{3, 4} << std::setprecision(3) << 3.14159;
+        ss << "a" << std::hex << 255 << " " << std::setw(6) << std::setfill('0') << 42
+           << std::dec << " " << 255 << std::endl << Point{3, 4} << std::setprecision(3) << 3.14159;
+        assert(ls.str() == ss.str());
+    }
+
+    // 宏和 printf 风格的写法
+    le0n::Logger::ptr logger(new le0n::Logger("stream"));
+    std::shared_ptr<SeqLogAppender> appender(new SeqLogAppender);
+    logger->addAppender(appender);
+    LE0N_LOG_INFO(logger) << 123 << "4" << '5';
+    LE0N_LOG_FMT_INFO(logger, "%d%s", 6, "78");
+    assert(appender->seqs.size() == 2 && appender->seqs[0] == 12345 && appender->seqs[1] == 678);
+}
+
+// 典型日志内容: 整数、浮点数、字符串混合
+static void bench_log_stream() {
+    const int N = 500 * 1000;
+    std::string name = "connection";
+    size_t total = 0;
+    uint64_t t0 = le0n::GetCurrentUS();
+    for(int i = 0; i < N; ++i) {
+        std::stringstream ss;
+        ss << "request id=" << i << " " << name << " latency=" << i * 0.001
+           << "ms bytes=" << (uint64_t)i * 1024 << " ok=" << (i & 1);
+        total += ss.str().size();
+    }
+    uint64_t t1 = le0n::GetCurrentUS();
+    for(int i = 0; i < N; ++i) {
+        le0n::LogStream ls;
+        ls << "request id=" << i << " " << name << " latency=" << i * 0.001
+           << "ms bytes=" << (uint64_t)i * 1024 << " ok=" << (i & 1);
+        total += ls.str().size();
+    }
+    uint64_t t2 = le0n::GetCurrentUS();
+    LE0N_LOG_INFO(g_logger) << "bench_log_stream stringstream=" << (t1 - t0) * 1000.0 / N << "ns/msg"
+        << " LogStream=" << (t2 - t1) * 1000.0 / N << "ns/msg (" << total << " bytes)";
+}
+
+// 文件的用户态缓冲: WARN 立即写出，空闲时由后台线程写出，fork 不会重复写出
+void test_file_buffer() {
+    std::string file = "/tmp/le0n_file_buffer_" + std::to_string(getpid()) + ".log";
+    le0n::Logger::ptr logger(new le0n::Logger("buffer"));
+    le0n::FileLogAppender::ptr appender(new le0n::FileLogAppender(file));
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+
+    LE0N_LOG_INFO(logger) << "info";
+    LE0N_LOG_WARN(logger) << "warn";
+    assert(count_lines(file) == 2);
+
+    // 没有后续日志，也会在定时写出的周期内落盘
+    LE0N_LOG_INFO(logger) << "idle";
+    uint64_t start = le0n::GetMonotonicNS();
+    while(count_lines(file) != 3) {
+        assert(le0n::GetMonotonicNS() - start < 1000ull * 1000 * 1000);
+        usleep(1000);
+    }
+    uint64_t delay_ms = (le0n::GetMonotonicNS() - start) / 1000 / 1000;
+    assert(delay_ms < 200);
+
+    // fork 前写出缓冲，子进程退出时不会再写一次
+    LE0N_LOG_INFO(logger) << "before fork";
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if(pid == 0) {
+        exit(0);
+    }
+    int status = 0;
+    assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status));
+    appender->flush();
+    assert(count_lines(file) == 4);
+
+    // 其他线程不停写日志时 fork: 子进程不会继承被持有的锁(否则打日志时死锁)，
+    // 也不会继承父进程缓冲的日志(否则写出两次)
+    std::atomic<bool> quit(false);
+    std::atomic<int> produced(0);
+    std::thread writer([&](){
+        while(!quit) {
+            LE0N_LOG_INFO(logger) << "bg " << produced++;
+        }
+    });
+    const int FORKS = 200;
+    for(int i = 0; i < FORKS; ++i) {
+        pid_t child = fork();
+        assert(child >= 0);
+        if(child == 0) {
+            LE0N_LOG_INFO(logger) << "child " << i;
+            appender->flush();
+            _exit(0);
+        }
+        uint64_t begin = le0n::GetMonotonicNS();
+        while(waitpid(child, &status, WNOHANG) == 0) {
+            if(le0n::GetMonotonicNS() - begin > 5000ull * 1000 * 1000) {
+                kill(child, SIGKILL);
+                assert(!"child deadlocked after fork");
+            }
+            usleep(1000);
+        }
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    quit = true;
+    writer.join();
+    appender->flush();
+    assert(count_lines(file) == 4 + produced + FORKS);
+
+    // 关闭缓冲后每条日志一次 write
+    appender->setBufferSize(0);
+    LE0N_LOG_INFO(logger) << "unbuffered";
+    assert(count_lines(file) == 5 + produced + FORKS);
+    logger->clearAppenders();
+    unlink(file.c_str());
+    LE0N_LOG_INFO(g_logger) << "test_file_buffer ok: idle flush in " << delay_ms << "ms";
+}
+
+// 逐条写文件: 每条一次 write vs 用户态缓冲
+static void bench_file_buffer() {
+    std::string file = "/tmp/le0n_file_buffer_bench_" + std::to_string(getpid()) + ".log";
+    le0n::Logger::ptr logger(new le0n::Logger("buffer"));
+    const int N = 100 * 1000;
+    uint64_t cost[2];
+    for(int buffered = 0; buffered < 2; ++buffered) {
+        le0n::FileLogAppender::ptr appender(new le0n::FileLogAppender(file));
+        if(!buffered) {
+            appender->setBufferSize(0);
+        }
+        logger->addAppender(appender);
+        uint64_t t0 = le0n::GetMonotonicNS();
+        for(int i = 0; i < N; ++i) {
+            LE0N_LOG_INFO(logger) << "file buffer bench " << i;
+        }
+        appender->flush();
+        cost[buffered] = (le0n::GetMonotonicNS() - t0) / N;
+        logger->clearAppenders();
+    }
+    unlink(file.c_str());
+    LE0N_LOG_INFO(g_logger) << "bench_file_buffer write-per-log=" << cost[0] << "ns/log buffered="
+        << cost[1] << "ns/log";
+}
+
+// 各级别计数、字节数、失败次数，以及导出的文本
+void test_metrics() {
+    std::string file = "/tmp/le0n_metrics_" + std::to_string(getpid()) + ".log";
+    le0n::Logger::ptr logger = LE0N_LOG_NAME("metrics \"test\"");
+    logger->setLevel(le0n::LogLevel::INFO);
+    le0n::FileLogAppender::ptr appender(new le0n::FileLogAppender(file));
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%m%n")));
+    appender->setLevel(le0n::LogLevel::WARN);
+    logger->addAppender(appender);
+    for(int i = 0; i < 10; ++i) {
+        LE0N_LOG_DEBUG(logger) << "debug";
+        LE0N_LOG_INFO(logger) << "info";
+        LE0N_LOG_WARN(logger) << "warn";
+        LE0N_LOG_ERROR(logger) << "error";
+    }
+    le0n::LogMetricsSnapshot ls = logger->getMetrics().snapshot();
+    assert(ls.values[le0n::LogLevel::DEBUG] == 0);
+    assert(ls.values[le0n::LogLevel::INFO] == 10);
+    assert(ls.values[le0n::LogLevel::WARN] == 10);
+    assert(ls.values[le0n::LogLevel::ERROR] == 10);
+    assert(ls.getEvents() == 30);
+    le0n::LogMetricsSnapshot as = appender->getMetrics().snapshot();
+    assert(as.values[le0n::LogLevel::INFO] == 0);
+    assert(as.getEvents() == 20);
+    assert(as.values[le0n::LogMetrics::BYTES] == 10 * strlen("warn\n") + 10 * strlen("error\n"));
+    assert(as.values[le0n::LogMetrics::ERRORS] == 0);
+
+    // 多线程计数不丢
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.push_back(std::thread([logger](){
+            for(int i = 0; i < 1000; ++i) {
+                LE0N_LOG_WARN(logger) << "warn";
+            }
+        }));
+    }
+    for(auto& i : threads) {
+        i.join();
+    }
+    assert(logger->getMetrics().snapshot().values[le0n::LogLevel::WARN] == 4010);
+    assert(appender->getMetrics().snapshot().values[le0n::LogLevel::WARN] == 4010);
+
+    // 打不开的文件: 打开失败和每次写失败都计入 errors
+    le0n::FileLogAppender::ptr bad(new le0n::FileLogAppender("/nonexistent_dir/le0n.log"));
+    logger->addAppender(bad);
+    LE0N_LOG_ERROR(logger) << "lost";
+    assert(bad->getMetrics().snapshot().values[le0n::LogMetrics::ERRORS] == 2);
+
+    std::string text = le0n::LoggerMgr::GetInstance()->exportMetrics();
+    const char* expects[] = {
+        "# TYPE le0n_log_events_total counter\n",
+        "le0n_log_events_total{logger=\"metrics \\\"test\\\"\",level=\"WARN\"} 4010\n",
+        "le0n_appender_events_total{logger=\"metrics \\\"test\\\"\",appender=\"0\",type=\"FileLogAppender\",level=\"ERROR\"} 11\n",
+        "le0n_appender_errors_total{logger=\"metrics \\\"test\\\"\",appender=\"1\",type=\"FileLogAppender\"} 2\n",
+        "# TYPE le0n_appender_queue_depth gauge\n",
+    };
+    for(auto i : expects) {
+        assert(text.find(i) != std::string::npos);
+    }
+
+    std::string out = file + ".prom";
+    assert(le0n::LoggerMgr::GetInstance()->writeMetrics(out));
+    std::ifstream ifs(out);
+    std::string line;
+    assert(std::getline(ifs, line) && line.find("# HELP le0n_log_events_total") == 0);
+    logger->clearAppenders();
+    unlink(out.c_str());
+    unlink(file.c_str());
+}
+
+// 统计打开/关闭时同一条日志路径的耗时
+static void bench_metrics() {
+    std::string file = "/tmp/le0n_metrics_bench_" + std::to_string(getpid()) + ".log";
+    le0n::Logger::ptr logger(new le0n::Logger("bench"));
+    logger->addAppender(le0n::LogAppender::ptr(new le0n::FileLogAppender(file)));
+    const int N = 100000;
+    double cost[2];
+    for(int enabled = 1; enabled >= 0; --enabled) {
+        le0n::LogMetrics::SetEnabled(enabled);
+        uint64_t t0 = le0n::GetCurrentUS();
+        for(int i = 0; i < N; ++i) {
+            LE0N_LOG_INFO(logger) << "bench message " << i;
+        }
+        cost[enabled] = (le0n::GetCurrentUS() - t0) * 1000.0 / N;
+    }
+    le0n::LogMetrics::SetEnabled(true);
+    unlink(file.c_str());
+    LE0N_LOG_INFO(g_logger) << "bench_metrics enabled=" << cost[1] << "ns/log disabled="
+        << cost[0] << "ns/log";
+}
+
+// 线程级别覆盖: 只放宽本线程、作用域结束恢复、可以带到其他线程
+void test_scoped_level() {
+    le0n::Logger::ptr logger(new le0n::Logger("scoped"));
+    logger->setLevel(le0n::LogLevel::WARN);
+    std::shared_ptr<CountLogAppender> appender(new CountLogAppender);
+    std::shared_ptr<CountLogAppender> info_appender(new CountLogAppender);
+    info_appender->setLevel(le0n::LogLevel::INFO);
+    logger->addAppender(appender);
+    logger->addAppender(info_appender);
+
+    LE0N_LOG_DEBUG(logger) << "hidden";
+    LE0N_LOG_FMT_INFO(logger, "%s", "hidden");
+    assert(appender->count == 0);
+    std::function<void()> task;
+    {
+        LE0N_LOG_SCOPED_LEVEL(DEBUG);
+        assert(le0n::ScopedLogLevel::Get() == le0n::LogLevel::DEBUG);
+        LE0N_LOG_DEBUG(logger) << "shown";
+        LE0N_LOG_FMT_INFO(logger, "%s", "shown");
+        assert(appender->count == 2);
+        // Appender 自己的级别不受影响
+        assert(info_appender->count == 1);
+        {
+            // 嵌套时最内层生效
+            le0n::ScopedLogLevel scoped(le0n::LogLevel::INFO);
+            LE0N_LOG_DEBUG(logger) << "hidden";
+            LE0N_LOG_INFO(logger) << "shown";
+            assert(appender->count == 3);
+        }
+        LE0N_LOG_DEBUG(logger) << "shown";
+        assert(appender->count == 4);
+
+        // 其他线程不受影响，Wrap 之后带上覆盖级别
+        std::thread([logger](){
+            LE0N_LOG_DEBUG(logger) << "hidden";
+        }).join();
+        assert(appender->count == 4);
+        task = le0n::ScopedLogLevel::Wrap([logger](){
+            LE0N_LOG_DEBUG(logger) << "shown";
+        });
+    }
+    assert(le0n::ScopedLogLevel::Get() == le0n::ScopedLogLevel::NONE);
+    LE0N_LOG_DEBUG(logger) << "hidden";
+    std::thread(task).join();
+    assert(appender->count == 5);
+    // 执行完恢复执行线程原来的级别
+    task();
+    assert(le0n::ScopedLogLevel::Get() == le0n::ScopedLogLevel::NONE);
+
+    // 批量接口同样生效
+    le0n::LogEvent::ptr events[] = {make_event(logger, le0n::LogLevel::DEBUG, 0)
+                                    ,make_event(logger, le0n::LogLevel::ERROR, 1)};
+    logger->logBatch(events, 2);
+    assert(appender->count == 7);
+    {
+        le0n::ScopedLogLevel scoped(le0n::LogLevel::DEBUG);
+        logger->logBatch(events, 2);
+    }
+    assert(appender->count == 9);
+}
+
+// 被级别挡住的日志的开销(无覆盖)
+static void bench_scoped_level() {
+    le0n::Logger::ptr logger(new le0n::Logger("scoped"));
+    logger->setLevel(le0n::LogLevel::WARN);
+    logger->addAppender(le0n::LogAppender::ptr(new NullLogAppender));
+    const int N = 10 * 1000 * 1000;
+    uint64_t t0 = le0n::GetMonotonicNS();
+    for(int i = 0; i < N; ++i) {
+        LE0N_LOG_DEBUG(logger) << i;
+    }
+    uint64_t t1 = le0n::GetMonotonicNS();
+    LE0N_LOG_INFO(g_logger) << "bench_scoped_level disabled DEBUG=" << (t1 - t0) * 1.0 / N << "ns/log";
+}
+
+// MDC: 嵌套、同名覆盖、快照不受之后的修改影响、跨线程传递
+void test_log_context() {
+    le0n::Logger::ptr logger(new le0n::Logger("mdc"));
+    le0n::LogFormatter::ptr formatter(new le0n::LogFormatter("[%X{req}|%X{tenant}|%X] %m"));
+
+    le0n::LogEvent::ptr none = make_event(logger, le0n::LogLevel::INFO, 0);
+    assert(formatter->format(logger.get(), le0n::LogLevel::INFO, none) == "[||] batch 0");
+    le0n::LogEvent::ptr outer, inner;
+    std::function<void()> task;
+    {
+        LE0N_LOG_CONTEXT("req", "r1");
+        outer = make_event(logger, le0n::LogLevel::INFO, 1);
+        {
+            LE0N_LOG_CONTEXT("tenant", "t1");
+            LE0N_LOG_CONTEXT("req", "r2");
+            inner = make_event(logger, le0n::LogLevel::INFO, 2);
+            task = le0n::LogContext::Wrap([logger, formatter](){
+                le0n::LogEvent::ptr e = make_event(logger, le0n::LogLevel::INFO, 3);
+                assert(formatter->format(logger.get(), le0n::LogLevel::INFO, e)
+                       == "[r2|t1|req=r1 tenant=t1 req=r2] batch 3");
+            });
+        }
+        assert(le0n::LogContext::Current()->key == "req" && !le0n::LogContext::Current()->parent);
+    }
+    assert(!le0n::LogContext::Current());
+    // 事件保存的是创建时的快照
+    assert(formatter->format(logger.get(), le0n::LogLevel::INFO, outer) == "[r1||req=r1] batch 1");
+    assert(formatter->format(logger.get(), le0n::LogLevel::INFO, inner)
+           == "[r2|t1|req=r1 tenant=t1 req=r2] batch 2");
+    std::thread(task).join();
+    task();
+    assert(!le0n::LogContext::Current());
+}
+
+// 带上下文时，被级别挡住和真正输出的日志各自的开销
+static void bench_log_context() {
+    le0n::Logger::ptr logger(new le0n::Logger("mdc"));
+    logger->setLevel(le0n::LogLevel::INFO);
+    NullLogAppender::ptr appender(new NullLogAppender);
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%X{req} %X{tenant} %m")));
+    logger->addAppender(appender);
+    const int N = 500 * 1000;
+    uint64_t cost[2][2];
+    for(int ctx = 0; ctx < 2; ++ctx) {
+        std::unique_ptr<le0n::LogContextGuard> g1, g2;
+        if(ctx) {
+            g1.reset(new le0n::LogContextGuard("req", "6f1c2a9e-request-id"));
+            g2.reset(new le0n::LogContextGuard("tenant", "tenant-42"));
+        }
+        uint64_t t0 = le0n::GetMonotonicNS();
+        for(int i = 0; i < N; ++i) {
+            LE0N_LOG_DEBUG(logger) << "message " << i;
+        }
+        uint64_t t1 = le0n::GetMonotonicNS();
+        for(int i = 0; i < N; ++i) {
+            LE0N_LOG_INFO(logger) << "message " << i;
+        }
+        uint64_t t2 = le0n::GetMonotonicNS();
+        cost[ctx][0] = (t1 - t0) / N;
+        cost[ctx][1] = (t2 - t1) / N;
+    }
+    LE0N_LOG_INFO(g_logger) << "bench_log_context disabled: " << cost[0][0] << "ns -> " << cost[1][0]
+        << "ns, enabled(no format): " << cost[0][1] << "ns -> " << cost[1][1] << "ns";
+}
+
+// 模拟慢磁盘: 每批输出前等待，按级别计数
+class SlowLogAppender : public le0n::LogAppender {
+public:
+    void log(le0n::Logger* logger, le0n::LogLevel::Level level, const le0n::LogEvent::ptr& event) override {
+        ++counts[level];
+    }
+    void logBatch(const le0n::LogEvent::ptr* events, size_t count) override {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        for(size_t i = 0; i < count; ++i) {
+            ++counts[events[i]->getLevel()];
+        }
+    }
+    std::atomic<int> counts[6] = {};
+};
+
+// 降级顺序: 先丢 DEBUG，再丢 INFO，WARN 以上等待；预算由配置项设置
+void test_memory_budget() {
+    typedef le0n::LogMemoryBudget Budget;
+    le0n::ConfigVar<uint64_t>::ptr budget = le0n::Config::Lookup<uint64_t>("log.memory.budget");
+    assert(budget && Budget::GetLimit() == 0);
+    size_t charged = 1;
+    assert(Budget::Acquire(100, le0n::LogLevel::DEBUG, &charged) == Budget::GRANTED && charged == 0);
+
+    budget->setValue(1000);
+    assert(Budget::GetLimit() == 1000);
+    uint64_t shed_debug = Budget::GetShed(le0n::LogLevel::DEBUG);
+    uint64_t shed_info = Budget::GetShed(le0n::LogLevel::INFO);
+    uint64_t blocked = Budget::GetBlocked();
+    size_t c1, c2, c3, c4;
+    assert(Budget::Acquire(400, le0n::LogLevel::DEBUG, &c1) == Budget::GRANTED && c1 == 400);
+    assert(Budget::Acquire(200, le0n::LogLevel::DEBUG, &c2) == Budget::SHED);
+    assert(Budget::Acquire(300, le0n::LogLevel::INFO, &c2) == Budget::GRANTED);
+    assert(Budget::Acquire(100, le0n::LogLevel::INFO, &c3) == Budget::SHED);
+    assert(Budget::Acquire(200, le0n::LogLevel::WARN, &c3) == Budget::GRANTED);
+    assert(Budget::Acquire(200, le0n::LogLevel::ERROR, &c4, false) == Budget::FULL);
+    assert(Budget::GetUsed() == 900);
+    assert(Budget::GetShed(le0n::LogLevel::DEBUG) == shed_debug + 1);
+    assert(Budget::GetShed(le0n::LogLevel::INFO) == shed_info + 1);
+
+    // ERROR 等到有内存归还
+    std::atomic<bool> granted(false);
+    std::thread waiter([&](){
+        size_t c;
+        assert(Budget::Acquire(200, le0n::LogLevel::ERROR, &c) == Budget::GRANTED && c == 200);
+        granted = true;
+        Budget::Release(c);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    assert(!granted);
+    Budget::Release(c1);
+    waiter.join();
+    assert(granted && Budget::GetBlocked() == blocked + 1);
+    Budget::Release(c2);
+    Budget::Release(c3);
+    assert(Budget::GetUsed() == 0);
+
+    // 慢目标 + 异步队列: ERROR 一条不丢，DEBUG 先被丢弃，占用不超过预算
+    const uint64_t LIMIT = 64 * 1024;
+    budget->setValue(LIMIT);
+    shed_debug = Budget::GetShed(le0n::LogLevel::DEBUG);
+    le0n::Logger::ptr logger(new le0n::Logger("budget"));
+    logger->setLevel(le0n::LogLevel::DEBUG);
+    std::shared_ptr<SlowLogAppender> slow(new SlowLogAppender);
+    le0n::AsyncLogAppender::ptr async(new le0n::AsyncLogAppender(slow, 1 << 16));
+    logger->addAppender(async);
+    const int N = 20000;
+    std::string payload(200, 'x');
+    std::vector<std::thread> ths;
+    for(int t = 0; t < 2; ++t) {
+        ths.push_back(std::thread([&](){
+            for(int i = 0; i < N; ++i) {
+                le0n::LogLevel::Level level = i % 10 == 0 ? le0n::LogLevel::ERROR
+                                            : (i % 2 ? le0n::LogLevel::DEBUG : le0n::LogLevel::INFO);
+                LE0N_LOG_LEVEL(logger, level) << i << payload;
+            }
+        }));
+    }
+    for(auto& th : ths) {
+        th.join();
+    }
+    async->flush();
+    assert(slow->counts[le0n::LogLevel::ERROR] == 2 * N / 10);
+    uint64_t shed = Budget::GetShed(le0n::LogLevel::DEBUG) - shed_debug;
+    assert(shed > 0 && slow->counts[le0n::LogLevel::DEBUG] + shed == (uint64_t)N);
+    assert(async->getMetrics().snapshot().values[le0n::LogMetrics::DROPPED] >= shed);
+    assert(Budget::GetUsed() == 0 && Budget::GetPeak() <= LIMIT);
+    std::string text = le0n::LoggerMgr::GetInstance()->exportMetrics();
+    assert(text.find("le0n_log_memory_budget_bytes " + std::to_string(LIMIT) + "\n") != std::string::npos);
+    assert(text.find("le0n_log_memory_shed_total{level=\"DEBUG\"} ") != std::string::npos);
+    async->stop();
+    budget->setValue(0);
+    LE0N_LOG_INFO(g_logger) << "test_memory_budget ok: DEBUG " << slow->counts[le0n::LogLevel::DEBUG]
+        << " written " << shed << " shed, INFO " << slow->counts[le0n::LogLevel::INFO]
+        << " written, peak " << Budget::GetPeak() << " bytes";
+}
+
+static void bench_memory_budget() {
+    le0n::Logger::ptr logger(new le0n::Logger("budget"));
+    le0n::AsyncLogAppender::ptr async(new le0n::AsyncLogAppender(le0n::LogAppender::ptr(new NullLogAppender)));
+    logger->addAppender(async);
+    le0n::ConfigVar<uint64_t>::ptr budget = le0n::Config::Lookup<uint64_t>("log.memory.budget");
+    const int N = 100 * 1000;
+    uint64_t cost[2];
+    for(int i = 0; i < 2; ++i) {
+        budget->setValue(i ? 1ull << 30 : 0);
+        uint64_t t0 = le0n::GetMonotonicNS();
+        for(int j = 0; j < N; ++j) {
+            LE0N_LOG_INFO(logger) << "budget bench " << j;
+        }
+        async->flush();
+        cost[i] = (le0n::GetMonotonicNS() - t0) / N;
+    }
+    budget->setValue(0);
+    async->stop();
+    LE0N_LOG_INFO(g_logger) << "bench_memory_budget async log: unlimited=" << cost[0] << "ns budget=" << cost[1] << "ns";
+}
+
+int main(int argc, char** argv) {
+    test_batch();
+    bench_batch();
+    test_file_buffer();
+    bench_file_buffer();
+    test_async_order();
+    test_async_stop();
+    bench_async();
+    bench_root_dispatch();
+    test_stdout_pipe();
+    test_stdout_idle_flush();
+    test_stdout_fork();
+    bench_stdout();
+    test_log_stream();
+    bench_log_stream();
+    test_metrics();
+    bench_metrics();
+    test_scoped_level();
+    bench_scoped_level();
+    test_log_context();
+    bench_log_context();
+    test_memory_budget();
+    bench_memory_budget();
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "le0n/log.h"
+#include "le0n/util.h"
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <execinfo.h>
+#include <stdlib.h>
+#include <string.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+// 什么都不输出的 Appender，压测只统计分发路径本身的开销
+class NullLogAppender : public le0n::LogAppender {
+public:
+    void log(le0n::Logger* logger, le0n::LogLevel::Level level, const le0n::LogEvent::ptr& event) override {
+    }
+};
+
+// 保存事件，之后在别的线程上格式化
+class EventLogAppender : public le0n::LogAppender {
+public:
+    void log(le0n::Logger* logger, le0n::LogLevel::Level level, const le0n::LogEvent::ptr& event) override {
+        events.push_back(event);
+    }
+    std::vector<le0n::LogEvent::ptr> events;
+};
+
+// 不是 static 函数，-rdynamic 导出后能解析出名字
+void backtrace_site(le0n::Logger::ptr logger, le0n::LogLevel::Level level, int i) {
+    LE0N_LOG_LEVEL(logger, level) << "bt " << i;
+}
+
+// 用到 %s 之后 ERROR 才抓栈；在格式化线程上解析，同一地址只解析一次
+void test_backtrace() {
+    le0n::Logger::ptr logger(new le0n::Logger("backtrace"));
+    std::shared_ptr<EventLogAppender> appender(new EventLogAppender);
+    logger->addAppender(appender);
+    assert(le0n::LogBacktrace::GetCaptureLevel() == le0n::LogBacktrace::NONE);
+    backtrace_site(logger, le0n::LogLevel::ERROR, 0);
+    assert(!appender->events[0]->getBacktrace());
+
+    le0n::LogFormatter::ptr fmt(new le0n::LogFormatter("[%p] %m%s%n"));
+    assert(le0n::LogBacktrace::GetCaptureLevel() == le0n::LogLevel::ERROR);
+    for(int i = 1; i <= 3; ++i) {
+        backtrace_site(logger, i == 3 ? le0n::LogLevel::WARN : le0n::LogLevel::ERROR, i);
+    }
+    assert(appender->events[1]->getBacktrace() && appender->events[2]->getBacktrace());
+    assert(!appender->events[3]->getBacktrace());
+
+    std::vector<std::string> out;
+    size_t cache_size = 0;
+    std::thread writer([&](){
+        for(auto& e : appender->events) {
+            out.push_back(fmt->format(e->getLogger(), e->getLevel(), e));
+        }
+        cache_size = le0n::LogBacktrace::GetCacheSize();
+        out.push_back(fmt->format(logger.get(), le0n::LogLevel::ERROR, appender->events[1]));
+    });
+    writer.join();
+    assert(out[0] == "[ERROR] bt 0\n" && out[3] == "[WARN] bt 3\n");
+    // #0 是打日志的函数，接着是调用它的 test_backtrace
+    std::string first = out[1].substr(0, out[1].find("\n\t#1 "));
+    assert(out[1].compare(0, 19, "[ERROR] bt 1\n\t#0 0x") == 0);
+    assert(first.find("backtrace_site(std::shared_ptr<le0n::Logger>, le0n::LogLevel::Level, int)+0x") != std::string::npos);
+    assert(out[1].find("\n\t#1 ") != std::string::npos && out[1].find("test_backtrace()") != std::string::npos);
+    assert(out[1].back() == '\n');
+    // 两次调用只差 #1 的返回地址(循环内同一处调用)，缓存不增长
+    assert(out[2].find("bt 2\n\t#0 ") != std::string::npos);
+    assert(le0n::LogBacktrace::GetCacheSize() == cache_size);
+    assert(out[4] == out[1]);
+
+    // %s{WARN} 降低抓取级别
+    le0n::LogFormatter::ptr warn_fmt(new le0n::LogFormatter("%m%s{WARN}"));
+    assert(le0n::LogBacktrace::GetCaptureLevel() == le0n::LogLevel::WARN);
+    backtrace_site(logger, le0n::LogLevel::WARN, 4);
+    std::string warn = warn_fmt->format(logger.get(), le0n::LogLevel::WARN, appender->events.back());
+    assert(warn.find("bt 4\n\t#0 ") == 0 && fmt->format(logger.get(), le0n::LogLevel::WARN, appender->events.back()) == "[WARN] bt 4\n");
+
+    // 格式器销毁后注销，抓取级别回升；临时的格式器不会让之后的 ERROR 一直抓栈
+    warn_fmt.reset();
+    assert(le0n::LogBacktrace::GetCaptureLevel() == le0n::LogLevel::ERROR);
+    fmt.reset();
+    assert(le0n::LogBacktrace::GetCaptureLevel() == le0n::LogBacktrace::NONE);
+    {
+        le0n::LogFormatter tmp("%m%s{DEBUG}");
+        assert(le0n::LogBacktrace::GetCaptureLevel() == le0n::LogLevel::DEBUG);
+    }
+    backtrace_site(logger, le0n::LogLevel::ERROR, 5);
+    assert(!appender->events.back()->getBacktrace());
+    // 替换 appender 的格式器(如重新加载配置)时旧的注销
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%m%s")));
+    assert(le0n::LogBacktrace::GetCaptureLevel() == le0n::LogLevel::ERROR);
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%m%n")));
+    assert(le0n::LogBacktrace::GetCaptureLevel() == le0n::LogBacktrace::NONE);
+    // 手动指定的级别和格式项登记的级别取较低者
+    le0n::LogBacktrace::SetCaptureLevel(le0n::LogLevel::FATAL);
+    le0n::LogFormatter::ptr err_fmt(new le0n::LogFormatter("%m%s"));
+    assert(le0n::LogBacktrace::GetCaptureLevel() == le0n::LogLevel::ERROR);
+    err_fmt.reset();
+    assert(le0n::LogBacktrace::GetCaptureLevel() == le0n::LogLevel::FATAL);
+    le0n::LogBacktrace::SetCaptureLevel(le0n::LogBacktrace::NONE);
+    LE0N_LOG_INFO(g_logger) << "test_backtrace ok";
+}
+
+static void bench_backtrace() {
+    le0n::Logger::ptr logger(new le0n::Logger("backtrace"));
+    logger->addAppender(le0n::LogAppender::ptr(new NullLogAppender));
+    const int N = 20000;
+    uint64_t t0 = le0n::GetMonotonicNS();
+    for(int i = 0; i < N; ++i) {
+        backtrace_site(logger, le0n::LogLevel::ERROR, i);
+    }
+    uint64_t t1 = le0n::GetMonotonicNS();
+    le0n::LogBacktrace::SetCaptureLevel(le0n::LogLevel::ERROR);
+    for(int i = 0; i < N; ++i) {
+        backtrace_site(logger, le0n::LogLevel::ERROR, i);
+    }
+    uint64_t t2 = le0n::GetMonotonicNS();
+    // 抓栈 + 从缓存解析输出
+    std::stringstream ss;
+    for(int i = 0; i < N; ++i) {
+        le0n::LogBacktrace::ptr bt = le0n::LogBacktrace::Capture();
+        bt->format(ss);
+        ss.str("");
+    }
+    uint64_t t3 = le0n::GetMonotonicNS();
+    // 每次都 backtrace_symbols
+    size_t len = 0;
+    for(int i = 0; i < N; ++i) {
+        void* frames[le0n::LogBacktrace::MAX_FRAMES];
+        int n = backtrace(frames, le0n::LogBacktrace::MAX_FRAMES);
+        char** syms = backtrace_symbols(frames, n);
+        for(int j = 0; j < n; ++j) {
+            len += strlen(syms[j]);
+        }
+        free(syms);
+    }
+    uint64_t t4 = le0n::GetMonotonicNS();
+    le0n::LogBacktrace::SetCaptureLevel(le0n::LogBacktrace::NONE);
+    LE0N_LOG_INFO(g_logger) << "bench_backtrace log=" << (t1 - t0) / N << "ns log+capture=" << (t2 - t1) / N
+        << "ns capture+cached format=" << (t3 - t2) / N << "ns backtrace_symbols=" << (t4 - t3) / N
+        << "ns (" << (len & 1) << ")";
+}
+
+int main(int argc, char** argv) {
+    test_backtrace();
+    bench_backtrace();
+    return 0;
+}
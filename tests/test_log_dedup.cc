@@ -0,0 +1,114 @@
+#include "le0n/log.h"
+#include "le0n/log_dedup.h"
+#include "le0n/util.h"
+#include <cassert>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+static le0n::LogEvent::ptr make_event(le0n::Logger::ptr logger, le0n::LogLevel::Level level, int i) {
+    le0n::LogEvent::ptr event(new le0n::LogEvent(logger.get(), level, __FILE__, __LINE__, 0
+                , le0n::GetThreadId(), le0n::GetFiberId(), time(0)));
+    event->getSS() << "batch " << i;
+    return event;
+}
+
+// 保存每条日志内容的 Appender
+class ContentLogAppender : public le0n::LogAppender {
+public:
+    void log(le0n::Logger* logger, le0n::LogLevel::Level level, const le0n::LogEvent::ptr& event) override {
+        lines.push_back(event->getContent());
+    }
+    std::vector<std::string> lines;
+};
+
+static void log_repeat(le0n::Logger::ptr logger, const std::string& msg, int n) {
+    for(int i = 0; i < n; ++i) {
+        LE0N_LOG_INFO(logger) << msg;
+    }
+}
+
+// 连续重复合并、不同调用位置不合并、窗口、flush、批量接口
+void test_dedup() {
+    le0n::Logger::ptr logger(new le0n::Logger("dedup"));
+    std::shared_ptr<ContentLogAppender> target(new ContentLogAppender);
+    le0n::DedupLogAppender::ptr dedup(new le0n::DedupLogAppender(target));
+    logger->addAppender(dedup);
+
+    log_repeat(logger, "connect failed", 5);
+    log_repeat(logger, "connect ok", 1);
+    // 内容相同但调用位置不同
+    LE0N_LOG_INFO(logger) << "connect ok";
+    LE0N_LOG_WARN(logger) << "connect ok";
+    log_repeat(logger, "x", 3);
+    dedup->flush();
+    dedup->flush();
+    std::vector<std::string> expect = {"connect failed", "last message repeated 4 times", "connect ok"
+        ,"connect ok", "connect ok", "x", "last message repeated 2 times"};
+    assert(target->lines == expect);
+    assert(dedup->getMetrics().snapshot().values[le0n::LogMetrics::DROPPED] == 6);
+    assert(dedup->Hash(make_event(logger, le0n::LogLevel::INFO, 1))
+           != dedup->Hash(make_event(logger, le0n::LogLevel::INFO, 2)));
+
+    // 窗口: 超过窗口后输出汇总和一条原文
+    target->lines.clear();
+    le0n::DedupLogAppender::ptr windowed(new le0n::DedupLogAppender(target, 50));
+    logger->clearAppenders();
+    logger->addAppender(windowed);
+    log_repeat(logger, "flood", 10);
+    usleep(60 * 1000);
+    log_repeat(logger, "flood", 3);
+    windowed.reset();
+    logger->clearAppenders();
+    expect = {"flood", "last message repeated 9 times", "flood", "last message repeated 2 times"};
+    assert(target->lines == expect);
+
+    // 批量接口
+    target->lines.clear();
+    le0n::DedupLogAppender::ptr batch(new le0n::DedupLogAppender(target));
+    std::vector<le0n::LogEvent::ptr> events;
+    for(int i = 0; i < 6; ++i) {
+        events.push_back(make_event(logger, le0n::LogLevel::INFO, i < 4 ? 0 : 1));
+    }
+    batch->logBatch(events.data(), events.size());
+    batch->flush();
+    expect = {"batch 0", "last message repeated 3 times", "batch 1", "last message repeated 1 times"};
+    assert(target->lines == expect);
+}
+
+// 去重判断(哈希)和它省下的一次文件写入的开销
+static void bench_dedup() {
+    std::string file = "/tmp/le0n_dedup_bench_" + std::to_string(getpid()) + ".log";
+    le0n::Logger::ptr logger(new le0n::Logger("dedup"));
+    le0n::LogAppender::ptr appender(new le0n::FileLogAppender(file));
+    const int N = 200 * 1000;
+    std::string msg = "upstream 10.0.0.12:8080 connect failed: Connection refused, retrying in 0ms";
+    uint64_t t0 = le0n::GetMonotonicNS();
+    logger->addAppender(appender);
+    log_repeat(logger, msg, N);
+    uint64_t t1 = le0n::GetMonotonicNS();
+    logger->clearAppenders();
+    le0n::DedupLogAppender::ptr dedup(new le0n::DedupLogAppender(appender));
+    logger->addAppender(dedup);
+    log_repeat(logger, msg, N);
+    uint64_t t2 = le0n::GetMonotonicNS();
+    le0n::LogEvent::ptr event = make_event(logger, le0n::LogLevel::INFO, 0);
+    event->getSS() << msg;
+    uint64_t h = 0;
+    for(int i = 0; i < N; ++i) {
+        h += le0n::DedupLogAppender::Hash(event);
+    }
+    uint64_t t3 = le0n::GetMonotonicNS();
+    logger->clearAppenders();
+    unlink(file.c_str());
+    LE0N_LOG_INFO(g_logger) << "bench_dedup file=" << (t1 - t0) / N << "ns/log dedup=" << (t2 - t1) / N
+        << "ns/log hash=" << (t3 - t2) / N << "ns (" << (h & 1) << ")";
+}
+
+int main(int argc, char** argv) {
+    test_dedup();
+    bench_dedup();
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "le0n/log.h"
+#include "le0n/log_index.h"
+#include "le0n/util.h"
+#include <cassert>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+// 稀疏时间索引: 块首尾相接覆盖整个文件，按时间段和级别选出的范围包含所有匹配的日志
+void test_log_index() {
+    std::string file = "/tmp/le0n_index_" + std::to_string(getpid()) + ".log";
+    le0n::Logger::ptr logger(new le0n::Logger("index"));
+    const uint64_t BASE = 1700000000;
+    const int N = 20000;
+    {
+        le0n::FileLogAppender::ptr appender(new le0n::FileLogAppender(file));
+        appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%d{%s} [%p] %m%n")));
+        appender->setIndex(4096);
+        // 每秒 100 条，每 1000 条有一条 ERROR
+        for(int i = 0; i < N; ++i) {
+            le0n::LogLevel::Level level = i % 1000 == 999 ? le0n::LogLevel::ERROR : le0n::LogLevel::INFO;
+            le0n::LogEvent::ptr event(new le0n::LogEvent(logger.get(), level, __FILE__, __LINE__, 0
+                        , 0, 0, BASE + i / 100));
+            event->getSS() << "seq " << i;
+            if(i % 10 == 0) {
+                appender->log(logger.get(), level, event);
+            } else {
+                appender->logBatch(&event, 1);
+            }
+        }
+    }
+    std::vector<le0n::LogIndexEntry> entries;
+    uint64_t block_size = 0;
+    assert(le0n::LogIndex::Load(le0n::LogIndex::IndexFile(file), entries, &block_size));
+    assert(block_size == 4096);
+    struct stat st;
+    assert(stat(file.c_str(), &st) == 0);
+    uint64_t pos = 0, count = 0;
+    for(auto& e : entries) {
+        assert(e.offset == pos && e.min_time <= e.max_time);
+        pos += e.length;
+        count += e.count;
+    }
+    assert(pos == (uint64_t)st.st_size && count == N);
+
+    // 选出的范围里的日志，与全文件里匹配的日志完全一致
+    std::ifstream ifs(file);
+    std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    auto matching = [](const std::string& text, uint64_t start, uint64_t end, bool error_only){
+        std::vector<std::string> lines;
+        std::stringstream ss(text);
+        std::string line;
+        while(std::getline(ss, line)) {
+            uint64_t t = std::stoull(line);
+            if(t >= start && t <= end && (!error_only || line.find("[ERROR]") != std::string::npos)) {
+                lines.push_back(line);
+            }
+        }
+        return lines;
+    };
+    struct Case { uint64_t start; uint64_t end; bool error_only; };
+    Case cases[] = {{BASE + 50, BASE + 52, false}, {BASE, BASE + 1000, true}, {BASE + 500, BASE + 600, false}};
+    for(auto& c : cases) {
+        std::vector<std::pair<uint64_t, uint64_t> > ranges;
+        uint32_t mask = c.error_only ? ~0u << le0n::LogLevel::ERROR : ~0u;
+        uint64_t covered = le0n::LogIndex::Select(entries, c.start, c.end, mask, ranges);
+        assert(covered == (uint64_t)st.st_size);
+        std::string selected;
+        uint64_t bytes = 0;
+        for(auto& r : ranges) {
+            selected.append(content, r.first, r.second - r.first);
+            bytes += r.second - r.first;
+        }
+        assert(matching(selected, c.start, c.end, c.error_only) == matching(content, c.start, c.end, c.error_only));
+        // 只需要读很小一部分
+        assert(bytes * 4 < content.size());
+    }
+    assert(le0n::LogLevel::FromString("error") == le0n::LogLevel::ERROR);
+    unlink(file.c_str());
+    unlink(le0n::LogIndex::IndexFile(file).c_str());
+}
+
+int main(int argc, char** argv) {
+    test_log_index();
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "le0n/log.h"
+#include "le0n/util.h"
+#include <cassert>
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+// 多进程共享文件的写入进程: 每个进程 2 个线程，单条和整批交替，部分日志超过 PIPE_BUF
+static void shared_writer(const std::string& file, int proc, int count, uint64_t max_size) {
+    le0n::Logger::ptr logger(new le0n::Logger("shared"));
+    le0n::FileLogAppender::ptr appender(new le0n::FileLogAppender(file, true));
+    appender->setShared(max_size, 100000);
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+    auto payload = [proc](int seq){
+        return std::string(seq % 50 == 0 ? 9000 : seq % 200, 'a' + proc);
+    };
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 2; ++t) {
+        threads.push_back(std::thread([&, t](){
+            for(int i = t; i < count; i += 2) {
+                if(i % 20 < 10) {
+                    LE0N_LOG_INFO(logger) << "p=" << proc << " s=" << i << " " << payload(i);
+                    continue;
+                }
+                std::vector<le0n::LogEvent::ptr> events;
+                for(int j = 0; j < 5 && i < count; ++j, i += 2) {
+                    le0n::LogEvent::ptr e(new le0n::LogEvent(logger.get(), le0n::LogLevel::INFO, __FILE__, __LINE__
+                                , 0, le0n::GetThreadId(), le0n::GetFiberId(), time(0)));
+                    e->getSS() << "p=" << proc << " s=" << i << " " << payload(i);
+                    events.push_back(e);
+                }
+                i -= 2;
+                logger->logBatch(events.data(), events.size());
+            }
+        }));
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+}
+
+// 多个进程同时写同一个文件并频繁切分: 所有切分出的文件里每条日志恰好出现一次且完整
+void test_shared_file() {
+    std::string file = "/tmp/le0n_shared_" + std::to_string(getpid()) + ".log";
+    const int PROCS = 4;
+    const int N = 4000;
+    const uint64_t MAX_SIZE = 128 * 1024;
+    std::vector<pid_t> pids;
+    for(int p = 0; p < PROCS; ++p) {
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if(pid == 0) {
+            shared_writer(file, p, N, MAX_SIZE);
+            _exit(0);
+        }
+        pids.push_back(pid);
+    }
+    for(auto pid : pids) {
+        int status = 0;
+        assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    std::set<std::pair<int, int> > seen;
+    int files = 0;
+    for(int i = 0; ; ++i) {
+        std::string name = i ? file + "." + std::to_string(i) : file;
+        std::ifstream ifs(name);
+        if(!ifs) {
+            break;
+        }
+        ++files;
+        std::string line;
+        while(std::getline(ifs, line)) {
+            int proc = -1, seq = -1, off = 0;
+            assert(sscanf(line.c_str(), "p=%d s=%d %n", &proc, &seq, &off) == 2);
+            std::string payload = line.substr(off);
+            assert(proc >= 0 && proc < PROCS && seq >= 0 && seq < N);
+            assert(payload == std::string(seq % 50 == 0 ? 9000 : seq % 200, 'a' + proc));
+            assert(seen.insert(std::make_pair(proc, seq)).second);
+        }
+        unlink(name.c_str());
+    }
+    unlink((file + ".lock").c_str());
+    assert(seen.size() == (size_t)PROCS * N);
+    assert(files > 10);
+    LE0N_LOG_INFO(g_logger) << "test_shared_file ok: " << seen.size() << " lines in " << files << " files";
+}
+
+static void bench_shared_file() {
+    std::string file = "/tmp/le0n_shared_bench_" + std::to_string(getpid()) + ".log";
+    le0n::Logger::ptr logger(new le0n::Logger("shared"));
+    const int N = 100 * 1000;
+    uint64_t cost[3];
+    for(int mode = 0; mode < 3; ++mode) {
+        le0n::FileLogAppender::ptr appender(new le0n::FileLogAppender(file, mode != 0));
+        if(mode == 1) {
+            appender->setShared();
+        } else if(mode == 2) {
+            appender->setShared(4 * 1024 * 1024, 1);
+        }
+        logger->addAppender(appender);
+        uint64_t t0 = le0n::GetMonotonicNS();
+        for(int i = 0; i < N; ++i) {
+            LE0N_LOG_INFO(logger) << "shared file bench " << i;
+        }
+        cost[mode] = (le0n::GetMonotonicNS() - t0) / N;
+        logger->clearAppenders();
+    }
+    unlink(file.c_str());
+    unlink((file + ".1").c_str());
+    unlink((file + ".lock").c_str());
+    LE0N_LOG_INFO(g_logger) << "bench_shared_file plain=" << cost[0] << "ns/log shared=" << cost[1]
+        << "ns/log shared+rotate=" << cost[2] << "ns/log";
+}
+
+int main(int argc, char** argv) {
+    test_shared_file();
+    bench_shared_file();
+    return 0;
+}
@@ -0,0 +1,277 @@
+#include "le0n/log.h"
+#include "le0n/log_shm.h"
+#include "le0n/util.h"
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+static std::string make_prefix(const char* name) {
+    return std::string("le0n_test_") + name + "_" + std::to_string(getpid());
+}
+
+// 在子进程中按顺序写日志，返回子进程 pid
+static pid_t spawn_writer(const std::string& prefix, size_t size, int count, bool crash) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if(pid == 0) {
+        le0n::Logger::ptr logger(new le0n::Logger("shm"));
+        le0n::ShmLogAppender::ptr appender(new le0n::ShmLogAppender(prefix, size));
+        if(!appender->isValid()) {
+            _exit(2);
+        }
+        logger->addAppender(appender);
+        for(int i = 0; count < 0 || i < count; ++i) {
+            LE0N_LOG_INFO(logger) << "seq " << i << " " << std::string(i % 300, 'x');
+        }
+        if(crash) {
+            // 不析构 Appender，模拟进程崩溃
+            _exit(0);
+        }
+        logger->clearAppenders();
+        appender.reset();
+        _exit(0);
+    }
+    return pid;
+}
+
+// 共享内存名为 "/<prefix>.<pid>.<启动时间>.<序号>"，按前缀和 pid 查找
+static le0n::ShmLogReader::ptr open_reader(const std::string& prefix, pid_t pid) {
+    std::string expect = "/" + prefix + "." + std::to_string(pid) + ".";
+    for(int i = 0; i < 1000; ++i) {
+        std::vector<std::string> names;
+        le0n::ListShmLogs(prefix, names);
+        for(auto& name : names) {
+            if(name.compare(0, expect.size(), expect) != 0) {
+                continue;
+            }
+            le0n::ShmLogReader::ptr reader = le0n::ShmLogReader::Open(name);
+            if(reader) {
+                return reader;
+            }
+        }
+        usleep(1000);
+    }
+    return nullptr;
+}
+
+// 读到写入方结束，检查序号递增(有丢弃时允许跳号，否则必须连续)，返回读到的条数
+static int drain(le0n::ShmLogReader::ptr reader, bool allow_gap) {
+    std::vector<le0n::ShmLogRecord> records;
+    int next = 0;
+    int n = 0;
+    while(true) {
+        records.clear();
+        reader->read(records);
+        for(auto& r : records) {
+            assert(r.logger == "shm");
+            assert(r.level == le0n::LogLevel::INFO);
+            int seq = atoi(r.content.c_str() + 4);
+            assert(allow_gap ? seq >= next : seq == next);
+            assert(r.content.size() == 4 + std::to_string(seq).size() + 1 + seq % 300);
+            next = seq + 1;
+            ++n;
+        }
+        if(records.empty()) {
+            if(reader->isFinished()) {
+                break;
+            }
+            reader->wait(100);
+        }
+    }
+    return n;
+}
+
+// 正常关闭: 所有日志都能读到
+void test_clean_close() {
+    std::string prefix = make_prefix("close");
+    const int N = 20000;
+    pid_t pid = spawn_writer(prefix, 16 * 1024 * 1024, N, false);
+    le0n::ShmLogReader::ptr reader = open_reader(prefix, pid);
+    assert(reader);
+    int n = drain(reader, false);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert((uint64_t)n + reader->getDropped() == (uint64_t)N);
+    assert(reader->getSkipped() == 0);
+    reader->unlink();
+    std::cout << "clean close: read=" << n << " dropped=" << reader->getDropped() << std::endl;
+}
+
+// 写入方被 SIGKILL: 已提交的日志不丢，序号连续，读取方能确认结束
+void test_crash() {
+    std::string prefix = make_prefix("crash");
+    pid_t pid = spawn_writer(prefix, 64 * 1024 * 1024, -1, false);
+    le0n::ShmLogReader::ptr reader = open_reader(prefix, pid);
+    assert(reader);
+    // 不读取，让日志积累在缓冲区里
+    usleep(50 * 1000);
+    kill(pid, SIGKILL);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFSIGNALED(status));
+    assert(!reader->isWriterAlive());
+    int n = drain(reader, false);
+    assert(n > 0);
+    assert(reader->isFinished());
+    reader->unlink();
+    std::cout << "crash: read=" << n << " dropped=" << reader->getDropped()
+              << " skipped=" << reader->getSkipped() << std::endl;
+}
+
+// 缓冲区满: 丢弃并计数，不阻塞写入方
+void test_drop() {
+    std::string prefix = make_prefix("drop");
+    const int N = 10000;
+    pid_t pid = spawn_writer(prefix, 16 * 1024, N, true);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    le0n::ShmLogReader::ptr reader = open_reader(prefix, pid);
+    assert(reader);
+    int n = drain(reader, true);
+    assert(n > 0 && n < N);
+    assert((uint64_t)n + reader->getDropped() == (uint64_t)N);
+    reader->unlink();
+    std::cout << "drop: read=" << n << " dropped=" << reader->getDropped() << std::endl;
+}
+
+// 同进程多线程写入 + 读取方在 futex 上等待唤醒
+void test_wakeup() {
+    std::string prefix = make_prefix("wakeup");
+    le0n::Logger::ptr logger(new le0n::Logger("shm"));
+    le0n::ShmLogAppender::ptr appender(new le0n::ShmLogAppender(prefix, 1024 * 1024));
+    assert(appender->isValid());
+    logger->addAppender(appender);
+    le0n::ShmLogReader::ptr reader = le0n::ShmLogReader::Open(appender->getShmName());
+    assert(reader);
+
+    const int THREADS = 4;
+    const int N = 2000;
+    std::vector<int> next(THREADS, 0);
+    std::thread reader_thread([&](){
+        std::vector<le0n::ShmLogRecord> records;
+        int total = 0;
+        while(total < THREADS * N) {
+            records.clear();
+            if(!reader->read(records)) {
+                reader->wait(1000);
+                continue;
+            }
+            for(auto& r : records) {
+                int t = 0, seq = 0;
+                sscanf(r.content.c_str(), "t%d %d", &t, &seq);
+                // 同一线程内的日志保持顺序
+                assert(seq == next[t]);
+                ++next[t];
+            }
+            total += records.size();
+        }
+    });
+    std::vector<std::thread> writers;
+    for(int t = 0; t < THREADS; ++t) {
+        writers.push_back(std::thread([&, t](){
+            for(int i = 0; i < N; ++i) {
+                LE0N_LOG_INFO(logger) << "t" << t << " " << i;
+                if(i % 100 == 0) {
+                    usleep(1000);
+                }
+            }
+        }));
+    }
+    for(auto& i : writers) {
+        i.join();
+    }
+    reader_thread.join();
+    assert(appender->getDropped() == 0);
+    logger->clearAppenders();
+    appender.reset();
+    assert(reader->isFinished());
+    reader->unlink();
+    std::cout << "wakeup: ok" << std::endl;
+}
+
+// 同一进程的多个 Appender 各自一块共享内存；重新创建 Appender 不会删除还没读完的共享内存，
+// 读完一块后删除它不影响其他写入方
+void test_unique_name() {
+    std::string prefix = make_prefix("unique");
+    le0n::Logger::ptr logger(new le0n::Logger("shm"));
+    le0n::ShmLogAppender::ptr a(new le0n::ShmLogAppender(prefix, 64 * 1024));
+    le0n::ShmLogAppender::ptr b(new le0n::ShmLogAppender(prefix, 64 * 1024));
+    assert(a->isValid() && b->isValid());
+    assert(a->getShmName() != b->getShmName());
+    logger->addAppender(a);
+    LE0N_LOG_INFO(logger) << "seq 0 ";
+    logger->clearAppenders();
+    std::string name_a = a->getShmName();
+    a.reset();
+    // 旧的还没读，重新创建一个
+    le0n::ShmLogAppender::ptr c(new le0n::ShmLogAppender(prefix, 64 * 1024));
+    assert(c->isValid() && c->getShmName() != name_a);
+    std::vector<std::string> names;
+    le0n::ListShmLogs(prefix, names);
+    assert(names.size() == 3);
+
+    le0n::ShmLogReader::ptr reader = le0n::ShmLogReader::Open(name_a);
+    assert(reader);
+    assert(reader->isWriterAlive());
+    assert(drain(reader, false) == 1);
+    reader->unlink();
+    names.clear();
+    le0n::ListShmLogs(prefix, names);
+    assert(names.size() == 2);
+    // 已删除的名字不会再删到别的共享内存
+    reader->unlink();
+    names.clear();
+    le0n::ListShmLogs(prefix, names);
+    assert(names.size() == 2);
+    for(auto& i : names) {
+        le0n::ShmLogReader::ptr r = le0n::ShmLogReader::Open(i);
+        assert(r);
+        r->unlink();
+    }
+    std::cout << "unique name: ok" << std::endl;
+}
+
+// 写入耗时: 业务线程只做编码和内存拷贝
+void bench_shm() {
+    std::string prefix = make_prefix("bench");
+    le0n::Logger::ptr logger(new le0n::Logger("shm"));
+    le0n::ShmLogAppender::ptr appender(new le0n::ShmLogAppender(prefix, 64 * 1024 * 1024));
+    logger->addAppender(appender);
+    le0n::ShmLogReader::ptr reader = le0n::ShmLogReader::Open(appender->getShmName());
+    assert(reader);
+
+    const int N = 200000;
+    uint64_t start = le0n::GetMonotonicNS();
+    for(int i = 0; i < N; ++i) {
+        LE0N_LOG_INFO(logger) << "bench message " << i;
+    }
+    uint64_t used = le0n::GetMonotonicNS() - start;
+    logger->clearAppenders();
+    uint64_t dropped = appender->getDropped();
+    appender.reset();
+    std::vector<le0n::ShmLogRecord> records;
+    reader->read(records);
+    assert(records.size() + dropped == (size_t)N);
+    reader->unlink();
+    std::cout << "shm appender: " << used / N << " ns/log, dropped=" << dropped << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_clean_close();
+    test_crash();
+    test_drop();
+    test_wakeup();
+    test_unique_name();
+    bench_shm();
+    return 0;
+}
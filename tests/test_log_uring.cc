@@ -0,0 +1,224 @@
+#include "le0n/log.h"
+#include "le0n/log_async.h"
+#include "le0n/log_budget.h"
+#include "le0n/log_uring.h"
+#include "le0n/util.h"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+static std::string make_file(const char* name) {
+    return std::string("/tmp/le0n_uring_") + name + "_" + std::to_string(getpid()) + ".log";
+}
+
+// 按行读出文件，检查每一行是 "<前缀><序号>"，返回行数
+static int check_lines(const std::string& file, const std::string& prefix, int first) {
+    std::ifstream ifs(file);
+    std::string line;
+    int n = first;
+    while(std::getline(ifs, line)) {
+        assert(line == prefix + std::to_string(n) + " " + std::string(n % 100, 'x'));
+        ++n;
+    }
+    return n - first;
+}
+
+static void write_seq(le0n::Logger::ptr logger, int first, int count) {
+    for(int i = first; i < first + count; ++i) {
+        LE0N_LOG_INFO(logger) << "seq " << i << " " << std::string(i % 100, 'x');
+    }
+}
+
+static le0n::Logger::ptr make_logger(le0n::LogAppender::ptr appender) {
+    le0n::Logger::ptr logger(new le0n::Logger("uring"));
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+    return logger;
+}
+
+// 小缓冲区 + 多个在途请求，检查内容完整有序；再追加打开，检查续写位置
+void test_write(bool direct) {
+    std::string file = make_file(direct ? "direct" : "buffered");
+    const int N = 20000;
+    {
+        le0n::UringFileLogAppender::ptr appender(new le0n::UringFileLogAppender(file, false, direct, 8192, 4));
+        le0n::Logger::ptr logger = make_logger(appender);
+        std::cout << (direct ? "direct" : "buffered") << ": uring=" << appender->isUring()
+                  << " direct=" << appender->isDirect() << std::endl;
+        write_seq(logger, 0, N);
+        // flush 之后内容完整可见
+        appender->flush();
+        assert(check_lines(file, "seq ", 0) == N);
+        write_seq(logger, N, N);
+        assert(appender->getErrors() == 0);
+    }
+    assert(check_lines(file, "seq ", 0) == 2 * N);
+    {
+        // 追加模式下，O_DIRECT 需要把未对齐的文件尾读回来重写
+        le0n::UringFileLogAppender::ptr appender(new le0n::UringFileLogAppender(file, true, direct, 8192, 2));
+        le0n::Logger::ptr logger = make_logger(appender);
+        write_seq(logger, 2 * N, 10);
+        appender->flush();
+        write_seq(logger, 2 * N + 10, 10);
+        assert(appender->reopen());
+        write_seq(logger, 2 * N + 20, 10);
+    }
+    assert(check_lines(file, "seq ", 0) == 2 * N + 30);
+    unlink(file.c_str());
+}
+
+// 多线程写入，每个线程的日志保持顺序
+void test_threads() {
+    std::string file = make_file("threads");
+    const int THREADS = 4;
+    const int N = 5000;
+    {
+        le0n::UringFileLogAppender::ptr appender(new le0n::UringFileLogAppender(file, false, false, 16384, 4));
+        le0n::Logger::ptr logger = make_logger(appender);
+        std::vector<std::thread> threads;
+        for(int t = 0; t < THREADS; ++t) {
+            threads.push_back(std::thread([logger, t](){
+                for(int i = 0; i < N; ++i) {
+                    LE0N_LOG_INFO(logger) << "t" << t << " " << i;
+                }
+            }));
+        }
+        for(auto& i : threads) {
+            i.join();
+        }
+    }
+    std::ifstream ifs(file);
+    std::string line;
+    std::vector<int> next(THREADS, 0);
+    int total = 0;
+    while(std::getline(ifs, line)) {
+        int t = 0, i = 0;
+        assert(sscanf(line.c_str(), "t%d %d", &t, &i) == 2);
+        assert(i == next[t]);
+        ++next[t];
+        ++total;
+    }
+    assert(total == THREADS * N);
+    unlink(file.c_str());
+}
+
+// 文件打不开或 reopen 失败时丢弃日志(计入 DROPPED)，不会卡住
+void test_open_fail() {
+    le0n::UringFileLogAppender::ptr bad(new le0n::UringFileLogAppender("/nonexistent_dir/x.log", false, false, 8192, 2));
+    le0n::Logger::ptr logger = make_logger(bad);
+    write_seq(logger, 0, 1000);
+    assert(bad->getMetrics().snapshot().values[le0n::LogMetrics::DROPPED] == 1000);
+    assert(bad->getErrors() == 1);
+    bad->flush();
+
+    char dir[] = "/tmp/le0n_uring_reopen_XXXXXX";
+    assert(mkdtemp(dir));
+    std::string file = std::string(dir) + "/x.log";
+    le0n::UringFileLogAppender::ptr appender(new le0n::UringFileLogAppender(file, false, false, 8192, 2));
+    logger = make_logger(appender);
+    write_seq(logger, 0, 10);
+    unlink(file.c_str());
+    rmdir(dir);
+    assert(!appender->reopen());
+    write_seq(logger, 10, 1000);
+    assert(appender->getMetrics().snapshot().values[le0n::LogMetrics::DROPPED] == 1000);
+}
+
+// 没有新日志时，缓冲区里的日志也在 flush 间隔后由后台写出线程提交
+void test_idle_flush() {
+    std::string file = make_file("idle");
+    le0n::UringFileLogAppender::ptr appender(new le0n::UringFileLogAppender(file, false, false, 8192, 2));
+    appender->setFlushInterval(20);
+    le0n::Logger::ptr logger = make_logger(appender);
+    write_seq(logger, 0, 1);
+    uint64_t start = le0n::GetMonotonicNS();
+    while(check_lines(file, "seq ", 0) != 1) {
+        assert(le0n::GetMonotonicNS() - start < 1000ull * 1000 * 1000);
+        usleep(1000);
+    }
+    uint64_t delay_ms = (le0n::GetMonotonicNS() - start) / 1000 / 1000;
+    std::cout << "idle flush in " << delay_ms << "ms" << std::endl;
+    assert(delay_ms < 500);
+    unlink(file.c_str());
+}
+
+// 预分配缓冲区只扣掉排队日志的额度: 缓冲区超过预算时 WARN 仍能经异步队列写出，
+// 预算足够时 INFO 不会因为缓冲区被全部丢弃
+void test_budget() {
+    std::string file = make_file("budget");
+    const int N = 2000;
+    {
+        // 先创建 Appender 再设置预算(如配置加载晚于 Appender 创建)，缓冲区同样计入
+        le0n::UringFileLogAppender::ptr appender(new le0n::UringFileLogAppender(file));
+        assert(le0n::LogMemoryBudget::GetReserved() == 4 * 256 * 1024);
+        le0n::LogMemoryBudget::SetLimit(64 * 1024);
+        le0n::AsyncLogAppender::ptr async(new le0n::AsyncLogAppender(appender));
+        le0n::Logger::ptr logger = make_logger(async);
+        for(int i = 0; i < N; ++i) {
+            LE0N_LOG_WARN(logger) << "seq " << i << " " << std::string(i % 100, 'x');
+        }
+        async->flush();
+        appender->flush();
+        assert(check_lines(file, "seq ", 0) == N);
+
+        le0n::LogMemoryBudget::SetLimit(le0n::LogMemoryBudget::GetReserved() + 256 * 1024);
+        uint64_t shed = le0n::LogMemoryBudget::GetShed(le0n::LogLevel::INFO);
+        write_seq(logger, N, N);
+        async->flush();
+        assert(le0n::LogMemoryBudget::GetShed(le0n::LogLevel::INFO) - shed < (uint64_t)N);
+        logger->clearAppenders();
+    }
+    assert(le0n::LogMemoryBudget::GetUsed() == 0 && le0n::LogMemoryBudget::GetReserved() == 0);
+    le0n::LogMemoryBudget::SetLimit(0);
+    unlink(file.c_str());
+}
+
+// 吞吐和单次调用延迟分布
+static void bench(const char* name, le0n::LogAppender::ptr appender, const std::string& file) {
+    le0n::Logger::ptr logger(new le0n::Logger("bench"));
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter(
+                    "%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n")));
+    logger->addAppender(appender);
+    const int N = 200000;
+    std::vector<uint32_t> lat(N);
+    uint64_t start = le0n::GetMonotonicNS();
+    for(int i = 0; i < N; ++i) {
+        uint64_t t0 = le0n::GetMonotonicNS();
+        LE0N_LOG_INFO(logger) << "bench message " << i << " with some payload to make it realistic";
+        lat[i] = le0n::GetMonotonicNS() - t0;
+    }
+    logger->clearAppenders();
+    appender.reset();
+    uint64_t used = le0n::GetMonotonicNS() - start;
+    std::sort(lat.begin(), lat.end());
+    std::cout << name << ": " << (uint64_t)N * 1000000000ull / used << " logs/s"
+              << " p50=" << lat[N / 2] << "ns"
+              << " p99=" << lat[N * 99 / 100] << "ns"
+              << " p999=" << lat[N * 999 / 1000] << "ns"
+              << " max=" << lat[N - 1] << "ns" << std::endl;
+    unlink(file.c_str());
+}
+
+void bench_uring() {
+    std::string file = make_file("bench");
+    bench("FileLogAppender(write)", le0n::LogAppender::ptr(new le0n::FileLogAppender(file)), file);
+    bench("UringFileLogAppender", le0n::LogAppender::ptr(new le0n::UringFileLogAppender(file)), file);
+    bench("UringFileLogAppender(O_DIRECT)", le0n::LogAppender::ptr(
+                new le0n::UringFileLogAppender(file, false, true)), file);
+}
+
+int main(int argc, char** argv) {
+    test_write(false);
+    test_write(true);
+    test_threads();
+    test_open_fail();
+    test_idle_flush();
+    test_budget();
+    bench_uring();
+    return 0;
+}
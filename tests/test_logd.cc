@@ -0,0 +1,163 @@
+#include "le0n/log.h"
+#include "le0n/log_shm.h"
+#include "le0n/util.h"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+static std::string g_bin_dir = ".";
+
+// 启动 le0n_logd，只输出日志内容，方便逐行检查
+static pid_t spawn_logd(const std::string& prefix, const std::string& output, int window_ms) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if(pid == 0) {
+        std::string tool = g_bin_dir + "/le0n_logd";
+        std::string window = std::to_string(window_ms);
+        execl(tool.c_str(), tool.c_str(), "-p", prefix.c_str(), "-o", output.c_str()
+              ,"-f", "%m%n", "-w", window.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    return pid;
+}
+
+/**
+ * @brief 在子进程中写 count 条日志 "w<id> <序号> <单调时钟>"
+ * @details hang 为 true 时写完后通知 notify_fd 并挂起，等待被 SIGKILL，Appender 不析构
+ */
+static pid_t spawn_writer(const std::string& prefix, int id, int count, bool hang, int notify_fd) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if(pid == 0) {
+        le0n::Logger::ptr logger(new le0n::Logger("logd"));
+        le0n::ShmLogAppender::ptr appender(new le0n::ShmLogAppender(prefix, 4 * 1024 * 1024));
+        if(!appender->isValid()) {
+            _exit(2);
+        }
+        logger->addAppender(appender);
+        for(int i = 0; i < count; ++i) {
+            LE0N_LOG_INFO(logger) << "w" << id << " " << i << " " << le0n::GetMonotonicNS();
+            // 两个写入方交替写，输出里的日志来自不同进程、需要归并
+            if(i % 20 == 0) {
+                usleep(200);
+            }
+        }
+        if(hang) {
+            char c = 1;
+            if(write(notify_fd, &c, 1) != 1) {
+                _exit(3);
+            }
+            while(true) {
+                pause();
+            }
+        }
+        logger->clearAppenders();
+        appender.reset();
+        _exit(0);
+    }
+    return pid;
+}
+
+// 等待日志进程读完并删除所有共享内存
+static bool wait_unlinked(const std::string& prefix, uint64_t timeout_ms) {
+    uint64_t start = le0n::GetCurrentMS();
+    while(le0n::GetCurrentMS() - start < timeout_ms) {
+        std::vector<std::string> names;
+        le0n::ListShmLogs(prefix, names);
+        if(names.empty()) {
+            return true;
+        }
+        usleep(10 * 1000);
+    }
+    return false;
+}
+
+/**
+ * 两个写入方，一个正常退出，一个写完后被 SIGKILL:
+ *  1. 两个写入方的日志都完整输出，各自序号连续;
+ *  2. 输出按时间排序，晚于已输出日志的时间不超过归并窗口;
+ *  3. 写入方结束后日志进程删除对应的共享内存。
+ */
+void test_logd() {
+    std::string prefix = "le0n_test_logd_" + std::to_string(getpid());
+    std::string output = "/tmp/" + prefix + ".log";
+    unlink(output.c_str());
+    const int N = 5000;
+    const int WINDOW_MS = 50;
+
+    pid_t logd = spawn_logd(prefix, output, WINDOW_MS);
+    int fds[2];
+    int rt = pipe(fds);
+    assert(rt == 0);
+    pid_t clean = spawn_writer(prefix, 0, N, false, -1);
+    pid_t killed = spawn_writer(prefix, 1, N, true, fds[1]);
+    close(fds[1]);
+
+    char c = 0;
+    rt = read(fds[0], &c, 1);
+    assert(rt == 1);
+    close(fds[0]);
+    kill(killed, SIGKILL);
+    int status = 0;
+    waitpid(killed, &status, 0);
+    assert(WIFSIGNALED(status));
+    waitpid(clean, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    assert(wait_unlinked(prefix, 10 * 1000));
+    kill(logd, SIGTERM);
+    waitpid(logd, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    std::ifstream ifs(output);
+    assert(ifs);
+    std::string line;
+    int next[2] = {0, 0};
+    uint64_t latest = 0;
+    uint64_t max_late = 0;
+    int lines = 0;
+    int switches = 0;
+    int last_id = -1;
+    while(std::getline(ifs, line)) {
+        int id = -1, seq = -1;
+        unsigned long long mono = 0;
+        rt = sscanf(line.c_str(), "w%d %d %llu", &id, &seq, &mono);
+        assert(rt == 3);
+        assert(id == 0 || id == 1);
+        assert(seq == next[id]);
+        ++next[id];
+        if(mono < latest) {
+            max_late = std::max<uint64_t>(max_late, latest - mono);
+        }
+        assert(mono + WINDOW_MS * 1000000ull >= latest);
+        latest = std::max<uint64_t>(latest, mono);
+        switches += last_id != -1 && last_id != id;
+        last_id = id;
+        ++lines;
+    }
+    assert(next[0] == N && next[1] == N);
+    assert(lines == 2 * N);
+    unlink(output.c_str());
+    std::cout << "logd: lines=" << lines << " switches=" << switches
+              << " max_late=" << max_late << "ns" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string self = argv[0];
+    size_t pos = self.rfind('/');
+    if(pos != std::string::npos) {
+        g_bin_dir = self.substr(0, pos);
+    }
+    test_logd();
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include "le0n/log.h"
+#include "le0n/util.h"
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+static std::string g_bin_dir = ".";
+
+// 执行命令，返回标准输出
+static std::string run(const std::string& cmd, uint64_t* cost_ms = nullptr) {
+    uint64_t start = le0n::GetCurrentMS();
+    FILE* fp = popen(cmd.c_str(), "r");
+    assert(fp);
+    std::string out;
+    char buf[64 * 1024];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        out.append(buf, n);
+    }
+    pclose(fp);
+    if(cost_ms) {
+        *cost_ms = le0n::GetCurrentMS() - start;
+    }
+    return out;
+}
+
+// 用默认格式生成日志，返回文件大小
+static size_t generate(const std::string& file, int count) {
+    le0n::FileLogAppender::ptr appender(new le0n::FileLogAppender(file));
+    le0n::Logger::ptr a(new le0n::Logger("grep.a"));
+    le0n::Logger::ptr b(new le0n::Logger("grep.b"));
+    a->addAppender(appender);
+    b->addAppender(appender);
+    for(int i = 0; i < count; ++i) {
+        le0n::Logger::ptr& logger = i % 3 ? a : b;
+        le0n::LogLevel::Level level = (le0n::LogLevel::Level)(i % 5 + 1);
+        LE0N_LOG_LEVEL(logger, level) << "request " << i << (i % 97 == 0 ? " upstream timeout" : " ok")
+                                      << " user=" << (i % 1000) << " " << std::string(i % 64, 'x');
+    }
+    a->clearAppenders();
+    b->clearAppenders();
+    appender->flush();
+    std::ifstream ifs(file, std::ios::binary | std::ios::ate);
+    return ifs.tellg();
+}
+
+// 逐行计算期望结果
+static std::string expect(const std::string& content, const std::string& literal
+                          ,le0n::LogLevel::Level min_level, const std::string& logger) {
+    std::string out;
+    std::stringstream ss(content);
+    std::string line;
+    while(std::getline(ss, line)) {
+        if(line.find(literal) == std::string::npos) {
+            continue;
+        }
+        bool level_ok = min_level == le0n::LogLevel::UNKNOWN;
+        for(int l = min_level; !level_ok && l <= le0n::LogLevel::FATAL; ++l) {
+            std::string col = std::string("\t[") + le0n::LogLevel::ToString((le0n::LogLevel::Level)l) + "]\t";
+            level_ok = line.find(col) != std::string::npos;
+        }
+        if(level_ok && (logger.empty() || line.find("\t[" + logger + "]\t") != std::string::npos)) {
+            out.append(line).append("\n");
+        }
+    }
+    return out;
+}
+
+void test_loggrep(const std::string& file) {
+    std::ifstream ifs(file);
+    std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    std::string tool = g_bin_dir + "/le0n_loggrep ";
+
+    struct Case { const char* args; const char* literal; le0n::LogLevel::Level level; const char* logger; };
+    Case cases[] = {
+        {"", "upstream timeout", le0n::LogLevel::UNKNOWN, ""},
+        {"-j 4 ", "user=42 ", le0n::LogLevel::UNKNOWN, ""},
+        {"-l ERROR ", "timeout", le0n::LogLevel::ERROR, ""},
+        {"-j 3 -l warn -g grep.b ", "timeout", le0n::LogLevel::WARN, "grep.b"},
+        {"-g grep.a ", "", le0n::LogLevel::UNKNOWN, "grep.a"},
+        {"", "x", le0n::LogLevel::UNKNOWN, ""},
+        {"", "no such text", le0n::LogLevel::UNKNOWN, ""},
+    };
+    for(auto& c : cases) {
+        std::string out = run(tool + c.args + "'" + c.literal + "' " + file);
+        std::string exp = expect(content, c.literal, c.level, c.logger);
+        if(out != exp) {
+            LE0N_LOG_ERROR(g_logger) << "le0n_loggrep " << c.args << "'" << c.literal << "' mismatch: got "
+                                     << out.size() << " bytes, expect " << exp.size();
+        }
+        assert(out == exp);
+        std::string count = run(tool + "-c " + c.args + "'" + c.literal + "' " + file);
+        size_t lines = 0;
+        for(char ch : exp) {
+            lines += ch == '\n';
+        }
+        assert(count == std::to_string(lines) + "\n");
+    }
+    // 多个文件时每行带文件名
+    std::string out = run(tool + "'upstream timeout' " + file + " " + file);
+    std::string exp = expect(content, "upstream timeout", le0n::LogLevel::UNKNOWN, "");
+    std::string prefixed;
+    std::stringstream ss(exp);
+    std::string line;
+    while(std::getline(ss, line)) {
+        prefixed.append(file).append(":").append(line).append("\n");
+    }
+    assert(out == prefixed + prefixed);
+    LE0N_LOG_INFO(g_logger) << "test_loggrep ok";
+}
+
+void bench_loggrep(const std::string& file, size_t size) {
+    std::string tool = g_bin_dir + "/le0n_loggrep ";
+    // 先读一遍进页缓存
+    run("cat " + file + " > /dev/null");
+    const char* literals[] = {"upstream timeout", "user=999 ", "no such text"};
+    for(auto& literal : literals) {
+        uint64_t grep_ms = 0, tool_ms = 0, tool1_ms = 0;
+        std::string g = run(std::string("LC_ALL=C grep -F '") + literal + "' " + file, &grep_ms);
+        std::string t = run(tool + "'" + literal + "' " + file, &tool_ms);
+        run(tool + "-j 1 '" + literal + "' " + file, &tool1_ms);
+        assert(g == t);
+        LE0N_LOG_INFO(g_logger) << "bench_loggrep '" << literal << "' " << (size >> 20) << "MB"
+                                << " grep -F: " << grep_ms << "ms"
+                                << " le0n_loggrep: " << tool_ms << "ms"
+                                << " le0n_loggrep -j 1: " << tool1_ms << "ms";
+    }
+    uint64_t grep_ms = 0, tool_ms = 0;
+    run("LC_ALL=C grep -F timeout " + file + " | LC_ALL=C grep -F \"$(printf '\\t[ERROR]\\t[grep.b]')\"", &grep_ms);
+    run(tool + "-l ERROR -g grep.b timeout " + file, &tool_ms);
+    LE0N_LOG_INFO(g_logger) << "bench_loggrep level+logger filter grep|grep: " << grep_ms << "ms"
+                            << " le0n_loggrep: " << tool_ms << "ms";
+}
+
+int main(int argc, char** argv) {
+    std::string self = argv[0];
+    size_t pos = self.rfind('/');
+    if(pos != std::string::npos) {
+        g_bin_dir = self.substr(0, pos);
+    }
+    int count = argc > 1 ? atoi(argv[1]) : 500000;
+    std::string file = "/tmp/le0n_loggrep_" + std::to_string(getpid()) + ".log";
+    size_t size = generate(file, count);
+    test_loggrep(file);
+    bench_loggrep(file, size);
+    unlink(file.c_str());
+    return 0;
+}
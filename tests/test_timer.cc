@@ -0,0 +1,116 @@
+#include "le0n/timer.h"
+#include "le0n/log.h"
+#include "le0n/util.h"
+#include <cassert>
+#include <cstdlib>
+#include <unistd.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+// 简单的事件循环：睡到下一个定时器，再执行到期回调
+static void run_loop(le0n::TimerManager& mgr, uint64_t max_us) {
+    uint64_t end = le0n::GetCurrentUS() + max_us;
+    while(mgr.hasTimer() && le0n::GetCurrentUS() < end) {
+        uint64_t next = mgr.getNextTimer();
+        if(next > 0) {
+            usleep(std::min<uint64_t>(next, 10 * 1000));
+        }
+        std::vector<std::function<void()> > cbs;
+        mgr.listExpiredCb(cbs);
+        for(auto& cb : cbs) {
+            cb();
+        }
+    }
+}
+
+void test_timer() {
+    le0n::TimerManager mgr;
+    uint64_t start = le0n::GetCurrentUS();
+
+    // 亚毫秒定时器：检查实际触发时间不早于到期时间
+    std::vector<uint64_t> delays = {300, 700, 1500, 20 * 1000, 300 * 1000};
+    int fired = 0;
+    for(auto d : delays) {
+        mgr.addTimer(d, [d, start, &fired](){
+            uint64_t late = le0n::GetCurrentUS() - start;
+            assert(late >= d);
+            LE0N_LOG_INFO(g_logger) << "timer " << d << "us fired at " << late << "us";
+            ++fired;
+        });
+    }
+
+    // 循环定时器执行 5 次后取消自己
+    int count = 0;
+    le0n::Timer::ptr recurring;
+    recurring = mgr.addTimer(2 * 1000, [&count, &recurring](){
+        if(++count == 5) {
+            recurring->cancel();
+        }
+    }, true);
+
+    // 被取消的定时器不会执行
+    le0n::Timer::ptr canceled = mgr.addTimer(1000, [](){
+        assert(false);
+    });
+    assert(canceled->cancel());
+    assert(!canceled->cancel());
+
+    // 条件定时器：条件对象释放后不执行
+    std::shared_ptr<int> cond(new int(0));
+    bool cond_fired = false;
+    mgr.addConditionTimer(1000, [&cond_fired](){
+        cond_fired = true;
+    }, cond);
+    cond.reset();
+
+    run_loop(mgr, 2 * 1000 * 1000);
+    assert(fired == (int)delays.size());
+    assert(count == 5);
+    assert(!cond_fired);
+    assert(!mgr.hasTimer());
+}
+
+void test_far_timer() {
+    le0n::TimerManager mgr;
+    // 30 小时后的定时器超出时间轮范围，进入堆
+    le0n::Timer::ptr far = mgr.addTimer(30ull * 3600 * 1000 * 1000, [](){});
+    le0n::Timer::ptr near = mgr.addTimer(1000, [](){});
+    assert(mgr.getTimerCount() == 2);
+    assert(mgr.getNextTimer() <= 1000);
+    assert(far->reset(500, true));
+    run_loop(mgr, 1000 * 1000);
+    assert(mgr.getTimerCount() == 0);
+    assert(!far->cancel());
+}
+
+void bench_timer() {
+    const size_t N = 2 * 1000 * 1000;
+    le0n::TimerManager mgr;
+    std::vector<le0n::Timer::ptr> timers;
+    timers.reserve(N);
+    srand(0);
+
+    uint64_t begin = le0n::GetCurrentUS();
+    for(size_t i = 0; i < N; ++i) {
+        // 1ms ~ 48h 随机分布，覆盖时间轮各层以及远期堆
+        uint64_t us = 1000 + ((uint64_t)rand() * rand()) % (48ull * 3600 * 1000 * 1000);
+        timers.push_back(mgr.addTimer(us, [](){}));
+    }
+    uint64_t inserted = le0n::GetCurrentUS();
+    for(auto& t : timers) {
+        t->cancel();
+    }
+    uint64_t canceled = le0n::GetCurrentUS();
+
+    LE0N_LOG_INFO(g_logger) << "bench_timer N=" << N
+        << " insert=" << (inserted - begin) * 1000.0 / N << "ns/op"
+        << " cancel=" << (canceled - inserted) * 1000.0 / N << "ns/op";
+    assert(mgr.getTimerCount() == 0);
+}
+
+int main(int argc, char** argv) {
+    test_timer();
+    test_far_timer();
+    bench_timer();
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "le0n/log.h"
+#include "le0n/trace.h"
+#include "le0n/util.h"
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+static le0n::Logger::ptr g_logger = LE0N_LOG_ROOT();
+
+static std::string make_file(const char* name) {
+    return std::string("/tmp/le0n_trace_") + name + "_" + std::to_string(getpid()) + ".json";
+}
+
+// 每行一个事件，按名称计数；检查文件是完整的 JSON 数组
+static std::map<std::string, int> count_spans(const std::string& file) {
+    std::ifstream ifs(file);
+    std::string line;
+    std::map<std::string, int> counts;
+    assert(std::getline(ifs, line) && line == "[");
+    std::string last;
+    while(std::getline(ifs, line)) {
+        last = line;
+        if(line.find("\"ph\":\"X\"") == std::string::npos) {
+            continue;
+        }
+        size_t b = line.find("{\"name\":\"") + 9;
+        size_t e = line.find("\",\"cat\"", b);
+        ++counts[line.substr(b, e - b)];
+    }
+    assert(last == "]");
+    return counts;
+}
+
+static void outer(int n) {
+    LE0N_TRACE_SCOPE("outer");
+    for(int i = 0; i < n; ++i) {
+        LE0N_TRACE_SCOPE("inner \"quoted\"");
+    }
+}
+
+// 多线程嵌套 span，导出线程在运行期间多次取走数据
+void test_trace() {
+    std::string file = make_file("spans");
+    // 未开始时不记录
+    outer(10);
+    assert(le0n::Tracer::Start(file, 10));
+    assert(!le0n::Tracer::Start(file));
+    const int THREADS = 4;
+    const int N = 2000;
+    std::vector<std::thread> threads;
+    for(int t = 0; t < THREADS; ++t) {
+        threads.push_back(std::thread([](){
+            for(int i = 0; i < N; ++i) {
+                outer(3);
+                if(i % 500 == 0) {
+                    usleep(20 * 1000);
+                }
+            }
+        }));
+    }
+    for(auto& i : threads) {
+        i.join();
+    }
+    le0n::Tracer::Stop();
+    assert(le0n::Tracer::GetDropped() == 0);
+    assert(le0n::Tracer::GetExported() == (uint64_t)THREADS * N * 4);
+    std::map<std::string, int> counts = count_spans(file);
+    assert(counts.size() == 2);
+    assert(counts["outer"] == THREADS * N);
+    assert(counts["inner \\\"quoted\\\""] == THREADS * N * 3);
+    // 停止后不记录
+    outer(10);
+    unlink(file.c_str());
+}
+
+// 缓冲区满时丢弃并计数
+void test_drop() {
+    std::string file = make_file("drop");
+    assert(le0n::Tracer::Start(file, 60 * 1000, 16));
+    std::thread([](){
+        for(int i = 0; i < 100; ++i) {
+            LE0N_TRACE_SCOPE("drop");
+        }
+    }).join();
+    le0n::Tracer::Stop();
+    assert(le0n::Tracer::GetExported() == 16);
+    assert(le0n::Tracer::GetDropped() == 84);
+    assert(count_spans(file)["drop"] == 16);
+    unlink(file.c_str());
+}
+
+// 单个 span 的开销: 关闭时和开启时
+void bench_trace() {
+    const int N = 1000000;
+    uint64_t t0 = le0n::GetMonotonicNS();
+    for(int i = 0; i < N; ++i) {
+        LE0N_TRACE_SCOPE("bench");
+    }
+    uint64_t t1 = le0n::GetMonotonicNS();
+    std::string file = make_file("bench");
+    // 导出间隔足够长，只测业务线程上的开销(单核机器上导出线程会抢占计时)
+    assert(le0n::Tracer::Start(file, 60 * 1000, 1 << 20));
+    uint64_t t2 = le0n::GetMonotonicNS();
+    for(int i = 0; i < N; ++i) {
+        LE0N_TRACE_SCOPE("bench");
+    }
+    uint64_t t3 = le0n::GetMonotonicNS();
+    le0n::Tracer::Stop();
+    uint64_t dropped = le0n::Tracer::GetDropped();
+    unlink(file.c_str());
+    LE0N_LOG_INFO(g_logger) << "bench_trace disabled=" << (t1 - t0) * 1.0 / N << "ns/span"
+        << " enabled=" << (t3 - t2) * 1.0 / N << "ns/span dropped=" << dropped;
+}
+
+int main(int argc, char** argv) {
+    test_trace();
+    test_drop();
+    bench_trace();
+    return 0;
+}
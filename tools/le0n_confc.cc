@@ -0,0 +1,24 @@
+#include "le0n/config_snapshot.h"
+#include <iostream>
+
+/**
+ * 配置快照编译工具：le0n_confc <yaml_file> <snapshot_file>
+ * 部署时预先生成快照，进程启动用 Config::LoadFromSnapshot 加载
+ */
+int main(int argc, char** argv) {
+    if(argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <yaml_file> <snapshot_file>" << std::endl;
+        return 1;
+    }
+    if(!le0n::ConfigSnapshot::Compile(argv[1], argv[2])) {
+        std::cerr << "compile " << argv[1] << " failed" << std::endl;
+        return 1;
+    }
+    le0n::ConfigSnapshot::ptr snap = le0n::ConfigSnapshot::Open(argv[2]);
+    if(!snap) {
+        std::cerr << "open " << argv[2] << " failed" << std::endl;
+        return 1;
+    }
+    std::cout << argv[2] << ": " << snap->getKeyCount() << " keys" << std::endl;
+    return 0;
+}
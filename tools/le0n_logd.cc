@@ -0,0 +1,206 @@
+#include "le0n/log.h"
+#include "le0n/log_shm.h"
+#include "le0n/util.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <signal.h>
+#include <unistd.h>
+
+/**
+ * 日志进程：le0n_logd -p <prefix> -o <file> [-f <pattern>] [-w <merge_window_ms>]
+ *
+ * 发现 /dev/shm 下所有 "<prefix>.*" 共享内存(ShmLogAppender 创建)，每个写入方一个读取线程，
+ * 输出线程把各进程的日志按单调时钟归并后，通过 FileLogAppender + LogFormatter 写入文件。
+ * 归并窗口内(默认 20ms)的日志先缓存，用来把不同进程间稍有先后的日志排回时间顺序。
+ * 写入方退出(正常关闭或崩溃)且日志读完后删除对应的共享内存，回收读取线程；
+ * 之后再出现同名的共享内存会重新挂载。
+ */
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void on_signal(int sig) {
+    s_stop = 1;
+}
+
+struct Pending {
+    std::mutex mutex;
+    std::vector<le0n::ShmLogRecord> records;
+};
+
+// 一个写入方的读取线程
+struct ReaderThread {
+    std::thread thread;
+    std::atomic<bool> finished{false};
+};
+
+static void read_loop(le0n::ShmLogReader::ptr reader, Pending* pending, std::atomic<bool>* finished) {
+    std::vector<le0n::ShmLogRecord> records;
+    while(true) {
+        bool stopping = s_stop;
+        records.clear();
+        if(reader->read(records)) {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            for(auto& i : records) {
+                pending->records.push_back(std::move(i));
+            }
+            continue;
+        }
+        if(reader->isFinished()) {
+            std::cerr << "le0n_logd: " << reader->getShmName() << " finished, dropped="
+                << reader->getDropped() << " skipped=" << reader->getSkipped() << std::endl;
+            reader->unlink();
+            break;
+        }
+        if(stopping) {
+            break;
+        }
+        reader->wait(100);
+    }
+    finished->store(true);
+}
+
+/**
+ * @brief 把记录还原成 LogEvent，交给 Appender 按格式输出
+ * @details 文件名和日志器在进程内常驻，LogEvent 可以直接引用
+ */
+class RecordWriter {
+public:
+    RecordWriter(le0n::LogAppender::ptr appender)
+        :m_appender(appender) {}
+
+    void write(std::vector<le0n::ShmLogRecord>& records) {
+        std::vector<le0n::LogEvent::ptr> events;
+        events.reserve(records.size());
+        for(auto& r : records) {
+            const char* file = m_files.insert(r.file).first->c_str();
+            le0n::Logger*& logger = m_loggers[r.logger];
+            if(!logger) {
+                logger = LE0N_LOG_NAME(r.logger).get();
+            }
+            le0n::LogEvent::ptr event(new le0n::LogEvent(logger, r.level, file, r.line
+                        , r.elapse, r.thread_id, r.fiber_id, r.time));
+            event->getSS() << r.content;
+            events.push_back(event);
+        }
+        if(!events.empty()) {
+            m_appender->logBatch(events.data(), events.size());
+        }
+    }
+private:
+    le0n::LogAppender::ptr m_appender;
+    std::set<std::string> m_files;
+    std::map<std::string, le0n::Logger*> m_loggers;
+};
+
+static void write_loop(Pending* pending, RecordWriter* writer, uint64_t window_ms
+                       ,std::atomic<bool>* done) {
+    std::vector<le0n::ShmLogRecord> buffered;
+    std::vector<le0n::ShmLogRecord> ready;
+    while(true) {
+        bool finishing = done->load();
+        {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            for(auto& i : pending->records) {
+                buffered.push_back(std::move(i));
+            }
+            pending->records.clear();
+        }
+        std::stable_sort(buffered.begin(), buffered.end(),
+            [](const le0n::ShmLogRecord& a, const le0n::ShmLogRecord& b){
+                return a.mono_ns < b.mono_ns;
+            });
+        // 超过归并窗口的日志不会再有更早的日志到达，可以输出
+        uint64_t limit = finishing ? ~0ull : le0n::GetMonotonicNS() - window_ms * 1000000ull;
+        size_t n = 0;
+        while(n < buffered.size() && buffered[n].mono_ns <= limit) {
+            ++n;
+        }
+        ready.assign(std::make_move_iterator(buffered.begin())
+                     ,std::make_move_iterator(buffered.begin() + n));
+        buffered.erase(buffered.begin(), buffered.begin() + n);
+        writer->write(ready);
+        if(finishing && buffered.empty()) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::max<uint64_t>(window_ms / 2, 1)));
+    }
+}
+
+static void usage(const char* name) {
+    std::cerr << "usage: " << name << " -p <prefix> -o <file> [-f <pattern>] [-w <merge_window_ms>]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string prefix;
+    std::string output;
+    std::string pattern = "%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n";
+    uint64_t window_ms = 20;
+    int opt;
+    while((opt = getopt(argc, argv, "p:o:f:w:")) != -1) {
+        switch(opt) {
+            case 'p': prefix = optarg; break;
+            case 'o': output = optarg; break;
+            case 'f': pattern = optarg; break;
+            case 'w': window_ms = atoi(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(prefix.empty() || output.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    le0n::LogAppender::ptr appender(new le0n::FileLogAppender(output, true));
+    appender->setFormatter(le0n::LogFormatter::ptr(new le0n::LogFormatter(pattern)));
+    RecordWriter writer(appender);
+
+    Pending pending;
+    std::atomic<bool> done(false);
+    std::thread write_thread(write_loop, &pending, &writer, window_ms, &done);
+
+    std::map<std::string, std::unique_ptr<ReaderThread> > readers;
+    while(!s_stop) {
+        // 回收已经读完的写入方，同名的新共享内存下面会重新挂载
+        for(auto it = readers.begin(); it != readers.end();) {
+            if(it->second->finished.load()) {
+                it->second->thread.join();
+                it = readers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        std::vector<std::string> names;
+        le0n::ListShmLogs(prefix, names);
+        for(auto& name : names) {
+            if(readers.count(name)) {
+                continue;
+            }
+            le0n::ShmLogReader::ptr reader = le0n::ShmLogReader::Open(name);
+            if(!reader) {
+                // 可能还在初始化，下一轮再试
+                continue;
+            }
+            std::cerr << "le0n_logd: attach " << name << std::endl;
+            std::unique_ptr<ReaderThread>& r = readers[name];
+            r.reset(new ReaderThread);
+            r->thread = std::thread(read_loop, reader, &pending, &r->finished);
+        }
+        usleep(200 * 1000);
+    }
+
+    for(auto& i : readers) {
+        i.second->thread.join();
+    }
+    done = true;
+    write_thread.join();
+    return 0;
+}
@@ -0,0 +1,325 @@
+#include "le0n/log.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <immintrin.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * 在默认格式的日志里搜索：le0n_loggrep [-l <level>] [-g <logger>] [-j <threads>] [-c] [-H] <literal> <file>...
+ *
+ * 默认格式为 "%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"，
+ * 第 4 列是 [级别]，第 5 列是 [日志器]。
+ *  1. 文件整体 mmap，按行边界切成若干段由多个线程并行扫描，输出按文件内的顺序；
+ *  2. 查找字符串时一次比较 32(AVX2)/16(SSE4.2) 个位置的首字节和尾字节，两者都相同的位置再 memcmp，
+ *     运行时按 CPU 支持选择实现，都不支持时使用 memmem；
+ *  3. 只对包含字符串的行解析级别和日志器列；literal 为空时每一行都是候选行。
+ * -l 只输出不低于该级别的行，-g 只输出该日志器的行，-c 只输出行数，-H 每行前加文件名(多个文件时默认加)。
+ * 有匹配返回 0，没有返回 1，出错返回 2(和 grep 一致)。
+ */
+
+typedef const char* (*SearchFunc)(const char* begin, const char* end, const char* needle, size_t len);
+
+static const char* SearchScalar(const char* begin, const char* end, const char* needle, size_t len) {
+    return (const char*)memmem(begin, end - begin, needle, len);
+}
+
+__attribute__((target("avx2")))
+static const char* SearchAvx2(const char* begin, const char* end, const char* needle, size_t len) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[len - 1]);
+    const char* p = begin;
+    // 每次检查 32 个起点，需要读到 p + len - 1 + 32
+    for(; end - p >= (ptrdiff_t)(len + 31); p += 32) {
+        __m256i bf = _mm256_loadu_si256((const __m256i*)p);
+        __m256i bl = _mm256_loadu_si256((const __m256i*)(p + len - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, bf)
+                                                              ,_mm256_cmpeq_epi8(last, bl)));
+        while(mask) {
+            int bit = __builtin_ctz(mask);
+            if(memcmp(p + bit + 1, needle + 1, len - 2) == 0) {
+                return p + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return SearchScalar(p, end, needle, len);
+}
+
+__attribute__((target("sse4.2")))
+static const char* SearchSse42(const char* begin, const char* end, const char* needle, size_t len) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[len - 1]);
+    const char* p = begin;
+    for(; end - p >= (ptrdiff_t)(len + 15); p += 16) {
+        __m128i bf = _mm_loadu_si128((const __m128i*)p);
+        __m128i bl = _mm_loadu_si128((const __m128i*)(p + len - 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, bf)
+                                                       ,_mm_cmpeq_epi8(last, bl)));
+        while(mask) {
+            int bit = __builtin_ctz(mask);
+            if(memcmp(p + bit + 1, needle + 1, len - 2) == 0) {
+                return p + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return SearchScalar(p, end, needle, len);
+}
+
+// 单字节和空串直接用 memchr/memmem(glibc 已经向量化)
+static SearchFunc SelectSearch(size_t len, const char** name) {
+    if(len >= 2 && __builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return SearchAvx2;
+    }
+    if(len >= 2 && __builtin_cpu_supports("sse4.2")) {
+        *name = "sse4.2";
+        return SearchSse42;
+    }
+    *name = "scalar";
+    return SearchScalar;
+}
+
+struct Options {
+    std::string literal;
+    uint32_t level_mask = ~0u;
+    std::string logger;     //空表示不过滤
+    bool count = false;
+    bool with_name = false;
+    SearchFunc search = SearchScalar;
+};
+
+/**
+ * @brief 文件中按行边界切出的一段，由一个线程扫描
+ */
+struct Chunk {
+    size_t file;
+    const char* begin;
+    const char* end;
+    std::string out;
+    uint64_t matched = 0;
+};
+
+// 取第 n 列(tab 分隔)，去掉两侧的 []
+static bool GetColumn(const char* line, const char* end, int n, const char** b, const char** e) {
+    const char* p = line;
+    for(int i = 0; i < n; ++i) {
+        p = (const char*)memchr(p, '\t', end - p);
+        if(!p) {
+            return false;
+        }
+        ++p;
+    }
+    const char* q = (const char*)memchr(p, '\t', end - p);
+    if(!q) {
+        q = end;
+    }
+    if(q - p >= 2 && *p == '[' && q[-1] == ']') {
+        ++p;
+        --q;
+    }
+    *b = p;
+    *e = q;
+    return true;
+}
+
+// 候选行按级别和日志器过滤
+static bool MatchColumns(const Options& opt, const char* line, const char* end) {
+    const char* b;
+    const char* e;
+    if(opt.level_mask != ~0u) {
+        if(!GetColumn(line, end, 3, &b, &e)) {
+            return false;
+        }
+        le0n::LogLevel::Level level = le0n::LogLevel::FromString(std::string(b, e));
+        if(!(opt.level_mask & (1u << level))) {
+            return false;
+        }
+    }
+    if(!opt.logger.empty()) {
+        if(!GetColumn(line, end, 4, &b, &e)
+                || (size_t)(e - b) != opt.logger.size()
+                || memcmp(b, opt.logger.c_str(), e - b) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void ScanChunk(const Options& opt, const std::vector<std::string>& files, Chunk& chunk) {
+    const char* p = chunk.begin;
+    const char* end = chunk.end;
+    const std::string& literal = opt.literal;
+    while(p < end) {
+        const char* hit = p;
+        if(!literal.empty()) {
+            hit = opt.search(p, end, literal.c_str(), literal.size());
+            if(!hit) {
+                break;
+            }
+        }
+        // 只在候选位置找行边界
+        const char* line = (const char*)memrchr(p, '\n', hit - p);
+        line = line ? line + 1 : p;
+        const char* eol = (const char*)memchr(hit, '\n', end - hit);
+        const char* next = eol ? eol + 1 : end;
+        if(!eol) {
+            eol = end;
+        }
+        if(MatchColumns(opt, line, eol)) {
+            ++chunk.matched;
+            if(!opt.count) {
+                if(opt.with_name) {
+                    chunk.out.append(files[chunk.file]).append(":");
+                }
+                chunk.out.append(line, eol - line).append("\n");
+            }
+        }
+        p = next;
+    }
+}
+
+static void usage(const char* name) {
+    std::cerr << "usage: " << name << " [-l <level>] [-g <logger>] [-j <threads>] [-c] [-H] <literal> <file>..." << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool verbose = false;
+    int c;
+    while((c = getopt(argc, argv, "l:g:j:cHv")) != -1) {
+        switch(c) {
+            case 'l': {
+                le0n::LogLevel::Level level = le0n::LogLevel::FromString(optarg);
+                if(level == le0n::LogLevel::UNKNOWN) {
+                    std::cerr << "bad level: " << optarg << std::endl;
+                    return 2;
+                }
+                opt.level_mask = ~0u << level;
+                break;
+            }
+            case 'g': opt.logger = optarg; break;
+            case 'j': threads = std::max(1, atoi(optarg)); break;
+            case 'c': opt.count = true; break;
+            case 'H': opt.with_name = true; break;
+            case 'v': verbose = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if(optind + 2 > argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    opt.literal = argv[optind];
+    const char* impl = "";
+    opt.search = SelectSearch(opt.literal.size(), &impl);
+    std::vector<std::string> files(argv + optind + 1, argv + argc);
+    if(files.size() > 1) {
+        opt.with_name = true;
+    }
+
+    // 映射所有文件并按行边界切段，每段至少 4MB
+    const size_t MIN_CHUNK = 4 * 1024 * 1024;
+    std::vector<std::pair<void*, size_t> > maps;
+    std::vector<Chunk> chunks;
+    for(size_t f = 0; f < files.size(); ++f) {
+        int fd = open(files[f].c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if(fd < 0 || fstat(fd, &st) != 0) {
+            std::cerr << "open " << files[f] << " failed: " << strerror(errno) << std::endl;
+            return 2;
+        }
+        size_t size = st.st_size;
+        if(size == 0) {
+            close(fd);
+            continue;
+        }
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(addr == MAP_FAILED) {
+            std::cerr << "mmap " << files[f] << " failed: " << strerror(errno) << std::endl;
+            return 2;
+        }
+        madvise(addr, size, MADV_SEQUENTIAL);
+        maps.push_back(std::make_pair(addr, size));
+        const char* begin = (const char*)addr;
+        const char* end = begin + size;
+        size_t step = std::max(MIN_CHUNK, size / threads + 1);
+        while(begin < end) {
+            const char* stop = end - begin > (ptrdiff_t)step ? begin + step : end;
+            if(stop < end) {
+                const char* nl = (const char*)memchr(stop, '\n', end - stop);
+                stop = nl ? nl + 1 : end;
+            }
+            Chunk chunk;
+            chunk.file = f;
+            chunk.begin = begin;
+            chunk.end = stop;
+            chunks.push_back(std::move(chunk));
+            begin = stop;
+        }
+    }
+
+    std::atomic<size_t> next(0);
+    auto worker = [&](){
+        size_t i;
+        while((i = next.fetch_add(1)) < chunks.size()) {
+            ScanChunk(opt, files, chunks[i]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for(int i = 1; i < std::min<int>(threads, chunks.size()); ++i) {
+        pool.push_back(std::thread(worker));
+    }
+    worker();
+    for(auto& t : pool) {
+        t.join();
+    }
+
+    uint64_t matched = 0;
+    std::vector<uint64_t> per_file(files.size(), 0);
+    for(auto& chunk : chunks) {
+        matched += chunk.matched;
+        per_file[chunk.file] += chunk.matched;
+        const char* p = chunk.out.c_str();
+        size_t len = chunk.out.size();
+        while(len > 0) {
+            ssize_t n = write(STDOUT_FILENO, p, len);
+            if(n < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                return 2;
+            }
+            p += n;
+            len -= n;
+        }
+    }
+    if(opt.count) {
+        for(size_t f = 0; f < files.size(); ++f) {
+            if(opt.with_name) {
+                std::cout << files[f] << ":";
+            }
+            std::cout << per_file[f] << std::endl;
+        }
+    }
+    for(auto& m : maps) {
+        munmap(m.first, m.second);
+    }
+    if(verbose) {
+        std::cerr << "le0n_loggrep: search=" << impl << " threads=" << threads
+                  << " chunks=" << chunks.size() << " matched=" << matched << std::endl;
+    }
+    return matched ? 0 : 1;
+}
@@ -0,0 +1,282 @@
+#include "le0n/log.h"
+#include "le0n/log_index.h"
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * 按时间段取日志：le0n_logslice [-s <start>] [-e <end>] [-l <level>] [-v] <file>
+ *
+ * 时间为 "YYYY-mm-dd HH:MM:SS"(本地时间，和 %d 的默认格式一致)或 Unix 秒数，包含两端。
+ * 用 "<file>.idx"(FileLogAppender::setIndex 生成)跳过时间段和级别都不匹配的块，
+ * 只读取可能匹配的块、没有索引覆盖的部分和最后一个索引之后的部分，再逐行过滤：
+ * 行首是 "%Y-%m-%d %H:%M:%S" 的行按时间过滤，行内第一个 [LEVEL] 按级别过滤，
+ * 行首没有时间的行(多行日志的后续行)跟随上一行。没有索引文件时扫描整个文件。
+ */
+
+static const size_t READ_SIZE = 1024 * 1024;
+
+class LineFilter {
+public:
+    LineFilter(uint64_t start, uint64_t end, uint32_t level_mask)
+        :m_start(start), m_end(end), m_levelMask(level_mask) {}
+
+    // 判断一行是否输出(不含换行符)
+    bool match(const char* line, size_t len) {
+        uint64_t t;
+        if(!parseTime(line, len, &t)) {
+            return m_last;
+        }
+        m_last = t >= m_start && t <= m_end && matchLevel(line, len);
+        return m_last;
+    }
+private:
+    static bool digits(const char* p, int n, int* v) {
+        *v = 0;
+        for(int i = 0; i < n; ++i) {
+            if(p[i] < '0' || p[i] > '9') {
+                return false;
+            }
+            *v = *v * 10 + p[i] - '0';
+        }
+        return true;
+    }
+
+    // 解析行首的 "YYYY-mm-dd HH:MM:SS"，同一分钟内只调用一次 mktime
+    bool parseTime(const char* p, size_t len, uint64_t* t) {
+        int year, mon, day, hour, min, sec;
+        if(len < 19 || p[4] != '-' || p[7] != '-' || p[10] != ' ' || p[13] != ':' || p[16] != ':'
+                || !digits(p, 4, &year) || !digits(p + 5, 2, &mon) || !digits(p + 8, 2, &day)
+                || !digits(p + 11, 2, &hour) || !digits(p + 14, 2, &min) || !digits(p + 17, 2, &sec)) {
+            return false;
+        }
+        if(m_minute.compare(0, std::string::npos, p, 16) != 0) {
+            struct tm tm;
+            memset(&tm, 0, sizeof(tm));
+            tm.tm_year = year - 1900;
+            tm.tm_mon = mon - 1;
+            tm.tm_mday = day;
+            tm.tm_hour = hour;
+            tm.tm_min = min;
+            tm.tm_isdst = -1;
+            m_minute.assign(p, 16);
+            m_minuteBase = mktime(&tm);
+        }
+        *t = m_minuteBase + sec;
+        return true;
+    }
+
+    bool matchLevel(const char* p, size_t len) {
+        if(m_levelMask == ~0u) {
+            return true;
+        }
+        const char* end = p + len;
+        for(const char* q = (const char*)memchr(p, '[', len); q; q = (const char*)memchr(q + 1, '[', end - q - 1)) {
+            const char* close = (const char*)memchr(q, ']', std::min<size_t>(end - q, 8));
+            if(!close) {
+                continue;
+            }
+            le0n::LogLevel::Level level = le0n::LogLevel::FromString(std::string(q + 1, close));
+            if(level != le0n::LogLevel::UNKNOWN) {
+                return m_levelMask & (1u << level);
+            }
+        }
+        return false;
+    }
+private:
+    uint64_t m_start;
+    uint64_t m_end;
+    uint32_t m_levelMask;
+    bool m_last = false;
+    std::string m_minute;
+    uint64_t m_minuteBase = 0;
+};
+
+class Output {
+public:
+    ~Output() { flush(); }
+    void append(const char* p, size_t len) {
+        m_buf.append(p, len);
+        if(m_buf.size() >= READ_SIZE) {
+            flush();
+        }
+    }
+    void flush() {
+        const char* p = m_buf.c_str();
+        size_t len = m_buf.size();
+        while(len > 0) {
+            ssize_t n = write(STDOUT_FILENO, p, len);
+            if(n < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                exit(1);
+            }
+            p += n;
+            len -= n;
+        }
+        m_buf.clear();
+    }
+private:
+    std::string m_buf;
+};
+
+/**
+ * @brief 读取 [begin, end) 并逐行过滤
+ * @details 范围的起点都是某次写入的起点，也就是行首
+ */
+static bool scan_range(int fd, uint64_t begin, uint64_t end, LineFilter& filter, Output& out
+                       ,uint64_t* read_bytes) {
+    std::string carry;
+    std::vector<char> buf(READ_SIZE);
+    uint64_t pos = begin;
+    while(pos < end) {
+        ssize_t n = pread(fd, &buf[0], std::min<uint64_t>(READ_SIZE, end - pos), pos);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if(n == 0) {
+            break;
+        }
+        pos += n;
+        *read_bytes += n;
+        const char* p = &buf[0];
+        const char* limit = p + n;
+        while(p < limit) {
+            const char* nl = (const char*)memchr(p, '\n', limit - p);
+            if(!nl) {
+                carry.append(p, limit);
+                break;
+            }
+            if(!carry.empty()) {
+                carry.append(p, nl);
+                if(filter.match(carry.c_str(), carry.size())) {
+                    out.append(carry.c_str(), carry.size());
+                    out.append("\n", 1);
+                }
+                carry.clear();
+            } else if(filter.match(p, nl - p)) {
+                out.append(p, nl - p + 1);
+            }
+            p = nl + 1;
+        }
+    }
+    // 范围末尾没有换行(正在写入的最后一行)
+    if(!carry.empty() && filter.match(carry.c_str(), carry.size())) {
+        out.append(carry.c_str(), carry.size());
+        out.append("\n", 1);
+    }
+    return true;
+}
+
+// "YYYY-mm-dd HH:MM:SS" 或 Unix 秒数
+static bool parse_time_arg(const char* str, uint64_t* t) {
+    char* end = nullptr;
+    unsigned long long v = strtoull(str, &end, 10);
+    if(*str && *end == 0) {
+        *t = v;
+        return true;
+    }
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* rest = strptime(str, "%Y-%m-%d %H:%M:%S", &tm);
+    if(!rest || *rest) {
+        return false;
+    }
+    tm.tm_isdst = -1;
+    *t = mktime(&tm);
+    return true;
+}
+
+static void usage(const char* name) {
+    std::cerr << "usage: " << name << " [-s <start>] [-e <end>] [-l <level>] [-v] <file>" << std::endl
+              << "  time: \"YYYY-mm-dd HH:MM:SS\" (local) or unix seconds, both inclusive" << std::endl
+              << "  level: minimum level (DEBUG/INFO/WARN/ERROR/FATAL)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    uint64_t start = 0;
+    uint64_t end = ~0ull;
+    uint32_t level_mask = ~0u;
+    bool verbose = false;
+    int opt;
+    while((opt = getopt(argc, argv, "s:e:l:v")) != -1) {
+        switch(opt) {
+            case 's':
+            case 'e':
+                if(!parse_time_arg(optarg, opt == 's' ? &start : &end)) {
+                    std::cerr << "bad time: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'l': {
+                le0n::LogLevel::Level level = le0n::LogLevel::FromString(optarg);
+                if(level == le0n::LogLevel::UNKNOWN) {
+                    std::cerr << "bad level: " << optarg << std::endl;
+                    return 1;
+                }
+                level_mask = ~0u << level;
+                break;
+            }
+            case 'v': verbose = true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string file = argv[optind];
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+        std::cerr << "open " << file << " failed: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    uint64_t size = st.st_size;
+
+    std::vector<le0n::LogIndexEntry> entries;
+    std::vector<std::pair<uint64_t, uint64_t> > ranges;
+    uint64_t covered = 0;
+    if(le0n::LogIndex::Load(le0n::LogIndex::IndexFile(file), entries)) {
+        covered = le0n::LogIndex::Select(entries, start, end, level_mask, ranges);
+    } else {
+        std::cerr << "le0n_logslice: no index for " << file << ", scanning whole file" << std::endl;
+    }
+    // 索引之后的部分(还没写满的块)
+    if(covered < size) {
+        if(!ranges.empty() && ranges.back().second >= covered) {
+            ranges.back().second = size;
+        } else {
+            ranges.push_back(std::make_pair(covered, size));
+        }
+    }
+
+    LineFilter filter(start, end, level_mask);
+    Output out;
+    uint64_t read_bytes = 0;
+    for(auto& r : ranges) {
+        if(!scan_range(fd, r.first, std::min(r.second, size), filter, out, &read_bytes)) {
+            std::cerr << "read " << file << " failed: " << strerror(errno) << std::endl;
+            return 1;
+        }
+    }
+    out.flush();
+    close(fd);
+    if(verbose) {
+        std::cerr << "le0n_logslice: blocks=" << entries.size() << " ranges=" << ranges.size()
+                  << " read=" << read_bytes << "/" << size << " bytes" << std::endl;
+    }
+    return 0;
+}